@@ -0,0 +1,694 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/batch-parser.h"
+#include "cxx/parsers/lexer.h"
+#include "cxx/parsers/restricted-parser.h"
+#include "cxx/parsers/token-buffer.h"
+#include "cxx/parsers/type-cache.h"
+
+#include "cxx/arena.h"
+#include "cxx/filesystem.h"
+#include "cxx/program.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace cxx;
+
+// Counts the calls to operator new (see bench_arena()).
+static std::atomic<size_t> g_allocations{ 0 };
+
+void* operator new(size_t size)
+{
+  ++g_allocations;
+
+  if (void* p = std::malloc(size))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+// Returns the best time (in seconds) out of several runs of f.
+double measure(const std::function<void()>& f, int runs = 5)
+{
+  double best = 0.;
+
+  for (int i(0); i < runs; ++i)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    best = (i == 0 || elapsed < best) ? elapsed : best;
+  }
+
+  return best;
+}
+
+void report(const std::string& label, double seconds, size_t bytes)
+{
+  std::cout << "  " << std::left << std::setw(24) << label
+    << std::right << std::setw(10) << std::fixed << std::setprecision(3) << seconds * 1000. << " ms"
+    << std::setw(12) << std::setprecision(1) << (bytes / (1024. * 1024.)) / seconds << " MB/s" << std::endl;
+}
+
+std::vector<parsers::Token> tokenize(const std::string& src, parsers::Lexer::InstructionSet iset)
+{
+  parsers::Lexer lexer;
+  lexer.setInstructionSet(iset);
+  lexer.reset(&src);
+
+  std::vector<parsers::Token> result;
+
+  while (!lexer.atEnd())
+    result.push_back(lexer.read());
+
+  return result;
+}
+
+// Mimics a generated header: large comment blocks, deep indentation 
+// and short declarations.
+std::string generated_header(size_t size)
+{
+  const std::string chunk =
+    "/*****************************************************************************\n"
+    " * Generated file - do not edit                                              *\n"
+    " *****************************************************************************/\n"
+    "\n"
+    "namespace generated\n"
+    "{\n"
+    "        // Returns the value of the entry in the table.\n"
+    "        // See the documentation of the generator for more details.\n"
+    "        int entry(int index, table t);\n"
+    "\n"
+    "        /* The number of entries in the table */\n"
+    "        static const int count;\n"
+    "}\n\n";
+
+  std::string result;
+  result.reserve(size + chunk.size());
+
+  while (result.size() < size)
+    result += chunk;
+
+  return result;
+}
+
+void bench_lexer_simd()
+{
+  const std::string src = generated_header(16 * 1024 * 1024);
+
+  std::cout << "lexer-simd: lexing " << src.size() / (1024 * 1024) << " MB" << std::endl;
+
+  std::vector<parsers::Token> expected = tokenize(src, parsers::Lexer::Scalar);
+
+  for (parsers::Lexer::InstructionSet iset : { parsers::Lexer::Scalar, parsers::Lexer::SSE2, parsers::Lexer::AVX2 })
+  {
+    if (iset > parsers::Lexer::supportedInstructionSet())
+      continue;
+
+    const char* names[] = { "scalar", "sse2", "avx2" };
+
+    if (tokenize(src, iset).size() != expected.size())
+      std::cout << "  error: token streams differ" << std::endl;
+
+    double t = measure([&]() { tokenize(src, iset); });
+    report(names[iset], t, src.size());
+  }
+}
+
+// Keyword- and operator-dense code, where identifier classification 
+// and operator recognition dominate.
+std::string dense_source(size_t size)
+{
+  const std::string chunk =
+    "template<typename T> class vector final : public base {\n"
+    "public:\n"
+    "  virtual const T& operator[](int i) const noexcept override { return data[i]; }\n"
+    "  static constexpr bool empty() { if (size <= 0 || !data) return true; else return false; }\n"
+    "  void shift(int n) { for (int i = 0; i < n; ++i) { x <<= 1; y >>= 2; z = x != y && y >= z; } }\n"
+    "  unsigned_int count; double_t ratio; namespaced_type* ptr;\n"
+    "};\n";
+
+  std::string result;
+  result.reserve(size + chunk.size());
+
+  while (result.size() < size)
+    result += chunk;
+
+  return result;
+}
+
+void bench_keywords()
+{
+  const std::string src = dense_source(16 * 1024 * 1024);
+
+  std::cout << "keywords: lexing " << src.size() / (1024 * 1024) << " MB" << std::endl;
+
+  size_t n = 0;
+  double t = measure([&]() { n = tokenize(src, parsers::Lexer::supportedInstructionSet()).size(); });
+  report("keywords+operators", t, src.size());
+  std::cout << "  " << n << " tokens" << std::endl;
+}
+
+void bench_token_buffer()
+{
+  const std::string src = dense_source(16 * 1024 * 1024);
+
+  std::cout << "token-buffer: storing the tokens of " << src.size() / (1024 * 1024) << " MB" << std::endl;
+
+  std::vector<parsers::Token> tokens;
+  parsers::TokenBuffer buffer;
+
+  double t = measure([&]() { tokens = tokenize(src, parsers::Lexer::supportedInstructionSet()); });
+  report("std::vector<Token>", t, src.size());
+
+  t = measure([&]() {
+    parsers::Lexer lexer;
+    lexer.reset(&src);
+    buffer.reset(parsers::StringView(src.data(), src.size()));
+
+    while (!lexer.atEnd())
+      buffer.push_back(lexer.read());
+  });
+  report("TokenBuffer", t, src.size());
+
+  t = measure([&]() { parsers::Lexer::lineOffsets(parsers::StringView(src.data(), src.size())); });
+  report("line offsets", t, src.size());
+
+  std::cout << "  " << tokens.size() << " tokens: "
+    << tokens.size() * sizeof(parsers::Token) / (1024 * 1024) << " MB as Token, "
+    << buffer.size() * sizeof(parsers::PackedToken) / (1024 * 1024) << " MB as PackedToken" << std::endl;
+}
+
+// Gives access to the parser's tokenization step.
+class TokenizingParser : public parsers::RestrictedParser
+{
+public:
+  explicit TokenizingParser(const std::string* src)
+    : RestrictedParser(src)
+  {
+
+  }
+
+  void lex(int threads)
+  {
+    lexer_threads = threads;
+    tokenize();
+  }
+};
+
+void bench_lexer_parallel()
+{
+  const std::string src = dense_source(64 * 1024 * 1024);
+
+  std::cout << "lexer-parallel: lexing " << src.size() / (1024 * 1024) << " MB" << std::endl;
+
+  TokenizingParser parser{ &src };
+
+  for (int threads : { 1, 2, 4, 8 })
+  {
+    double t = measure([&]() { parser.lex(threads); });
+    report(std::to_string(threads) + " thread(s)", t, src.size());
+  }
+
+  double t = measure([&]() { parsers::Lexer::splitPoints(parsers::StringView(src.data(), src.size()), 8); });
+  report("pre-scan (8 chunks)", t, src.size());
+}
+
+// Code with non-standard extensions and preprocessor lines, which the 
+// lexer does not understand.
+std::string vendor_source(size_t size)
+{
+  const std::string chunk =
+    "#pragma once\n"
+    "#define EXPORT __declspec(dllexport)\n"
+    "EXPORT int $counter = 0; @interface Foo;\n"
+    "static const char c = '\\n'; int mask = 0x;\n"
+    "template<typename T> class vector final : public base { int size; };\n";
+
+  std::string result;
+  result.reserve(size + chunk.size());
+
+  while (result.size() < size)
+    result += chunk;
+
+  return result;
+}
+
+void bench_lexer_errors()
+{
+  const std::string src = vendor_source(4 * 1024 * 1024);
+  const std::string valid = dense_source(4 * 1024 * 1024);
+
+  std::cout << "lexer-errors: lexing " << src.size() / (1024 * 1024) << " MB" << std::endl;
+
+  size_t errors = 0;
+
+  auto lex_throwing = [&](const std::string& input) {
+    parsers::Lexer lexer;
+    lexer.reset(&input);
+    errors = 0;
+
+    while (!lexer.atEnd())
+    {
+      try
+      {
+        lexer.read();
+      }
+      catch (const std::runtime_error&)
+      {
+        ++errors;
+        lexer.seek(lexer.pos() + 1);
+      }
+    }
+  };
+
+  auto lex_error_tokens = [&](const std::string& input) {
+    parsers::Lexer lexer;
+    lexer.setErrorMode(parsers::Lexer::ErrorTokens);
+    lexer.reset(&input);
+    errors = 0;
+
+    while (!lexer.atEnd())
+    {
+      if (lexer.read() == parsers::TokenType::Invalid)
+        ++errors;
+    }
+  };
+
+  double t = measure([&]() { lex_throwing(src); });
+  report("exceptions", t, src.size());
+  std::cout << "  " << errors << " errors" << std::endl;
+
+  t = measure([&]() { lex_error_tokens(src); });
+  report("error tokens", t, src.size());
+  std::cout << "  " << errors << " errors" << std::endl;
+
+  t = measure([&]() { lex_throwing(valid); });
+  report("valid, exceptions", t, valid.size());
+
+  t = measure([&]() { lex_error_tokens(valid); });
+  report("valid, error tokens", t, valid.size());
+}
+
+void bench_relex()
+{
+  std::string src = dense_source(4 * 1024 * 1024);
+  std::string edited = src;
+  const size_t offset = src.find("data[i]", src.size() / 2);
+  edited.insert(offset + 4, "x");
+
+  std::cout << "relex: one-char edit in " << src.size() / (1024 * 1024) << " MB" << std::endl;
+
+  auto full_lex = [](const std::string& input, parsers::TokenBuffer& buffer) {
+    parsers::Lexer lexer;
+    lexer.reset(&input);
+    buffer.reset(parsers::StringView(input.data(), input.size()));
+
+    while (!lexer.atEnd())
+      buffer.push_back(lexer.read());
+  };
+
+  parsers::TokenBuffer buffer;
+
+  double t = measure([&]() { full_lex(edited, buffer); });
+  report("full lex", t, src.size());
+
+  // alternates between inserting and removing the char
+  full_lex(src, buffer);
+  bool inserted = false;
+  parsers::SourceEdit edit;
+  edit.offset = offset + 4;
+
+  t = measure([&]() {
+    parsers::Lexer lexer;
+    lexer.reset(inserted ? &src : &edited);
+    edit.removed = inserted ? 1 : 0;
+    edit.inserted = inserted ? 0 : 1;
+    lexer.relex(buffer, edit);
+    inserted = !inserted;
+  }, 20);
+  report("relex", t, src.size());
+}
+
+void bench_batch_parser()
+{
+  const int nb_files = 400;
+  std::vector<std::string> files;
+  size_t bytes = 0;
+
+  for (int i(0); i < nb_files; ++i)
+  {
+    std::string content = "#include \"bench-batch-parser.h\"\n";
+
+    for (int j(0); j < 100; ++j)
+    {
+      content += "namespace ns" + std::to_string(j % 7) + " {\n"
+        "  class Widget" + std::to_string(i) + "_" + std::to_string(j) + " { public: int size() const; void resize(int n); };\n"
+        "  int compute" + std::to_string(j) + "(int a, int b) { int c = a + b; return c * 2; }\n"
+        "}\n";
+    }
+
+    files.push_back("bench-batch-parser-" + std::to_string(i) + ".cpp");
+    std::ofstream{ files.back() } << content;
+    bytes += content.size();
+  }
+
+  std::ofstream{ "bench-batch-parser.h" } << "#pragma once\nnamespace ns0 { void shared(int n); }\n";
+
+  std::cout << "batch-parser: parsing " << nb_files << " files, " << bytes / 1024 << " KB" << std::endl;
+
+  size_t errors = 0;
+
+  for (int threads : { 1, 2, 4, 8 })
+  {
+    double t = measure([&]() {
+      cxx::FileSystem fs;
+      parsers::BatchParser parser{ fs };
+      parser.threads = threads;
+      parser.parse(files);
+      errors = parser.errors.size();
+    }, 3);
+
+    report(std::to_string(threads) + " thread(s)", t, bytes);
+  }
+
+  std::cout << "  " << errors << " errors" << std::endl;
+}
+
+// Function bodies made of expression statements, each of which the
+// RestrictedParser must first try to parse as a declaration.
+std::string function_bodies(size_t nb_functions)
+{
+  std::string result;
+
+  for (size_t i(0); i < nb_functions; ++i)
+  {
+    result += "int process" + std::to_string(i) + "(Context& ctx, int a, int b)\n"
+      "{\n"
+      "  int c = a + b;\n"
+      "  c = c * 2;\n"
+      "  ctx.counter += c;\n"
+      "  update(ctx, a, b);\n"
+      "  ctx.items.push_back(c);\n"
+      "  std::cout << c << std::endl;\n"
+      "  a < b;\n"
+      "  ++c;\n"
+      "  if (a < b) { c = a; } else { c = b; }\n"
+      "  while (a < b) { c = c + a; ctx.log(a); ++a; }\n"
+      "  return c;\n"
+      "}\n\n";
+  }
+
+  return result;
+}
+
+// Declarations only, as found in headers.
+std::string declarations(size_t nb_classes)
+{
+  std::string result;
+
+  for (size_t i(0); i < nb_classes; ++i)
+  {
+    const std::string name = "Component" + std::to_string(i);
+
+    result += "namespace components\n"
+      "{\n"
+      "  class " + name + "\n"
+      "  {\n"
+      "  public:\n"
+      "    const std::string& name() const;\n"
+      "    void setName(const std::string& name);\n"
+      "    std::vector<std::shared_ptr<Node>> children() const;\n"
+      "    virtual int priority() const;\n"
+      "    static const int count;\n"
+      "    std::map<std::string, int> attributes;\n"
+      "    int x = 0, y = 0;\n"
+      "    void swap(" + name + "& other);\n"
+      "  };\n"
+      "  std::vector<int> indices;\n"
+      "}\n\n";
+  }
+
+  return result;
+}
+
+void bench_declarations()
+{
+  const std::string src = declarations(4000);
+
+  std::cout << "declarations: parsing " << src.size() / 1024 << " KB" << std::endl;
+
+  double t = measure([&]() {
+    cxx::FileSystem fs;
+    parsers::RestrictedParser parser{ fs };
+    parser.parse("bench-declarations.h", src);
+  }, 3);
+  report("restricted parser", t, src.size());
+}
+
+void bench_function_bodies()
+{
+  const std::string src = function_bodies(4000);
+
+  std::cout << "function-bodies: parsing " << src.size() / 1024 << " KB" << std::endl;
+
+  double t = measure([&]() {
+    cxx::FileSystem fs;
+    parsers::RestrictedParser parser{ fs };
+    parser.parse("bench-function-bodies.cpp", src);
+  }, 3);
+  report("restricted parser", t, src.size());
+
+  t = measure([&]() {
+    cxx::FileSystem fs;
+    parsers::RestrictedParser parser{ fs };
+    parser.skip_function_bodies = true;
+    parser.parse("bench-function-bodies.cpp", src);
+  }, 3);
+  report("skipping bodies", t, src.size());
+
+  t = measure([&]() {
+    cxx::FileSystem fs;
+    parsers::RestrictedParser parser{ fs };
+    parser.skip_function_bodies = true;
+    parser.skip_function_body_tokens = true;
+    parser.parse("bench-function-bodies.cpp", src);
+  }, 3);
+  report("without lexing bodies", t, src.size());
+}
+
+// Mimics the libclang parser, which parses the spelling of every
+// elaborated type it meets.
+void bench_type_cache()
+{
+  std::vector<std::string> spellings;
+
+  for (int i(0); i < 300; ++i)
+  {
+    const std::string n = std::to_string(i);
+    spellings.push_back("std::vector<std::pair<ns::Key" + n + ", std::shared_ptr<const ns::Value" + n + ">>>");
+  }
+
+  const int repeat = 100;
+
+  std::cout << "type-cache: parsing " << spellings.size() << " spellings " << repeat << " times" << std::endl;
+
+  parsers::TypeCache& cache = parsers::TypeCache::GlobalInstance();
+  const size_t capacity = cache.capacity();
+
+  for (size_t c : { size_t(0), capacity })
+  {
+    cache.setCapacity(c);
+    cache.clear();
+    cache.resetCounters();
+
+    size_t bytes = 0;
+
+    double t = measure([&]() {
+      for (int i(0); i < repeat; ++i)
+      {
+        for (const std::string& s : spellings)
+        {
+          parsers::RestrictedParser::parseType(s);
+          bytes += s.size();
+        }
+      }
+    }, 1);
+
+    report(c == 0 ? "without cache" : "with cache", t, bytes);
+    std::cout << "  " << cache.hits() << " hits, " << cache.misses() << " misses" << std::endl;
+  }
+
+  cache.setCapacity(capacity);
+}
+
+// The static functions of the RestrictedParser, as the libclang parser 
+// calls them on every declaration it meets.
+void bench_string_parsers()
+{
+  std::vector<std::string> signatures;
+  std::vector<std::string> variables;
+
+  for (int i(0); i < 1000; ++i)
+  {
+    const std::string n = std::to_string(i);
+    signatures.push_back("void process" + n + "(const std::vector<int>& values, int count" + n + ")");
+    variables.push_back("std::map<std::string, int> table" + n);
+  }
+
+  const int repeat = 20;
+  size_t bytes = 0;
+
+  std::cout << "string-parsers: parsing " << signatures.size() + variables.size() << " strings " << repeat << " times" << std::endl;
+
+  double t = measure([&]() {
+    for (int i(0); i < repeat; ++i)
+    {
+      for (const std::string& s : signatures)
+      {
+        parsers::RestrictedParser::parseFunctionSignature(s);
+        bytes += s.size();
+      }
+    }
+  }, 1);
+  report("function signatures", t, bytes);
+
+  bytes = 0;
+
+  t = measure([&]() {
+    for (int i(0); i < repeat; ++i)
+    {
+      for (const std::string& s : variables)
+      {
+        parsers::RestrictedParser::parseVariable(s);
+        bytes += s.size();
+      }
+    }
+  }, 1);
+  report("variables", t, bytes);
+}
+
+size_t count_nodes(const AstNode& node)
+{
+  size_t n = 1;
+
+  for (const std::shared_ptr<AstNode>& child : node.children())
+  {
+    if (child)
+      n += count_nodes(*child);
+  }
+
+  return n;
+}
+
+void bench_arena()
+{
+  const std::string src = declarations(2000) + function_bodies(2000);
+
+  std::cout << "arena: parsing " << src.size() / 1024 << " KB" << std::endl;
+
+  for (bool arena : { false, true })
+  {
+    std::shared_ptr<AstNode> ast;
+    std::shared_ptr<Program> program;
+    size_t allocations = 0;
+
+    double t = measure([&]() {
+      ast = nullptr;
+      program = nullptr;
+
+      const size_t before = g_allocations;
+
+      {
+        cxx::FileSystem fs;
+        parsers::RestrictedParser parser{ fs };
+        parser.arena_allocation = arena;
+        parser.parse("bench-arena.cpp", src);
+        ast = fs.get("bench-arena.cpp")->ast;
+        program = parser.program();
+      }
+
+      allocations = g_allocations - before;
+    }, 3);
+
+    std::cout << (arena ? " with arena" : " without arena") << std::endl;
+    report("parse", t, src.size());
+    std::cout << "  " << allocations << " allocations" << std::endl;
+
+    size_t nodes = 0;
+    t = measure([&]() { nodes = count_nodes(*ast); }, 10);
+    report("traverse", t, src.size());
+    std::cout << "  " << nodes << " nodes" << std::endl;
+
+    t = measure([&]() {
+      ast = nullptr;
+      program = nullptr;
+    }, 1);
+    report("release", t, src.size());
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::map<std::string, std::function<void()>> benchmarks = {
+    { "arena", bench_arena },
+    { "batch-parser", bench_batch_parser },
+    { "declarations", bench_declarations },
+    { "function-bodies", bench_function_bodies },
+    { "keywords", bench_keywords },
+    { "lexer-errors", bench_lexer_errors },
+    { "lexer-parallel", bench_lexer_parallel },
+    { "lexer-simd", bench_lexer_simd },
+    { "relex", bench_relex },
+    { "string-parsers", bench_string_parsers },
+    { "token-buffer", bench_token_buffer },
+    { "type-cache", bench_type_cache },
+  };
+
+  std::vector<std::string> selected{ argv + 1, argv + argc };
+
+  if (selected.empty())
+  {
+    for (const auto& b : benchmarks)
+      selected.push_back(b.first);
+  }
+
+  for (const std::string& name : selected)
+  {
+    auto it = benchmarks.find(name);
+
+    if (it == benchmarks.end())
+    {
+      std::cerr << "unknown benchmark: " << name << std::endl;
+      return 1;
+    }
+
+    it->second();
+  }
+
+  return 0;
+}
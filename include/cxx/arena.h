@@ -0,0 +1,108 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_ARENA_H
+#define CXXAST_ARENA_H
+
+#include "cxx/cxxast-defs.h"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cxx
+{
+
+// A monotonic allocator: memory is taken from large blocks and is only
+// released, all at once, when the Arena is destroyed.
+// An Arena is used by one thread at a time.
+class CXXAST_API Arena
+{
+public:
+  explicit Arena(size_t block_size = 64 * 1024);
+  Arena(const Arena&) = delete;
+  ~Arena();
+
+  void* allocate(size_t size, size_t alignment);
+
+  size_t allocations() const { return m_allocations; }
+  size_t bytesAllocated() const { return m_bytes_allocated; }
+  size_t bytesReserved() const { return m_bytes_reserved; }
+
+  Arena& operator=(const Arena&) = delete;
+
+private:
+  size_t m_block_size;
+  std::vector<std::unique_ptr<char[]>> m_blocks;
+  char* m_ptr = nullptr;
+  char* m_end = nullptr;
+  size_t m_allocations = 0;
+  size_t m_bytes_allocated = 0;
+  size_t m_bytes_reserved = 0;
+};
+
+// An allocator for std::allocate_shared() that takes its memory from an Arena.
+// Every object allocated this way shares the ownership of the arena, which
+// therefore lives until the last of them is destroyed.
+template<typename T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(std::shared_ptr<Arena> arena)
+    : m_arena(std::move(arena))
+  {
+
+  }
+
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other)
+    : m_arena(other.arena())
+  {
+
+  }
+
+  T* allocate(size_t n)
+  {
+    return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, size_t)
+  {
+
+  }
+
+  const std::shared_ptr<Arena>& arena() const { return m_arena; }
+
+private:
+  std::shared_ptr<Arena> m_arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+{
+  return lhs.arena() == rhs.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs)
+{
+  return lhs.arena() != rhs.arena();
+}
+
+// Creates a T in 'arena', or with std::make_shared() if 'arena' is null.
+template<typename T, typename...Args>
+std::shared_ptr<T> make_node(const std::shared_ptr<Arena>& arena, Args&&... args)
+{
+  if (arena)
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+  else
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+} // namespace cxx
+
+#endif // CXXAST_ARENA_H
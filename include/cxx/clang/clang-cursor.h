@@ -82,6 +82,14 @@ public:
     return result;
   }
 
+  std::string getUSR() const
+  {
+    CXString str = libclang->clang_getCursorUSR(this->cursor);
+    std::string result = libclang->clang_getCString(str);
+    libclang->clang_disposeString(str);
+    return result;
+  }
+
   std::string getCursorKindSpelling() const
   {
     CXString str = libclang->clang_getCursorKindSpelling(kind());
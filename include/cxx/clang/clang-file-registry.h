@@ -0,0 +1,55 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_CLANG_FILE_REGISTRY_H
+#define CXXAST_CLANG_FILE_REGISTRY_H
+
+#include "cxx/libclang.h"
+
+#include <array>
+#include <map>
+#include <mutex>
+
+namespace cxx
+{
+
+// The files claimed by parsers that fill the same program, possibly on 
+// different threads. A file is identified by clang_getFileUniqueID(), so 
+// that it is the same whatever the translation unit and the path it is 
+// included with.
+// The parser that claims a file first converts its declarations, the 
+// others skip them.
+// A file is claimed with a token given by newOwner(); unlike the address 
+// of an object, a token is never reused.
+class CXXAST_API ClangFileRegistry
+{
+public:
+  typedef size_t Owner;
+
+public:
+  ClangFileRegistry() = default;
+  ClangFileRegistry(const ClangFileRegistry&) = delete;
+
+  static Owner newOwner();
+
+  bool claim(const CXFileUniqueID& id, Owner owner);
+  bool isClaimed(const CXFileUniqueID& id) const;
+  size_t size() const;
+  void clear();
+
+  ClangFileRegistry& operator=(const ClangFileRegistry&) = delete;
+
+private:
+  typedef std::array<unsigned long long, 3> Key;
+
+  static Key key(const CXFileUniqueID& id);
+
+private:
+  mutable std::mutex m_mutex;
+  std::map<Key, Owner> m_files;
+};
+
+} // namespace cxx
+
+#endif // CXXAST_CLANG_FILE_REGISTRY_H
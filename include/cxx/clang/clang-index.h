@@ -8,6 +8,8 @@
 #include "cxx/libclang.h"
 
 #include <set>
+#include <string>
+#include <vector>
 
 namespace cxx
 {
@@ -44,6 +46,7 @@ public:
   }
 
   ClangTranslationUnit parseTranslationUnit(const std::string& file, const std::set<std::string>& includedirs, int options = 0);
+  ClangTranslationUnit parseTranslationUnit(const std::string& file, const std::vector<std::string>& args, int options = 0);
 };
 
 } // namespace cxx
@@ -0,0 +1,90 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_CLANG_TRANSLATION_UNIT_CACHE_H
+#define CXXAST_CLANG_TRANSLATION_UNIT_CACHE_H
+
+#include "cxx/clang/clang-translation-unit.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cxx
+{
+
+class ClangIndex;
+
+// A directory of translation units saved by libclang, so that a file is not
+// parsed again while neither it, the files it includes, the arguments nor
+// the version of libclang change.
+// An entry is keyed by a hash of the content and path of the main file, the
+// arguments, the parse options and the libclang version; the files it
+// includes are checked against the hash of their content when it is loaded.
+// The least recently used entries are removed when the cache grows beyond
+// 'maxSize' bytes. The directory must exist. Its index, which records the
+// last use of each entry, is written when an entry is stored, when the cache
+// is cleared and when it is destroyed.
+// A cache can be shared by parsers running on different threads, but not
+// by several processes.
+class CXXAST_API ClangTranslationUnitCache
+{
+public:
+  struct Statistics
+  {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t stores = 0;
+    size_t evictions = 0;
+  };
+
+public:
+  explicit ClangTranslationUnitCache(std::string directory, size_t max_size = 512 * 1024 * 1024);
+  ClangTranslationUnitCache(const ClangTranslationUnitCache&) = delete;
+  ~ClangTranslationUnitCache();
+
+  const std::string& directory() const { return m_directory; }
+  size_t maxSize() const { return m_max_size; }
+  size_t size() const;
+  size_t count() const;
+  Statistics statistics() const;
+
+  ClangTranslationUnit load(ClangIndex& index, const std::string& file, const std::vector<std::string>& args, int options);
+  bool store(const ClangTranslationUnit& tu, const std::string& file, const std::vector<std::string>& args, int options);
+
+  void clear();
+
+  ClangTranslationUnitCache& operator=(const ClangTranslationUnitCache&) = delete;
+
+protected:
+  std::string key(const LibClang& libclang, const std::string& file, const std::vector<std::string>& args, int options) const;
+  std::string path(const std::string& key, const char* extension) const;
+
+  void remove(const std::string& key);
+  void evict();
+  void readIndex();
+  void writeIndex();
+
+private:
+  struct Entry
+  {
+    size_t size = 0;
+    size_t last_use = 0;
+  };
+
+  std::string m_directory;
+  size_t m_max_size;
+  mutable std::mutex m_mutex;
+  std::map<std::string, Entry> m_entries;
+  size_t m_size = 0;
+  size_t m_tick = 0;
+  size_t m_temporaries = 0;
+  bool m_index_dirty = false;
+  Statistics m_statistics;
+};
+
+} // namespace cxx
+
+#endif // CXXAST_CLANG_TRANSLATION_UNIT_CACHE_H
@@ -49,7 +49,7 @@ public:
 public:
   ~Class() = default;
 
-  explicit Class(std::string name, std::shared_ptr<IEntity> parent = nullptr);
+  explicit Class(Symbol name, std::shared_ptr<IEntity> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::Class;
   NodeKind node_kind() const override;
@@ -80,7 +80,7 @@ public:
   std::vector<std::shared_ptr<TemplateParameter>> template_parameters;
 
 public:
-  ClassTemplate(std::vector<std::shared_ptr<TemplateParameter>> tparams, std::string name, std::shared_ptr<IEntity> parent = nullptr);
+  ClassTemplate(std::vector<std::shared_ptr<TemplateParameter>> tparams, Symbol name, std::shared_ptr<IEntity> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::ClassTemplate;
   NodeKind node_kind() const override;
@@ -94,7 +94,7 @@ public:
 namespace cxx
 {
 
-inline Class::Class(std::string name, std::shared_ptr<IEntity> parent)
+inline Class::Class(Symbol name, std::shared_ptr<IEntity> parent)
   : IEntity{std::move(name), std::move(parent)}
 {
 
@@ -8,6 +8,7 @@
 #include "cxx/node.h"
 
 #include "cxx/access-specifier.h"
+#include "cxx/symbol.h"
 
 namespace cxx
 {
@@ -17,12 +18,12 @@ class Documentation;
 class CXXAST_API IEntity : public INode
 {
 public:
-  std::string name;
+  Symbol name;
   std::weak_ptr<IEntity> weak_parent;
   std::shared_ptr<Documentation> documentation;
 
 public:
-  explicit IEntity(std::string name, std::shared_ptr<IEntity> parent = nullptr);
+  explicit IEntity(Symbol name, std::shared_ptr<IEntity> parent = nullptr);
 
   std::shared_ptr<IEntity> shared_from_this();
   std::shared_ptr<const IEntity> shared_from_this() const;
@@ -34,16 +35,16 @@ public:
   virtual AccessSpecifier getAccessSpecifier() const;
   virtual void setAccessSpecifier(AccessSpecifier aspec);
 
-  struct Name : public priv::Field<IEntity, std::string>
+  struct Name : public priv::Field<IEntity, Symbol>
   {
-    static std::string& get(INode& n)
+    static Symbol& get(INode& n)
     {
       return down_cast(n).name;
     }
 
-    static void set(INode& n, std::string name)
+    static void set(INode& n, Symbol name)
     {
-      down_cast(n).name = std::move(name);
+      down_cast(n).name = name;
     }
   };
 };
@@ -68,8 +69,8 @@ public:
 namespace cxx
 {
 
-inline IEntity::IEntity(std::string n, std::shared_ptr<IEntity> parent)
-  : name(std::move(n)),
+inline IEntity::IEntity(Symbol n, std::shared_ptr<IEntity> parent)
+  : name(n),
     weak_parent(parent)
 {
 
@@ -17,8 +17,8 @@ class Enum;
 class CXXAST_API EnumValue : public IEntity
 {
 public:
-  explicit EnumValue(std::string name, std::shared_ptr<Enum> parent = nullptr);
-  EnumValue(std::string name, std::string value, std::shared_ptr<Enum> parent = nullptr);
+  explicit EnumValue(Symbol name, std::shared_ptr<Enum> parent = nullptr);
+  EnumValue(Symbol name, std::string value, std::shared_ptr<Enum> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::EnumValue;
   NodeKind node_kind() const override;
@@ -43,7 +43,7 @@ public:
 public:
   ~Enum() = default;
 
-  explicit Enum(std::string name, std::shared_ptr<IEntity> parent = nullptr);
+  explicit Enum(Symbol name, std::shared_ptr<IEntity> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::Enum;
   NodeKind node_kind() const override;
@@ -70,7 +70,7 @@ public:
 namespace cxx
 {
 
-inline Enum::Enum(std::string name, std::shared_ptr<IEntity> parent)
+inline Enum::Enum(Symbol name, std::shared_ptr<IEntity> parent)
   : IEntity{std::move(name), std::move(parent)}
 {
 
@@ -10,13 +10,22 @@
 namespace cxx
 {
 
+// An expression that is only known by its text.
+// The text can be a range of a source shared by many expressions,
+// in which case the string is only built by toString().
 class CXXAST_API UnexposedExpression : public IExpression
 {
 private:
-  std::string m_source;
+  std::string m_src;
+  std::shared_ptr<const char> m_text;
+  size_t m_size = 0;
 
 public:
   explicit UnexposedExpression(std::string src);
+  UnexposedExpression(std::shared_ptr<const char> text, size_t size);
+
+  const char* data() const { return m_text ? m_text.get() : m_src.data(); }
+  size_t size() const { return m_size; }
 
   NodeKind node_kind() const override;
 
@@ -14,6 +14,7 @@
 namespace cxx
 {
 
+class Arena;
 class AstNode;
 
 class File
@@ -23,6 +24,7 @@ private:
 
 public:
   std::shared_ptr<AstNode> ast;
+  std::shared_ptr<Arena> arena; // where the nodes of 'ast' are, if not on the heap
 
 public:
   explicit File(std::string path);
@@ -61,8 +61,8 @@ public:
   Expression default_value;
 
 public:
-  FunctionParameter(Type type, std::string name, std::shared_ptr<Function> parent = nullptr);
-  FunctionParameter(Type type, std::string name, Expression default_value, std::shared_ptr<Function> parent = nullptr);
+  FunctionParameter(Type type, Symbol name, std::shared_ptr<Function> parent = nullptr);
+  FunctionParameter(Type type, Symbol name, Expression default_value, std::shared_ptr<Function> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::FunctionParameter;
   NodeKind node_kind() const override;
@@ -83,7 +83,7 @@ public:
 public:
   ~Function() = default;
 
-  explicit Function(std::string name, std::shared_ptr<IEntity> parent = nullptr);
+  explicit Function(Symbol name, std::shared_ptr<IEntity> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::Function;
   NodeKind node_kind() const override;
@@ -147,7 +147,7 @@ public:
   std::vector<std::shared_ptr<TemplateParameter>> template_parameters;
 
 public:
-  FunctionTemplate(std::vector<std::shared_ptr<TemplateParameter>> tparams, std::string name, std::shared_ptr<IEntity> parent = nullptr);
+  FunctionTemplate(std::vector<std::shared_ptr<TemplateParameter>> tparams, Symbol name, std::shared_ptr<IEntity> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::FunctionTemplate;
   NodeKind node_kind() const override;
@@ -161,7 +161,7 @@ public:
 namespace cxx
 {
 
-inline Function::Function(std::string name, std::shared_ptr<IEntity> parent)
+inline Function::Function(Symbol name, std::shared_ptr<IEntity> parent)
   : IEntity{std::move(name), std::move(parent)}
 {
 
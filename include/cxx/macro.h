@@ -18,7 +18,7 @@ public:
   std::vector<std::string> parameters;
 
 public:
-  Macro(std::string name, std::vector<std::string> params, std::shared_ptr<IEntity> parent = nullptr);
+  Macro(Symbol name, std::vector<std::string> params, std::shared_ptr<IEntity> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::Macro;
   NodeKind node_kind() const override;
@@ -29,7 +29,7 @@ public:
 namespace cxx
 {
 
-inline Macro::Macro(std::string name, std::vector<std::string> params, std::shared_ptr<IEntity> parent)
+inline Macro::Macro(Symbol name, std::vector<std::string> params, std::shared_ptr<IEntity> parent)
   : IEntity{ std::move(name), std::move(parent) },
     parameters(std::move(params))
 {
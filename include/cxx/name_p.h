@@ -6,6 +6,7 @@
 #define CXXAST_NAME_P_H
 
 #include "cxx/name.h"
+#include "cxx/symbol.h"
 #include "cxx/template.h"
 #include "cxx/type.h"
 
@@ -23,10 +24,12 @@ namespace details
 class CXXAST_API Identifier : public IName
 {
 private:
-  std::string m_name;
+  Symbol m_name;
 
 public:
-  explicit Identifier(std::string name);
+  explicit Identifier(Symbol name);
+
+  Symbol symbol() const { return m_name; }
 
   bool isIdentifier() const override;
   std::string toString() const override;
@@ -72,11 +75,11 @@ public:
 class CXXAST_API TemplateName : public IName
 {
 private:
-  std::string m_name;
+  Symbol m_name;
   std::vector<TemplateArgument> m_targs;
 
 public:
-  explicit TemplateName(std::string name, std::vector<TemplateArgument> targ = {});
+  explicit TemplateName(Symbol name, std::vector<TemplateArgument> targ = {});
 
   bool isTemplateName() const override;
 
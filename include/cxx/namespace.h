@@ -30,18 +30,18 @@ public:
   static constexpr NodeKind ClassNodeKind = NodeKind::Namespace;
   NodeKind node_kind() const override;
 
-  explicit Namespace(std::string name, std::shared_ptr<IEntity> parent = nullptr);
+  explicit Namespace(Symbol name, std::shared_ptr<IEntity> parent = nullptr);
 
-  std::shared_ptr<Namespace> getOrCreateNamespace(const std::string& name);
-  std::shared_ptr<Class> createClass(std::string name);
-  std::shared_ptr<Class> getOrCreateClass(const std::string& name);
-  std::shared_ptr<Enum> createEnum(std::string name);
-  std::shared_ptr<Function> createFunction(std::string name);
+  std::shared_ptr<Namespace> getOrCreateNamespace(Symbol name);
+  std::shared_ptr<Class> createClass(Symbol name);
+  std::shared_ptr<Class> getOrCreateClass(Symbol name);
+  std::shared_ptr<Enum> createEnum(Symbol name);
+  std::shared_ptr<Function> createFunction(Symbol name);
 
   template<typename T, typename...Args>
-  std::shared_ptr<T> getOrCreate(const std::string& name, Args&&... args)
+  std::shared_ptr<T> getOrCreate(Symbol name, Args&&... args)
   {
-    auto it = std::find_if(entities.begin(), entities.end(), [&name](const std::shared_ptr<IEntity>& e) {
+    auto it = std::find_if(entities.begin(), entities.end(), [name](const std::shared_ptr<IEntity>& e) {
       return e->is<T>() && e->name == name;
       });
 
@@ -72,7 +72,7 @@ public:
 namespace cxx
 {
 
-inline Namespace::Namespace(std::string name, std::shared_ptr<IEntity> parent)
+inline Namespace::Namespace(Symbol name, std::shared_ptr<IEntity> parent)
   : IEntity{ std::move(name), std::move(parent) }
 {
 
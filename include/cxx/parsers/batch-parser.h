@@ -0,0 +1,95 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_BATCH_PARSER_H
+#define CXXAST_BATCH_PARSER_H
+
+#include "cxx/cxxast-defs.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cxx
+{
+
+class ClangTranslationUnitCache;
+class FileSystem;
+class Program;
+
+namespace parsers
+{
+
+class CompilationDatabase;
+
+// The BatchParser parses many files with the RestrictedParser on several threads.
+// Each worker thread has its own parser and parses each file into a program
+// of its own; these partial programs are merged into the final program in
+// the order of the input files, so that the result does not depend on the
+// number of threads.
+// Entities of a partial program are merged with the entities of the same kind
+// and name (functions must also have the same signature) that are already in
+// the final program.
+// With error_recovery, the statements the RestrictedParser cannot parse are
+// listed in 'errors' but the rest of the file is still merged.
+// With use_libclang, the files are parsed with the LibClangParser instead:
+// each worker has its own parser, and thus its own CXIndex, and the
+// declarations libclang gives that cannot be converted are reported
+// in 'errors' if error_recovery is set.
+// With share_headers, the libclang workers also share a ClangFileRegistry:
+// a header is converted by the first worker that reaches it and skipped by
+// the others. Less work is done, but the order of the entities may then
+// depend on the scheduling of the threads.
+class CXXAST_API BatchParser
+{
+public:
+  std::set<std::string> includedirs;
+  std::map<std::string, std::string> defines;
+  bool skip_function_bodies = false;
+  bool skip_function_body_tokens = false;
+  bool error_recovery = false;
+  bool arena_allocation = false;
+  int threads = 0; // 0 means one per hardware thread
+
+  bool use_libclang = false;
+  bool background_priority = false; // libclang parses with a background priority
+  bool share_headers = false; // libclang only
+  std::shared_ptr<CompilationDatabase> compilation_database; // libclang only
+  std::shared_ptr<ClangTranslationUnitCache> translation_unit_cache; // libclang only
+
+  struct Error
+  {
+    std::string filepath;
+    std::string message;
+    int line = -1;
+    int column = -1;
+  };
+
+  std::vector<Error> errors;
+
+public:
+  BatchParser();
+  ~BatchParser() = default;
+
+  explicit BatchParser(cxx::FileSystem& fs);
+  BatchParser(std::shared_ptr<Program> prog, cxx::FileSystem& fs);
+
+  std::shared_ptr<Program> program() const;
+
+  bool parse(const std::vector<std::string>& files);
+
+  static std::vector<std::string> listFiles(const std::string& directory, const std::set<std::string>& extensions);
+
+private:
+  cxx::FileSystem& m_filesystem;
+  std::shared_ptr<Program> m_program;
+};
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_BATCH_PARSER_H
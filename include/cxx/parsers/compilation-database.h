@@ -0,0 +1,57 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_COMPILATION_DATABASE_H
+#define CXXAST_COMPILATION_DATABASE_H
+
+#include "cxx/cxxast-defs.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+// The compile commands of a project, as written by CMake and other build
+// systems in a compile_commands.json file.
+// Malformed input raises a std::runtime_error.
+class CXXAST_API CompilationDatabase
+{
+public:
+  struct Command
+  {
+    std::string directory;
+    std::string file; // absolute
+    std::vector<std::string> arguments; // starting with the compiler
+  };
+
+public:
+  CompilationDatabase() = default;
+
+  static CompilationDatabase load(const std::string& path);
+  static CompilationDatabase fromJson(const std::string& json);
+
+  const std::vector<Command>& commands() const { return m_commands; }
+  const Command* find(const std::string& file) const;
+
+  static std::vector<std::string> splitCommandLine(const std::string& command);
+  static std::vector<std::string> parserArguments(const Command& command);
+
+private:
+  void add(Command command);
+
+private:
+  std::vector<Command> m_commands;
+  std::map<std::string, size_t> m_files;
+};
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_COMPILATION_DATABASE_H
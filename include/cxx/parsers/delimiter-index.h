@@ -0,0 +1,98 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_DELIMITER_INDEX_H
+#define CXXAST_DELIMITER_INDEX_H
+
+#include "cxx/parsers/token-buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+// A DelimiterIndex maps the opening delimiters of a TokenBuffer to the
+// tokens that close them, so that the parser can jump to the end of a
+// parenthesized, bracketed or braced sequence without scanning it.
+// Parentheses, brackets and braces are each matched by counting, ignoring
+// the other kinds of delimiters.
+// A '<' is matched with the '>' that ends the template argument list it
+// would start; whether it actually starts one is up to the parser.
+// Template angle brackets are only indexed if the other delimiters are
+// properly nested.
+class CXXAST_API DelimiterIndex
+{
+public:
+  static const size_t npos = static_cast<size_t>(-1);
+
+  enum AngleStatus : std::uint8_t
+  {
+    Unknown,          // the index cannot tell, tokens must be scanned
+    Unmatched,        // no '>' before the end of input
+    Matched,          // closed by a '>'
+    MatchedShift,     // closed by a '>>' that also closes a nested list
+    MatchedNested,    // closed by the first half of a '>>' (see MatchedShift)
+    UnmatchedParen,   // a ')' closes a parenthesis opened before the '<'
+    UnmatchedBracket, // a ']' closes a bracket opened before the '<'
+  };
+
+  struct AngleMatch
+  {
+    AngleStatus status;
+    size_t index; // the closing token, or the token that ends the search
+  };
+
+public:
+  DelimiterIndex() = default;
+
+  void build(const TokenBuffer& tokens);
+  void clear();
+
+  bool empty() const { return m_entries.empty(); }
+  bool nested() const { return m_nested; }
+
+  size_t closing(size_t index) const;
+  AngleMatch angle(size_t index) const;
+
+private:
+  struct Entry
+  {
+    std::uint32_t match;
+    AngleStatus status;
+  };
+
+  // The stacks of '<' waiting for a '>', one per nesting level.
+  // Popped levels keep their capacity.
+  struct AngleStack
+  {
+    std::vector<std::vector<std::uint32_t>> levels;
+    size_t size = 0;
+
+    void reset();
+    std::vector<std::uint32_t>& back() { return levels[size - 1]; }
+    void emplace_back();
+    void pop_back() { --size; }
+  };
+
+  std::vector<Entry> m_entries;
+  bool m_nested = false;
+
+  // used by build()
+  std::vector<std::uint32_t> m_parens;
+  std::vector<std::uint32_t> m_brackets;
+  std::vector<std::uint32_t> m_braces;
+  std::vector<TokenType::Value> m_nesting;
+  AngleStack m_angles;
+};
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_DELIMITER_INDEX_H
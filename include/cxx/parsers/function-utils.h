@@ -0,0 +1,28 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_FUNCTIONUTILS_H
+#define CXXAST_FUNCTIONUTILS_H
+
+#include "cxx/function.h"
+
+#include <memory>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+// Helpers shared by the parsers to merge the declarations of a function.
+
+bool are_equiv_func(const cxx::Function& a, const cxx::Function& b);
+std::shared_ptr<cxx::Function> find_equiv_func(cxx::INode& current_node, const cxx::Function& func);
+void update_func(cxx::Function& func, const cxx::Function& new_one);
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_FUNCTIONUTILS_H
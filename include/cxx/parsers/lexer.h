@@ -7,19 +7,34 @@
 
 #include "cxx/parsers/token.h"
 
+#include "cxx/parsers/source-buffer.h"
+#include "cxx/parsers/token-buffer.h"
+
+#include <cstdint>
+#include <vector>
+
 namespace cxx
 {
 
 namespace parsers
 {
 
+// Replacement of 'removed' bytes at 'offset' by 'inserted' bytes.
+struct SourceEdit
+{
+  size_t offset = 0;
+  size_t removed = 0;
+  size_t inserted = 0;
+};
+
 class CXXAST_API Lexer
 {
 public:
   Lexer() = default;
   explicit Lexer(const std::string* src);
+  explicit Lexer(const SourceBuffer& src);
 
-  const std::string& source() const;
+  StringView source() const;
 
   void start();
 
@@ -32,7 +47,53 @@ public:
   int col() const;
 
   void seek(size_t pos);
+  bool skipBraces();
   void reset(const std::string* src);
+  void reset(const SourceBuffer& src);
+  void reset(const char* data, size_t length);
+
+  std::pair<size_t, size_t> relex(TokenBuffer& tokens, const SourceEdit& edit, bool discard_comments = false);
+
+  // Instruction set used to skip whitespaces and comments.
+  // The vectorized paths produce exactly the same tokens as the scalar one.
+  enum InstructionSet {
+    Scalar,
+    SSE2,
+    AVX2,
+  };
+
+  static InstructionSet supportedInstructionSet();
+  static std::vector<std::uint32_t> lineOffsets(StringView source);
+  static std::vector<size_t> splitPoints(StringView source, size_t chunks);
+  InstructionSet instructionSet() const;
+  void setInstructionSet(InstructionSet iset);
+
+  // By default, malformed input raises a std::runtime_error.
+  // In ErrorTokens mode, read() never throws: it returns a token of type 
+  // Invalid covering the malformed input, sets error() and carries on.
+  enum ErrorMode {
+    ThrowOnError,
+    ErrorTokens,
+  };
+
+  enum Error {
+    NoError,
+    UnexpectedEndOfInput,
+    UnexpectedCharacter,
+    MalformedNumericLiteral,
+    UnterminatedStringLiteral,
+    MalformedCharLiteral,
+    UnterminatedComment,
+  };
+
+  ErrorMode errorMode() const;
+  void setErrorMode(ErrorMode mode);
+  Error error() const;
+
+  // When enabled, user-defined names are interned while being read
+  // and carry their Symbol.
+  bool internIdentifiers() const;
+  void setInternIdentifiers(bool on);
 
   enum CharacterType {
     Invalid,
@@ -77,6 +138,8 @@ protected:
   char currentChar() const;
   inline char peekChar() const { return currentChar(); }
   void consumeDiscardable();
+  Token readToken();
+  Token fail(size_t pos, Error err, const char* what);
   Token create(size_t pos, size_t length, TokenType type);
   Token create(size_t pos, TokenType type);
   Token readNumericLiteral(size_t pos);
@@ -100,11 +163,15 @@ private:
   friend class LexerGuard;
 
 private:
-  const std::string* m_source = nullptr;
-  const char* m_chars = nullptr;
+  const char* m_chars = "";
+  size_t m_length = 0;
   size_t m_pos = 0;
   int m_line = 0;
-  int m_col = 0;
+  size_t m_line_start = 0;
+  InstructionSet m_iset = supportedInstructionSet();
+  ErrorMode m_error_mode = ThrowOnError;
+  Error m_error = NoError;
+  bool m_intern_identifiers = false;
 };
 
 } // namespace parsers
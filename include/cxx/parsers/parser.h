@@ -6,10 +6,14 @@
 #define CXXAST_PARSERS_PARSER_H
 
 #include "cxx/clang/clang-cursor.h"
+#include "cxx/clang/clang-file-registry.h"
 #include "cxx/clang/clang-index.h"
 #include "cxx/clang/clang-translation-unit.h"
+#include "cxx/clang/clang-translation-unit-cache.h"
+#include "cxx/parsers/compilation-database.h"
 
 #include <cxx/access-specifier.h>
+#include "cxx/arena.h"
 #include "cxx/function.h"
 
 #include <map>
@@ -40,6 +44,13 @@ public:
   std::set<std::string> includedirs;
   std::map<std::string, std::string> defines;
   bool skip_function_bodies = false;
+  bool arena_allocation = false; // allocate the nodes of each file in an Arena
+  std::shared_ptr<CompilationDatabase> compilation_database; // gives the arguments of the files it knows
+  unsigned int parse_options = CXTranslationUnit_None; // CXTranslationUnit_Flags, e.g. Incomplete or KeepGoing
+  bool keep_translation_units = false; // keep what reparse() needs, with a precompiled preamble
+  std::shared_ptr<ClangTranslationUnitCache> translation_unit_cache; // not used with keep_translation_units
+  unsigned int index_options = CXGlobalOpt_None; // CXGlobalOptFlags, e.g. ThreadBackgroundPriorityForIndexing
+  std::shared_ptr<ClangFileRegistry> file_registry; // shared by parsers that fill the same program
 
   struct SkippedDeclaration
   {
@@ -58,19 +69,28 @@ public:
   LibClangParser(std::shared_ptr<Program> prog, cxx::FileSystem& fs);
 
   std::shared_ptr<Program> program() const;
+  void setProgram(std::shared_ptr<Program> p);
 
   bool parse(const std::string& file);
 
-  // @TODO: implement a reparse() function
-  // This function reparse a file to fill the body of each function, without
-  // clearing the existing ast (which might be referenced elsewhere in the application)
-  // bool reparse(std::shared_ptr<cxx::File> file, std::shared_ptr<cxx::AstRootNode>); 
+  bool reparse(const std::string& file);
+  bool reparse(const std::string& file, const std::string& content);
+
+  std::vector<std::string> arguments(const std::string& file) const;
 
   static cxx::AccessSpecifier getAccessSpecifier(CX_CXXAccessSpecifier as);
 
 protected:
   std::shared_ptr<File> getFile(const std::string& path);
   void commitCurrentFile();
+  void visitTranslationUnit(const std::string& file);
+  bool reparseTranslationUnit(const std::string& file, const std::string* content);
+  void detach(AstNode& node, std::vector<std::shared_ptr<IEntity>>& entities);
+  void detachFile(const std::shared_ptr<File>& file, std::vector<std::shared_ptr<IEntity>>& entities);
+  bool claim(CXFile file);
+
+  std::shared_ptr<Class> getOrCreateClass(INode& scope, std::string name, bool is_template, AccessSpecifier access);
+  std::shared_ptr<IEntity> getScope(const ClangCursor& cursor);
   cxx::INode& curNode();
 
   void astWrite(std::shared_ptr<AstNode> n);
@@ -81,6 +101,12 @@ protected:
   void localizeParentize(const std::shared_ptr<AstNode>& node, const ClangCursor& c);
   void bind(const std::shared_ptr<AstNode>& astnode, const std::shared_ptr<INode>& n);
 
+  template<typename T, typename...Args>
+  std::shared_ptr<T> make(Args&&... args)
+  {
+    return make_node<T>(m_arena, std::forward<Args>(args)...);
+  }
+
   /* Visitor callbacks */
   void visit(const ClangCursor& cursor);
   void visit_tu(const ClangCursor& cursor);
@@ -140,12 +166,20 @@ private:
 
   CXFile m_tu_file = nullptr;
   CXFile m_current_cxfile = nullptr;
+  CXFile m_skipped_cxfile = nullptr;
   std::shared_ptr<File> m_current_file = nullptr;
+  std::shared_ptr<Arena> m_arena;
 
   std::vector<std::shared_ptr<AstNode>> m_unlocated_nodes;
   std::set<std::shared_ptr<File>> m_parsed_files;
 
-  std::unordered_map<ClangCursor, std::shared_ptr<IEntity>> m_cursor_entity_map;
+  std::map<std::string, ClangTranslationUnit> m_translation_units; // see keep_translation_units
+
+  // claims the files of the current program in the file registry, 0 until the first claim
+  ClangFileRegistry::Owner m_registry_owner = 0;
+
+  // classes by USR, which unlike cursors remain valid across translation units
+  std::unordered_map<std::string, std::weak_ptr<IEntity>> m_class_map;
 
   cxx::AccessSpecifier m_access_specifier = cxx::AccessSpecifier::PUBLIC;
   std::vector<std::shared_ptr<cxx::INode>> m_program_stack;
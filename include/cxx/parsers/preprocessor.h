@@ -0,0 +1,65 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_PREPROCESSOR_H
+#define CXXAST_PREPROCESSOR_H
+
+#include "cxx/parsers/token.h"
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+// A lightweight preprocessor for the RestrictedParser.
+// It evaluates conditional directives against a table of macros, keeps
+// that table up to date with #define and #undef, and forwards the #include
+// directives that resolve through the include directories.
+// Macros are not expanded in the source itself.
+// Headers with an include guard or a #pragma once are detected so that
+// they are processed only once.
+class CXXAST_API Preprocessor
+{
+public:
+  std::set<std::string> includedirs;
+  std::map<std::string, std::string> macros;
+
+  // Called with the path of each included file that must be processed.
+  std::function<void(const std::string&)> include_handler;
+
+public:
+  Preprocessor() = default;
+
+  static bool hasDirectives(StringView source);
+
+  std::vector<std::pair<size_t, size_t>> process(const std::string& filepath, StringView source);
+
+  bool isDefined(const std::string& name) const;
+  long long evaluate(const std::string& expr) const;
+
+  std::string resolveInclude(const std::string& name, bool angled, const std::string& includer) const;
+  bool isGuarded(const std::string& filepath) const;
+
+private:
+  void include(const std::string& filepath);
+
+private:
+  std::map<std::string, std::string> m_guards;
+  std::set<std::string> m_once;
+  int m_include_depth = 0;
+};
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_PREPROCESSOR_H
@@ -0,0 +1,156 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_REPARSEUTILS_H
+#define CXXAST_REPARSEUTILS_H
+
+#include "cxx/class.h"
+#include "cxx/declaration.h"
+#include "cxx/filesystem.h"
+#include "cxx/namespace.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+inline void collect_entities(const AstNode& node, std::set<const IEntity*>& entities)
+{
+  if (node.isDeclaration())
+    entities.insert(static_cast<const IDeclaration&>(node).entity_ptr.get());
+
+  for (std::shared_ptr<AstNode> child : node.children())
+  {
+    if (child)
+      collect_entities(*child, entities);
+  }
+}
+
+// Puts the members of 'cla' back in the order of their declarations
+// in 'definition'; the others are left after them.
+inline void sort_members(Class& cla, const AstNode& definition)
+{
+  std::map<const IEntity*, size_t> rank;
+
+  for (std::shared_ptr<AstNode> child : definition.children())
+  {
+    if (child && child->isDeclaration())
+      rank.emplace(static_cast<const IDeclaration&>(*child).entity_ptr.get(), rank.size());
+  }
+
+  auto rank_of = [&rank](const std::shared_ptr<IEntity>& e) {
+    auto it = rank.find(e.get());
+    return it != rank.end() ? it->second : rank.size();
+  };
+
+  std::stable_sort(cla.members.begin(), cla.members.end(), [&rank_of](const std::shared_ptr<IEntity>& a, const std::shared_ptr<IEntity>& b) {
+    return rank_of(a) < rank_of(b);
+    });
+}
+
+inline void collect_class_definitions(const AstNode& node, const std::set<const IEntity*>& classes, std::map<const IEntity*, const AstNode*>& definitions)
+{
+  if (node.isDeclaration() && !node.children().empty())
+  {
+    const IEntity* entity = static_cast<const IDeclaration&>(node).entity_ptr.get();
+
+    if (classes.find(entity) != classes.end())
+      definitions[entity] = &node;
+  }
+
+  for (std::shared_ptr<AstNode> child : node.children())
+  {
+    if (child)
+      collect_class_definitions(*child, classes, definitions);
+  }
+}
+
+// Removes from the program the discarded entities that no declaration of 
+// 'root', nor of the AST of another file of 'fs', refers to anymore. 
+// A namespace is only removed if it is empty.
+// The entities that are kept keep their place in their scope and the ones 
+// created by the reparse are appended to it, so the entities of a namespace 
+// may not be in the order a new parse would give. The members of a class 
+// defined again in 'root' are put back in the order of its definition.
+inline void remove_discarded(const AstNode& root, const std::vector<std::shared_ptr<IEntity>>& discarded, const FileSystem& fs)
+{
+  if (discarded.empty())
+    return;
+
+  std::set<const IEntity*> declared;
+  collect_entities(root, declared);
+
+  std::set<const IEntity*> classes;
+  bool other_files_collected = false;
+
+  for (const std::shared_ptr<IEntity>& entity : discarded)
+  {
+    if (declared.find(entity.get()) != declared.end())
+    {
+      if (entity->is<Class>())
+        classes.insert(entity.get());
+
+      continue;
+    }
+
+    // the entity may still be declared by another file, e.g. a function 
+    // whose definition was removed
+    if (!other_files_collected)
+    {
+      for (const std::shared_ptr<File>& file : fs.files)
+      {
+        if (file->ast && file->ast.get() != &root)
+          collect_entities(*file->ast, declared);
+      }
+
+      other_files_collected = true;
+
+      if (declared.find(entity.get()) != declared.end())
+        continue;
+    }
+
+    if (entity->is<Namespace>() && !static_cast<Namespace&>(*entity).entities.empty())
+      continue;
+
+    std::shared_ptr<IEntity> parent = entity->parent();
+
+    auto remove_from = [&entity](std::vector<std::shared_ptr<IEntity>>& entities) {
+      entities.erase(std::remove(entities.begin(), entities.end(), entity), entities.end());
+    };
+
+    if (!parent)
+      continue;
+    else if (parent->is<Namespace>())
+      remove_from(static_cast<Namespace&>(*parent).entities);
+    else if (parent->is<Class>())
+      remove_from(static_cast<Class&>(*parent).members);
+  }
+
+  if (classes.empty())
+    return;
+
+  std::map<const IEntity*, const AstNode*> definitions;
+  collect_class_definitions(root, classes, definitions);
+
+  for (const std::shared_ptr<IEntity>& entity : discarded)
+  {
+    auto it = definitions.find(entity.get());
+
+    if (it != definitions.end())
+      sort_members(static_cast<Class&>(*entity), *it->second);
+  }
+}
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_REPARSEUTILS_H
@@ -5,11 +5,16 @@
 #ifndef CXXAST_BUILTIN_PARSER_H
 #define CXXAST_BUILTIN_PARSER_H
 
+#include "cxx/parsers/delimiter-index.h"
 #include "cxx/parsers/lexer.h"
+#include "cxx/parsers/preprocessor.h"
+#include "cxx/parsers/token-buffer.h"
 
+#include "cxx/arena.h"
 #include "cxx/function.h"
 #include "cxx/macro.h"
 #include "cxx/name.h"
+#include "cxx/sourcelocation.h"
 #include "cxx/template.h"
 #include "cxx/typedef.h"
 #include "cxx/variable.h"
@@ -17,6 +22,7 @@
 #include <map>
 #include <set>
 #include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 namespace cxx
@@ -31,6 +37,8 @@ class Program;
 namespace parsers
 {
 
+class TypeCache;
+
 class RestrictedParserError : public std::runtime_error
 {
 public:
@@ -43,22 +51,63 @@ public:
   }
 };
 
+// The result of a speculative parse.
+// On failure, 'error' describes the problem and 'failure_pos' is the index
+// of the token at which the parse failed.
+template<typename T>
+struct ParseResult
+{
+  T value;
+  size_t failure_pos = 0;
+  const char* error = nullptr;
+
+  explicit operator bool() const { return error == nullptr; }
+};
+
 class CXXAST_API RestrictedParser
 {
 public:
   std::set<std::string> includedirs;
   std::map<std::string, std::string> defines;
   bool skip_function_bodies = false;
+  bool skip_function_body_tokens = false; // with skip_function_bodies, do not even lex the bodies
+  int lexer_threads = 1;
+  bool error_recovery = false;
+  bool incremental = false; // keep what reparse() needs
+  bool arena_allocation = false; // allocate the nodes of each file in an Arena
+
+  // An error the parser recovered from (see error_recovery)
+  struct Error
+  {
+    std::string message;
+    SourceLocation location;
+  };
+
+  std::vector<Error> errors;
+
+  // A change to a source: 'length' bytes at 'offset' are replaced by 'text'
+  struct Edit
+  {
+    size_t offset = 0;
+    size_t length = 0;
+    std::string text;
+  };
 
 public:
 
   RestrictedParser();
   ~RestrictedParser() = default;
 
+  explicit RestrictedParser(cxx::FileSystem& fs);
+  RestrictedParser(std::shared_ptr<Program> prog, cxx::FileSystem& fs);
+
   bool parse(const std::string& filepath);
   bool parse(const std::string& filepath, const std::string& content);
+  bool parse(const std::string& filepath, SourceBuffer content);
   std::shared_ptr<AstRootNode> parseSource(const std::string& content);
 
+  bool reparse(const std::string& filepath, const std::vector<Edit>& edits);
+
   std::shared_ptr<Program> program() const;
   void setProgram(std::shared_ptr<Program> p);
 
@@ -70,17 +119,31 @@ public:
 
 protected:
   RestrictedParser(const std::string* src);
+  void resetSource(const std::string* src);
+  static bool threadParserInUse();
 
   Type parseType();
-  Type tryReadFunctionSignature(const Type& result_type);
+  ParseResult<Type> tryParseType();
+  ParseResult<Type> readType();
+  size_t findTypeEnd() const;
+  ParseResult<Type> tryReadFunctionSignature(const Type& result_type);
 
   Name parseName();
+  ParseResult<Name> tryParseName();
+
+  ParseResult<Type> memoizedParseType();
+  ParseResult<Name> memoizedParseName();
 
   std::shared_ptr<Function> parseFunctionSignature();
   std::shared_ptr<Variable> parseVariable();
   std::shared_ptr<Typedef> parseTypedef();
   std::shared_ptr<Macro> parseMacro();
 
+  bool parseFile(const std::string& filepath);
+  void parseInclude(const std::string& filepath);
+  void tokenize();
+  void readTokens();
+
 protected:
   bool atEnd() const;
   Token read();
@@ -90,19 +153,22 @@ protected:
   Token prev() const;
   bool isDiscardable(const Token& t) const;
   Token read(TokenType::Value tokt);
+  bool tryRead(TokenType::Value tokt);
   size_t pos() const;
   size_t pos(const Token& tok) const;
   void seek(size_t pos);
   void seekBegin();
   void seekEnd();
+  std::pair<size_t, size_t> view() const;
+  void setView(size_t begin, size_t end);
 
   std::string viewstring() const;
   std::string stringtoend() const;
 
 protected:
-  Name readOperatorName();
-  Name readUserDefinedName();
-  Name readTemplateArguments(const Name base);
+  ParseResult<Name> readOperatorName();
+  ParseResult<Name> readUserDefinedName();
+  ParseResult<Name> readTemplateArguments(const Name base);
 
 protected:
   TemplateArgument parseDelimitedTemplateArgument();
@@ -123,6 +189,8 @@ protected:
   void bind(const std::shared_ptr<AstNode>& astnode, const std::shared_ptr<INode>& n);
 
   Statement parseStatement();
+  Statement parseStatementOrRecover();
+  size_t findStatementEnd(size_t start) const;
   NodeKind detectStatement();
   Statement parseFunctionBody(std::shared_ptr<cxx::Function> f);
   /* statements */
@@ -155,16 +223,89 @@ protected:
   std::shared_ptr<cxx::VariableDeclaration> parseVarDecl();
 
   Expression parseExpression();
+  std::shared_ptr<const char> sharedSource();
+
+private:
+  // A memoized speculative parse.
+  // 'horizon' is the index of the last token that the parse looked at; the
+  // result remains valid in another view as long as both views extend past it.
+  template<typename T>
+  struct MemoEntry
+  {
+    ParseResult<T> result;
+    size_t end = 0;
+    size_t view_end = 0;
+    size_t horizon = 0;
+  };
+
+  // Speculative parses keyed by (rule, token index)
+  struct ParseMemo
+  {
+    std::unordered_map<size_t, MemoEntry<Type>> types;
+    std::unordered_map<size_t, MemoEntry<Name>> names;
+
+    void clear()
+    {
+      types.clear();
+      names.clear();
+    }
+  };
+
+  class StringParser;
+  struct ReparseState;
+
+  // What reparse() needs to know about a file parsed with 'incremental'
+  struct IncrementalFile
+  {
+    std::shared_ptr<const char> source;
+    size_t size = 0;
+    TokenBuffer tokens;
+    bool preprocessed = false;
+  };
+
+  // What the statements being parsed in error recovery mode added to the
+  // program: the size of the scopes they entered and the previous
+  // bindings of the entities they bound
+  struct RecoveryJournal
+  {
+    std::vector<std::pair<std::vector<std::shared_ptr<IEntity>>*, size_t>> scopes;
+    std::vector<std::pair<INode*, std::shared_ptr<AstNode>>> bindings;
+    int depth = 0;
+  };
+
+  void journalScope(INode& scope);
+  void rollback(size_t scopes, size_t bindings);
+
+  void reparseScope(std::vector<std::shared_ptr<AstNode>>& childvec, ReparseState& state);
+  void discard(AstNode& node, ReparseState& state);
+
+  template<typename T, typename...Args>
+  std::shared_ptr<T> make(Args&&... args)
+  {
+    return make_node<T>(m_arena, std::forward<Args>(args)...);
+  }
+
+  template<typename T>
+  ParseResult<T> memoize(std::unordered_map<size_t, MemoEntry<T>>& table, ParseResult<T>(RestrictedParser::*parse)());
 
 private:
   cxx::FileSystem* m_filesystem = nullptr;
   std::shared_ptr<Program> m_program;
 
 private:
+  SourceBuffer m_source;
+  std::shared_ptr<const char> m_shared_source;
+  std::shared_ptr<Preprocessor> m_preprocessor;
   Lexer m_lexer;
-  std::vector<Token> m_buffer;
+  TokenBuffer m_buffer;
+  DelimiterIndex m_delimiters;
   std::pair<size_t, size_t> m_view;
   size_t m_index = 0;
+  size_t m_horizon = 0;
+  ParseMemo m_memo;
+  TypeCache* m_type_cache = nullptr;
+  std::shared_ptr<Arena> m_arena;
+  std::map<std::string, IncrementalFile> m_incremental_files;
 
 private:
   friend class RaiiAstLocator;
@@ -172,6 +313,7 @@ private:
   std::vector<std::shared_ptr<cxx::AstNode>> m_ast_stack;
   cxx::AccessSpecifier m_access_specifier = cxx::AccessSpecifier::PUBLIC;
   std::vector<std::shared_ptr<cxx::INode>> m_program_stack;
+  RecoveryJournal m_recovery;
   bool m_parsing_function_body = false;
 };
 
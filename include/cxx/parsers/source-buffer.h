@@ -0,0 +1,64 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_SOURCE_BUFFER_H
+#define CXXAST_SOURCE_BUFFER_H
+
+#include "cxx/parsers/token.h"
+
+#include <string>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+// A SourceBuffer holds the content of a source file.
+// Files are memory-mapped when possible, otherwise they are read
+// with a single read into an exactly sized buffer.
+// A SourceBuffer can also be a non-owning view over existing memory.
+class CXXAST_API SourceBuffer
+{
+public:
+  SourceBuffer() = default;
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer(SourceBuffer&& other) noexcept;
+  ~SourceBuffer();
+
+  static SourceBuffer view(const char* data, size_t size);
+  static SourceBuffer view(const std::string& str);
+  static SourceBuffer open(const std::string& filepath);
+
+  const char* data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  StringView str() const { return StringView(m_data, m_size); }
+
+  bool isMapped() const { return m_storage == Mapped; }
+  bool isView() const { return m_storage == View; }
+
+  void clear();
+
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+
+private:
+  enum Storage {
+    View,
+    Mapped,
+    Allocated,
+  };
+
+private:
+  const char* m_data = "";
+  size_t m_size = 0;
+  Storage m_storage = View;
+};
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_SOURCE_BUFFER_H
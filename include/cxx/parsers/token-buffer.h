@@ -0,0 +1,73 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_TOKEN_BUFFER_H
+#define CXXAST_TOKEN_BUFFER_H
+
+#include "cxx/parsers/token.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+struct PackedToken
+{
+  std::uint32_t offset;
+  std::uint32_t length;
+  TokenType::Value type;
+};
+
+// A TokenBuffer stores the tokens of a source as offsets into it.
+// The line and column of a token are not stored: they are computed
+// on demand from a table of line offsets, built on first use.
+class CXXAST_API TokenBuffer
+{
+public:
+  TokenBuffer() = default;
+
+  StringView source() const { return m_source; }
+  void reset(StringView source);
+
+  size_t size() const { return m_tokens.size(); }
+  bool empty() const { return m_tokens.empty(); }
+  void clear();
+
+  void push_back(const Token& tok);
+  void append(const TokenBuffer& other);
+  void insert(size_t index, const Token& tok);
+  void erase(size_t index);
+  void set(size_t index, const Token& tok);
+  void splice(size_t first, size_t last, const TokenBuffer& tokens, std::ptrdiff_t shift);
+
+  TokenType type(size_t index) const { return m_tokens[index].type; }
+  StringView text(size_t index) const;
+  size_t offset(size_t index) const { return m_tokens[index].offset; }
+
+  Token at(size_t index) const;
+  Token operator[](size_t index) const { return at(index); }
+
+  int line(size_t offset) const;
+  int col(size_t offset) const;
+
+private:
+  PackedToken pack(const Token& tok) const;
+  const std::vector<std::uint32_t>& lineOffsets() const;
+
+private:
+  StringView m_source;
+  std::vector<PackedToken> m_tokens;
+  mutable std::vector<std::uint32_t> m_line_offsets;
+};
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_TOKEN_BUFFER_H
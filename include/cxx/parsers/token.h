@@ -6,6 +6,7 @@
 #define CXXAST_TOKEN_H
 
 #include "cxx/cxxast-defs.h"
+#include "cxx/symbol.h"
 
 #include <string>
 
@@ -265,6 +266,7 @@ class Token
 {
 private:
   TokenType type_;
+  Symbol symbol_;
   StringView str_;
   // @TODO: try to merge 'col_' and 'type_' to save space
   int line_ = -1;
@@ -295,6 +297,11 @@ public:
   int line() const { return line_; }
   int col() const { return col_; }
 
+  // The text of the token as a Symbol, interned on demand
+  // unless the lexer already did it.
+  Symbol symbol() const { return symbol_.empty() ? Symbol(str_.data(), str_.size()) : symbol_; }
+  void setSymbol(Symbol s) { symbol_ = s; }
+
   bool isOperator() const { return type_.value() & TokenCategory::OperatorToken; }
   bool isIdentifier() const { return type_.value() & TokenCategory::Identifier; }
   bool isKeyword() const { return (type_.value() & TokenCategory::Keyword) == TokenCategory::Keyword; }
@@ -0,0 +1,59 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_TYPE_CACHE_H
+#define CXXAST_TYPE_CACHE_H
+
+#include "cxx/type.h"
+
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+// A thread-safe cache of parsed types, keyed by their spelling.
+// Types are immutable and can therefore be shared by every entity
+// that has the same spelling, whatever the thread that parsed them.
+// The cache holds at most capacity() types; it is emptied when a new
+// type would exceed that bound. A capacity of 0 disables the cache.
+class CXXAST_API TypeCache
+{
+public:
+  explicit TypeCache(size_t capacity = 4096);
+  ~TypeCache() = default;
+
+  static TypeCache& GlobalInstance();
+
+  bool find(const std::string& spelling, Type& result);
+  void insert(const std::string& spelling, const Type& type);
+  Type intern(const Type& type);
+
+  size_t size() const;
+  size_t capacity() const;
+  void setCapacity(size_t capacity);
+  void clear();
+
+  size_t hits() const { return m_hits; }
+  size_t misses() const { return m_misses; }
+  void resetCounters();
+
+private:
+  mutable std::shared_timed_mutex m_mutex;
+  std::unordered_map<std::string, Type> m_types;
+  size_t m_capacity;
+  std::atomic<size_t> m_hits{ 0 };
+  std::atomic<size_t> m_misses{ 0 };
+};
+
+} // namespace parsers
+
+} // namespace cxx
+
+#endif // CXXAST_TYPE_CACHE_H
@@ -0,0 +1,160 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CXXAST_SYMBOL_H
+#define CXXAST_SYMBOL_H
+
+#include "cxx/cxxast-defs.h"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace cxx
+{
+
+// A Symbol is an interned string.
+// Each distinct string is stored once in a process-wide, thread-safe
+// table and symbols are compared by their 32-bit id.
+// The id 0 is reserved for the empty string.
+class CXXAST_API Symbol
+{
+private:
+  std::uint32_t m_id = 0;
+
+public:
+  Symbol() = default;
+  Symbol(const Symbol&) = default;
+  ~Symbol() = default;
+
+  Symbol(const std::string& str);
+  Symbol(const char* str);
+  Symbol(const char* str, size_t size);
+
+  static Symbol fromId(std::uint32_t id);
+  static size_t count();
+
+  std::uint32_t id() const { return m_id; }
+
+  const std::string& str() const;
+  bool empty() const { return m_id == 0; }
+  size_t size() const { return str().size(); }
+
+  operator const std::string&() const { return str(); }
+
+  Symbol& operator=(const Symbol&) = default;
+};
+
+inline Symbol::Symbol(const char* str)
+  : Symbol(str, std::strlen(str))
+{
+
+}
+
+inline Symbol::Symbol(const std::string& str)
+  : Symbol(str.data(), str.size())
+{
+
+}
+
+inline bool operator==(const Symbol& lhs, const Symbol& rhs)
+{
+  return lhs.id() == rhs.id();
+}
+
+inline bool operator!=(const Symbol& lhs, const Symbol& rhs)
+{
+  return lhs.id() != rhs.id();
+}
+
+inline bool operator==(const Symbol& lhs, const std::string& rhs)
+{
+  return lhs.str() == rhs;
+}
+
+inline bool operator==(const std::string& lhs, const Symbol& rhs)
+{
+  return lhs == rhs.str();
+}
+
+inline bool operator!=(const Symbol& lhs, const std::string& rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator!=(const std::string& lhs, const Symbol& rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator==(const Symbol& lhs, const char* rhs)
+{
+  return lhs.str() == rhs;
+}
+
+inline bool operator==(const char* lhs, const Symbol& rhs)
+{
+  return lhs == rhs.str();
+}
+
+inline bool operator!=(const Symbol& lhs, const char* rhs)
+{
+  return !(lhs == rhs);
+}
+
+inline bool operator!=(const char* lhs, const Symbol& rhs)
+{
+  return !(lhs == rhs);
+}
+
+// Symbols are ordered alphabetically, not by id
+inline bool operator<(const Symbol& lhs, const Symbol& rhs)
+{
+  return lhs.id() != rhs.id() && lhs.str() < rhs.str();
+}
+
+inline std::string operator+(const Symbol& lhs, const std::string& rhs)
+{
+  return lhs.str() + rhs;
+}
+
+inline std::string operator+(const std::string& lhs, const Symbol& rhs)
+{
+  return lhs + rhs.str();
+}
+
+inline std::string operator+(const Symbol& lhs, const char* rhs)
+{
+  return lhs.str() + rhs;
+}
+
+inline std::string operator+(const char* lhs, const Symbol& rhs)
+{
+  return lhs + rhs.str();
+}
+
+inline std::ostream& operator<<(std::ostream& out, const Symbol& s)
+{
+  return out << s.str();
+}
+
+} // namespace cxx
+
+namespace std
+{
+
+template<>
+struct hash<cxx::Symbol>
+{
+  size_t operator()(const cxx::Symbol& s) const
+  {
+    return std::hash<std::uint32_t>()(s.id());
+  }
+};
+
+} // namespace std
+
+#endif // CXXAST_SYMBOL_H
@@ -41,8 +41,8 @@ public:
   TemplateParameter(TemplateParameter&&) = default;
   ~TemplateParameter() = default;
 
-  explicit TemplateParameter(std::string name, Type default_value = {});
-  TemplateParameter(const Type& type, std::string name, std::string default_value = {});
+  explicit TemplateParameter(Symbol name, Type default_value = {});
+  TemplateParameter(const Type& type, Symbol name, std::string default_value = {});
 
   static constexpr NodeKind ClassNodeKind = NodeKind::TemplateParameter;
   NodeKind node_kind() const override;
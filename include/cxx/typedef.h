@@ -19,7 +19,7 @@ public:
   Type type;
 
 public:
-  Typedef(Type t, std::string name, std::shared_ptr<IEntity> parent = nullptr);
+  Typedef(Type t, Symbol name, std::shared_ptr<IEntity> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::Typedef;
   NodeKind node_kind() const override;
@@ -33,7 +33,7 @@ public:
 namespace cxx
 {
 
-inline Typedef::Typedef(Type t, std::string name, std::shared_ptr<IEntity> parent)
+inline Typedef::Typedef(Type t, Symbol name, std::shared_ptr<IEntity> parent)
   : IEntity{std::move(name), std::move(parent)},
     type(t)
 {
@@ -6,6 +6,7 @@
 #define CXXAST_TYPES_H
 
 #include "cxx/type.h"
+#include "cxx/symbol.h"
 
 namespace cxx
 {
@@ -13,10 +14,12 @@ namespace cxx
 class CXXAST_API SimpleType : public IType
 {
 private:
-  std::string m_name;
+  Symbol m_name;
 
 public:
-  explicit SimpleType(std::string name);
+  explicit SimpleType(Symbol name);
+
+  Symbol symbol() const { return m_name; }
 
   bool isSimple() const override;
   const std::string& name() const override;
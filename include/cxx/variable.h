@@ -32,8 +32,8 @@ public:
 class CXXAST_API Variable : public IEntity
 {
 public:
-  Variable(Type type, std::string name, std::shared_ptr<IEntity> parent = nullptr);
-  Variable(Type type, std::string name, Expression default_value, std::shared_ptr<IEntity> parent = nullptr);
+  Variable(Type type, Symbol name, std::shared_ptr<IEntity> parent = nullptr);
+  Variable(Type type, Symbol name, Expression default_value, std::shared_ptr<IEntity> parent = nullptr);
 
   static constexpr NodeKind ClassNodeKind = NodeKind::Variable;
   NodeKind node_kind() const override;
@@ -58,14 +58,14 @@ private:
 namespace cxx
 {
 
-inline Variable::Variable(Type type, std::string name, std::shared_ptr<IEntity> parent)
+inline Variable::Variable(Type type, Symbol name, std::shared_ptr<IEntity> parent)
   : IEntity{std::move(name), std::move(parent)},
     m_type{type}
 {
 
 }
 
-inline Variable::Variable(Type type, std::string name, Expression default_value, std::shared_ptr<IEntity> parent)
+inline Variable::Variable(Type type, Symbol name, Expression default_value, std::shared_ptr<IEntity> parent)
   : IEntity{ std::move(name), std::move(parent) },
     m_type{ type },
     m_default_value{ std::move(default_value) }
@@ -0,0 +1,62 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace cxx
+{
+
+Arena::Arena(size_t block_size)
+  : m_block_size(block_size)
+{
+
+}
+
+Arena::~Arena()
+{
+
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+  auto align = [alignment](char* p) -> char* {
+    const std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(p);
+    return p + ((alignment - addr % alignment) % alignment);
+  };
+
+  char* result = m_ptr ? align(m_ptr) : nullptr;
+
+  if (!result || result + size > m_end)
+  {
+    // objects larger than a block get a block of their own
+    const size_t block_size = std::max(m_block_size, size + alignment);
+    m_blocks.emplace_back(new char[block_size]);
+    m_bytes_reserved += block_size;
+
+    char* block = m_blocks.back().get();
+    result = align(block);
+
+    if (block_size == m_block_size)
+    {
+      m_end = block + block_size;
+    }
+    else
+    {
+      // keep on allocating from the current block
+      ++m_allocations;
+      m_bytes_allocated += size;
+      return result;
+    }
+  }
+
+  m_ptr = result + size;
+  ++m_allocations;
+  m_bytes_allocated += size;
+  return result;
+}
+
+} // namespace cxx
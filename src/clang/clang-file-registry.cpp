@@ -0,0 +1,49 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/clang/clang-file-registry.h"
+
+#include <atomic>
+
+namespace cxx
+{
+
+ClangFileRegistry::Owner ClangFileRegistry::newOwner()
+{
+  static std::atomic<Owner> last_owner{ 0 };
+  return ++last_owner;
+}
+
+// Returns true if the file was not claimed yet, or was claimed by 'owner'.
+bool ClangFileRegistry::claim(const CXFileUniqueID& id, Owner owner)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  auto it = m_files.emplace(key(id), owner).first;
+  return it->second == owner;
+}
+
+bool ClangFileRegistry::isClaimed(const CXFileUniqueID& id) const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_files.find(key(id)) != m_files.end();
+}
+
+size_t ClangFileRegistry::size() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_files.size();
+}
+
+void ClangFileRegistry::clear()
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  m_files.clear();
+}
+
+ClangFileRegistry::Key ClangFileRegistry::key(const CXFileUniqueID& id)
+{
+  return Key{ { id.data[0], id.data[1], id.data[2] } };
+}
+
+} // namespace cxx
@@ -11,19 +11,28 @@ namespace cxx
 
 ClangTranslationUnit ClangIndex::parseTranslationUnit(const std::string& file, const std::set<std::string>& includedirs, int options)
 {
-  const char* command_line_args[128] = { nullptr };
-  std::vector<std::string> argv{ "-x", "c++", "-Xclang", "-ast-dump", "-fsyntax-only" };
+  std::vector<std::string> args{ "-x", "c++" };
+
   for (const std::string& f : includedirs)
   {
-    argv.push_back("--include-directory");
-    argv.push_back(f);
+    args.push_back("-I");
+    args.push_back(f);
   }
-  for (int i(0); i < argv.size(); ++i)
-    command_line_args[i] = argv.at(i).data();
+
+  return parseTranslationUnit(file, args, options);
+}
+
+ClangTranslationUnit ClangIndex::parseTranslationUnit(const std::string& file, const std::vector<std::string>& args, int options)
+{
+  std::vector<const char*> command_line_args;
+  command_line_args.reserve(args.size());
+
+  for (const std::string& a : args)
+    command_line_args.push_back(a.c_str());
 
   CXTranslationUnit tu = nullptr;
 
-  CXErrorCode error = libclang.clang_parseTranslationUnit2(this->index, file.data(), command_line_args, static_cast<int>(argv.size()), nullptr, 0, options, &tu);
+  CXErrorCode error = libclang.clang_parseTranslationUnit2(this->index, file.data(), command_line_args.data(), static_cast<int>(command_line_args.size()), nullptr, 0, options, &tu);
 
   if (error)
     throw std::runtime_error{ "Could not parse translation unit" };
@@ -0,0 +1,319 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/clang/clang-translation-unit-cache.h"
+
+#include "cxx/clang/clang-index.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace cxx
+{
+
+// FNV-1a, 64 bits
+static std::uint64_t hash_bytes(const char* data, size_t size, std::uint64_t h = 14695981039346656037ull)
+{
+  for (size_t i(0); i < size; ++i)
+  {
+    h ^= static_cast<unsigned char>(data[i]);
+    h *= 1099511628211ull;
+  }
+
+  return h;
+}
+
+static std::uint64_t hash_string(const std::string& str, std::uint64_t h)
+{
+  // the terminating null separates consecutive strings
+  return hash_bytes(str.c_str(), str.size() + 1, h);
+}
+
+static bool read_file(const std::string& path, std::string& content)
+{
+  std::ifstream file{ path, std::ios::binary };
+
+  if (!file.is_open())
+    return false;
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  content = buffer.str();
+  return true;
+}
+
+static std::string to_hex(std::uint64_t h)
+{
+  char buffer[17];
+  std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(h));
+  return buffer;
+}
+
+static size_t file_size(const std::string& path)
+{
+  std::ifstream file{ path, std::ios::binary | std::ios::ate };
+  return file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+}
+
+ClangTranslationUnitCache::ClangTranslationUnitCache(std::string directory, size_t max_size)
+  : m_directory(std::move(directory)),
+    m_max_size(max_size)
+{
+  if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\')
+    m_directory.push_back('/');
+
+  readIndex();
+}
+
+// The last uses recorded by load() are only saved here, by store() and by clear().
+ClangTranslationUnitCache::~ClangTranslationUnitCache()
+{
+  if (m_index_dirty)
+    writeIndex();
+}
+
+size_t ClangTranslationUnitCache::size() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_size;
+}
+
+size_t ClangTranslationUnitCache::count() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_entries.size();
+}
+
+ClangTranslationUnitCache::Statistics ClangTranslationUnitCache::statistics() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_statistics;
+}
+
+// Returns the translation unit saved for 'file', or a null translation unit
+// if there is none or if one of the files it includes has changed.
+ClangTranslationUnit ClangTranslationUnitCache::load(ClangIndex& index, const std::string& file, const std::vector<std::string>& args, int options)
+{
+  const std::string k = key(index.libclang, file, args, options);
+
+  auto miss = [this, &k](bool stale) {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+
+    if (stale)
+      remove(k);
+
+    ++m_statistics.misses;
+    return ClangTranslationUnit();
+  };
+
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+
+    if (k.empty() || m_entries.find(k) == m_entries.end())
+    {
+      ++m_statistics.misses;
+      return ClangTranslationUnit();
+    }
+  }
+
+  // each line of the dependency list is the hash of a file and its path
+  std::ifstream deps{ path(k, ".deps") };
+  std::string line;
+  std::string content;
+
+  while (std::getline(deps, line))
+  {
+    if (line.size() < 18 || !read_file(line.substr(17), content) || to_hex(hash_bytes(content.data(), content.size())) != line.substr(0, 16))
+      return miss(true);
+  }
+
+  CXTranslationUnit tu = nullptr;
+
+  if (index.libclang.clang_createTranslationUnit2(index.index, path(k, ".ast").c_str(), &tu) != CXError_Success)
+    return miss(true);
+
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    auto it = m_entries.find(k);
+
+    if (it != m_entries.end())
+    {
+      it->second.last_use = ++m_tick;
+      m_index_dirty = true;
+    }
+
+    ++m_statistics.hits;
+  }
+
+  return ClangTranslationUnit{ index.libclang, tu };
+}
+
+// Saves 'tu', the result of parsing 'file' with 'args' and 'options'.
+// Returns false if libclang could not save it, e.g. because of errors
+// in the translation unit.
+bool ClangTranslationUnitCache::store(const ClangTranslationUnit& tu, const std::string& file, const std::vector<std::string>& args, int options)
+{
+  LibClang& libclang = *tu.libclang;
+  const std::string k = key(libclang, file, args, options);
+
+  if (k.empty())
+    return false;
+
+  std::string tmp;
+
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    tmp = path(k, ".tmp") + std::to_string(++m_temporaries);
+  }
+
+  if (libclang.clang_saveTranslationUnit(tu, tmp.c_str(), libclang.clang_defaultSaveOptions(tu)) != CXSaveError_None)
+  {
+    std::remove(tmp.c_str());
+    return false;
+  }
+
+  std::vector<CXFile> files;
+
+  libclang.clang_getInclusions(tu, [](CXFile included_file, CXSourceLocation*, unsigned, CXClientData data) {
+    static_cast<std::vector<CXFile>*>(data)->push_back(included_file);
+    }, &files);
+
+  const std::string deps_tmp = tmp + ".deps";
+
+  {
+    std::ofstream deps{ deps_tmp };
+    std::string content;
+
+    for (CXFile f : files)
+    {
+      const std::string name = libclang.toStdString(libclang.clang_getFileName(f));
+
+      if (!read_file(name, content))
+      {
+        // the entry could not be checked when loaded
+        deps.close();
+        std::remove(tmp.c_str());
+        std::remove(deps_tmp.c_str());
+        return false;
+      }
+
+      deps << to_hex(hash_bytes(content.data(), content.size())) << " " << name << "\n";
+    }
+  }
+
+  const size_t size = file_size(tmp) + file_size(deps_tmp);
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  remove(k);
+  std::rename(tmp.c_str(), path(k, ".ast").c_str());
+  std::rename(deps_tmp.c_str(), path(k, ".deps").c_str());
+
+  Entry& entry = m_entries[k];
+  entry.size = size;
+  entry.last_use = ++m_tick;
+  m_size += size;
+  ++m_statistics.stores;
+
+  evict();
+  writeIndex();
+
+  return true;
+}
+
+void ClangTranslationUnitCache::clear()
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  while (!m_entries.empty())
+    remove(m_entries.begin()->first);
+
+  writeIndex();
+}
+
+std::string ClangTranslationUnitCache::key(const LibClang& libclang, const std::string& file, const std::vector<std::string>& args, int options) const
+{
+  std::string content;
+
+  if (!read_file(file, content))
+    return std::string();
+
+  std::uint64_t h = hash_string(libclang.printableVersion(), 14695981039346656037ull);
+  h = hash_string(std::to_string(options), h);
+
+  for (const std::string& a : args)
+    h = hash_string(a, h);
+
+  h = hash_string(file, h);
+  h = hash_bytes(content.data(), content.size(), h);
+
+  return to_hex(h);
+}
+
+std::string ClangTranslationUnitCache::path(const std::string& key, const char* extension) const
+{
+  return m_directory + key + extension;
+}
+
+void ClangTranslationUnitCache::remove(const std::string& key)
+{
+  auto it = m_entries.find(key);
+
+  if (it == m_entries.end())
+    return;
+
+  std::remove(path(key, ".ast").c_str());
+  std::remove(path(key, ".deps").c_str());
+
+  m_size -= it->second.size;
+  m_entries.erase(it);
+}
+
+// Removes the least recently used entries until the cache fits in maxSize().
+void ClangTranslationUnitCache::evict()
+{
+  while (m_size > m_max_size && !m_entries.empty())
+  {
+    auto oldest = m_entries.begin();
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+      if (it->second.last_use < oldest->second.last_use)
+        oldest = it;
+    }
+
+    remove(oldest->first);
+    ++m_statistics.evictions;
+  }
+}
+
+// The index lists the entries with their size and last use, one per line.
+void ClangTranslationUnitCache::readIndex()
+{
+  std::ifstream index{ m_directory + "index" };
+  std::string k;
+  Entry e;
+
+  while (index >> k >> e.size >> e.last_use)
+  {
+    m_entries[k] = e;
+    m_size += e.size;
+    m_tick = std::max(m_tick, e.last_use);
+  }
+}
+
+void ClangTranslationUnitCache::writeIndex()
+{
+  std::ofstream index{ m_directory + "index" };
+
+  for (const auto& e : m_entries)
+    index << e.first << " " << e.second.size << " " << e.second.last_use << "\n";
+
+  m_index_dirty = false;
+}
+
+} // namespace cxx
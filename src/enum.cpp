@@ -9,13 +9,13 @@
 namespace cxx
 {
 
-EnumValue::EnumValue(std::string name, std::shared_ptr<Enum> parent)
+EnumValue::EnumValue(Symbol name, std::shared_ptr<Enum> parent)
   : IEntity(std::move(name), parent)
 {
 
 }
 
-EnumValue::EnumValue(std::string name, std::string value, std::shared_ptr<Enum> parent)
+EnumValue::EnumValue(Symbol name, std::string value, std::shared_ptr<Enum> parent)
   : IEntity(std::move(name), parent),
     m_value(std::move(value))
 {
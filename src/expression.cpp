@@ -5,7 +5,9 @@
 #include "cxx/expression.h"
 #include "cxx/expressions.h"
 
+#include <cstring>
 #include <stdexcept>
+#include <typeinfo>
 
 namespace cxx
 {
@@ -23,8 +25,18 @@ bool IExpression::isUnexposed() const
 }
 
 
+// The text of an expression that does not refer to a source is
+// stored in the expression.
 UnexposedExpression::UnexposedExpression(std::string src)
-  : m_source(std::move(src))
+  : m_src(std::move(src)),
+    m_size(m_src.size())
+{
+
+}
+
+UnexposedExpression::UnexposedExpression(std::shared_ptr<const char> text, size_t size)
+  : m_text(std::move(text)),
+    m_size(size)
 {
 
 }
@@ -41,7 +53,7 @@ bool UnexposedExpression::isUnexposed() const
 
 std::string UnexposedExpression::toString() const
 {
-  return m_source;
+  return std::string(data(), m_size);
 }
   
 
@@ -72,6 +84,13 @@ bool operator==(const Expression& lhs, const Expression& rhs)
   if (typeid(*lhs.impl().get()) != typeid(*rhs.impl().get()))
     return false;
 
+  if (typeid(*lhs.impl().get()) == typeid(UnexposedExpression))
+  {
+    const auto& a = static_cast<const UnexposedExpression&>(*lhs.impl());
+    const auto& b = static_cast<const UnexposedExpression&>(*rhs.impl());
+    return a.size() == b.size() && (a.data() == b.data() || std::memcmp(a.data(), b.data(), a.size()) == 0);
+  }
+
   return lhs.toString() == rhs.toString();
 }
 
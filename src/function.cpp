@@ -9,14 +9,14 @@
 namespace cxx
 {
 
-FunctionParameter::FunctionParameter(Type t, std::string name, std::shared_ptr<Function> parent)
+FunctionParameter::FunctionParameter(Type t, Symbol name, std::shared_ptr<Function> parent)
   : IEntity(std::move(name), parent),
     type(std::move(t))
 {
 
 }
 
-FunctionParameter::FunctionParameter(Type t, std::string name, Expression default_val, std::shared_ptr<Function> parent)
+FunctionParameter::FunctionParameter(Type t, Symbol name, Expression default_val, std::shared_ptr<Function> parent)
   : IEntity(std::move(name), parent),
     type(std::move(t)),
     default_value(default_val)
@@ -130,7 +130,7 @@ std::string Function::signature() const
   return result;
 }
 
-FunctionTemplate::FunctionTemplate(std::vector<std::shared_ptr<TemplateParameter>> tparams, std::string name, std::shared_ptr<IEntity> parent)
+FunctionTemplate::FunctionTemplate(std::vector<std::shared_ptr<TemplateParameter>> tparams, Symbol name, std::shared_ptr<IEntity> parent)
   : Function(std::move(name), parent),
     template_parameters(std::move(tparams))
 {
@@ -56,8 +56,8 @@ bool IName::isQualifiedName() const
 }
 
 
-Identifier::Identifier(std::string name)
-  : m_name(std::move(name))
+Identifier::Identifier(Symbol name)
+  : m_name(name)
 {
 
 }
@@ -120,8 +120,8 @@ std::string LiteralOperatorName::toString() const
   return "operator \"\"" + m_suffix;
 }
 
-TemplateName::TemplateName(std::string name, std::vector<TemplateArgument> targ)
-  : m_name(std::move(name)),
+TemplateName::TemplateName(Symbol name, std::vector<TemplateArgument> targ)
+  : m_name(name),
   m_targs(std::move(targ))
 {
 
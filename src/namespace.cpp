@@ -15,9 +15,9 @@ NodeKind Namespace::node_kind() const
   return ClassNodeKind;
 }
 
-std::shared_ptr<Namespace> Namespace::getOrCreateNamespace(const std::string& name)
+std::shared_ptr<Namespace> Namespace::getOrCreateNamespace(Symbol name)
 {
-  auto it = std::find_if(entities.begin(), entities.end(), [&name](const std::shared_ptr<IEntity>& e) {
+  auto it = std::find_if(entities.begin(), entities.end(), [name](const std::shared_ptr<IEntity>& e) {
     return e->is<Namespace>() && e->name == name;
     });
 
@@ -29,16 +29,16 @@ std::shared_ptr<Namespace> Namespace::getOrCreateNamespace(const std::string& na
   return result;
 }
 
-std::shared_ptr<Class> Namespace::createClass(std::string name)
+std::shared_ptr<Class> Namespace::createClass(Symbol name)
 {
   auto result = std::make_shared<Class>(std::move(name), shared_from_this());
   entities.push_back(result);
   return result;
 }
 
-std::shared_ptr<Class> Namespace::getOrCreateClass(const std::string& name)
+std::shared_ptr<Class> Namespace::getOrCreateClass(Symbol name)
 {
-  auto it = std::find_if(entities.begin(), entities.end(), [&name](const std::shared_ptr<IEntity>& e) {
+  auto it = std::find_if(entities.begin(), entities.end(), [name](const std::shared_ptr<IEntity>& e) {
     return e->is<Class>() && e->name == name;
     });
 
@@ -50,14 +50,14 @@ std::shared_ptr<Class> Namespace::getOrCreateClass(const std::string& name)
   return result;
 }
 
-std::shared_ptr<Enum> Namespace::createEnum(std::string name)
+std::shared_ptr<Enum> Namespace::createEnum(Symbol name)
 {
   auto result = std::make_shared<Enum>(std::move(name), shared_from_this());
   entities.push_back(result);
   return result;
 }
 
-std::shared_ptr<Function> Namespace::createFunction(std::string name)
+std::shared_ptr<Function> Namespace::createFunction(Symbol name)
 {
   auto result = std::make_shared<Function>(std::move(name), shared_from_this());
   entities.push_back(result);
@@ -0,0 +1,584 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/batch-parser.h"
+
+#include "cxx/parsers/function-utils.h"
+#include "cxx/parsers/parser.h"
+#include "cxx/parsers/restricted-parser.h"
+
+#include "cxx/class.h"
+#include "cxx/declaration.h"
+#include "cxx/filesystem.h"
+#include "cxx/namespace.h"
+#include "cxx/program.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <Windows.h>
+#else
+#  include <dirent.h>
+#  include <sys/stat.h>
+#endif
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+static std::vector<std::shared_ptr<IEntity>>* scope_members(IEntity& e)
+{
+  if (e.is<Namespace>())
+    return &static_cast<Namespace&>(e).entities;
+  else if (e.is<Class>() || e.is<ClassTemplate>())
+    return &static_cast<Class&>(e).members;
+
+  return nullptr;
+}
+
+namespace
+{
+
+// Merges partial programs into a program.
+// The entities of the target scopes are indexed by name on first use.
+class ProgramMerger
+{
+public:
+  ProgramMerger(Program& target, FileSystem& fs)
+    : m_target(target),
+      m_filesystem(fs)
+  {
+    for (const std::shared_ptr<File>& f : m_filesystem.files)
+      m_files[f->path()] = f;
+
+    for (const std::shared_ptr<Macro>& m : m_target.macros)
+      m_macros.insert(m->name);
+  }
+
+  void merge(Program& partial, const std::vector<std::shared_ptr<File>>& files)
+  {
+    mergeScope(*m_target.globalNamespace(), *partial.globalNamespace());
+
+    for (const std::shared_ptr<IEntity>& e : m_appended)
+      relinkBases(*e);
+
+    // a file that is parsed with several partial programs (e.g. a header)
+    // keeps the ast of its first occurrence; the File of the partial program
+    // is adopted unless the file system already has one for that path
+    std::unordered_set<const File*> kept_files;
+    std::unordered_map<const File*, std::shared_ptr<File>> replaced_files;
+
+    for (const std::shared_ptr<File>& f : files)
+    {
+      if (!f->ast || !m_merged_files.insert(f->path()).second)
+        continue;
+
+      std::shared_ptr<File>& target = m_files[f->path()];
+
+      if (!target)
+      {
+        target = f;
+        m_filesystem.files.push_back(target);
+      }
+      else
+      {
+        target->ast = f->ast;
+        target->arena = f->arena;
+        replaced_files[f.get()] = target;
+      }
+
+      kept_files.insert(f.get());
+    }
+
+    for (const auto& p : partial.astmap)
+    {
+      if (kept_files.find(p.second->sourcerange.file.lock().get()) == kept_files.end())
+        continue;
+
+      auto it = m_replaced.find(p.first);
+      m_target.astmap[it != m_replaced.end() ? it->second.get() : p.first] = p.second;
+    }
+
+    for (const std::shared_ptr<File>& f : files)
+    {
+      if (kept_files.find(f.get()) == kept_files.end())
+        continue;
+
+      if (replaced_files.empty())
+        relinkDeclarations(*f->ast);
+      else
+        relinkAst(*f->ast, replaced_files);
+    }
+
+    for (const std::shared_ptr<Macro>& m : partial.macros)
+    {
+      if (m_macros.insert(m->name).second)
+        m_target.macros.push_back(m);
+    }
+
+    m_replaced.clear();
+    m_appended.clear();
+  }
+
+private:
+  using Index = std::unordered_multimap<Symbol, std::shared_ptr<IEntity>>;
+
+  Index& index(IEntity& scope)
+  {
+    auto it = m_indexes.find(&scope);
+
+    if (it != m_indexes.end())
+      return it->second;
+
+    Index& result = m_indexes[&scope];
+
+    for (const std::shared_ptr<IEntity>& e : *scope_members(scope))
+      result.emplace(e->name, e);
+
+    return result;
+  }
+
+  std::shared_ptr<IEntity> find(Index& idx, const IEntity& e) const
+  {
+    auto range = idx.equal_range(e.name);
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      const IEntity& candidate = *it->second;
+
+      if (candidate.node_kind() != e.node_kind())
+        continue;
+
+      if (!e.is<Function>() || are_equiv_func(static_cast<const Function&>(candidate), static_cast<const Function&>(e)))
+        return it->second;
+    }
+
+    return nullptr;
+  }
+
+  void mergeScope(IEntity& target, IEntity& source)
+  {
+    Index& idx = index(target);
+    std::vector<std::shared_ptr<IEntity>>& members = *scope_members(target);
+
+    for (const std::shared_ptr<IEntity>& e : *scope_members(source))
+    {
+      std::shared_ptr<IEntity> existing = find(idx, *e);
+
+      if (!existing)
+      {
+        e->weak_parent = target.shared_from_this();
+        members.push_back(e);
+        idx.emplace(e->name, e);
+        m_appended.push_back(e);
+        continue;
+      }
+
+      m_replaced[e.get()] = existing;
+
+      if (scope_members(*existing))
+        mergeScope(*existing, *e);
+      else if (existing->is<Function>())
+        update_func(static_cast<Function&>(*existing), static_cast<const Function&>(*e));
+    }
+  }
+
+  void relinkBases(IEntity& e)
+  {
+    if (e.is<Class>() || e.is<ClassTemplate>())
+    {
+      for (BaseClass& b : static_cast<Class&>(e).bases)
+      {
+        auto it = m_replaced.find(b.base.get());
+
+        if (it != m_replaced.end())
+          b.base = std::static_pointer_cast<Class>(it->second);
+      }
+    }
+
+    if (std::vector<std::shared_ptr<IEntity>>* members = scope_members(e))
+    {
+      for (const std::shared_ptr<IEntity>& m : *members)
+        relinkBases(*m);
+    }
+  }
+
+  // Only the declarations of namespaces and classes can refer to entities
+  // that have been merged, so the bodies of functions are not visited.
+  void relinkDeclarations(AstNode& node)
+  {
+    const std::vector<std::shared_ptr<AstNode>>* children = nullptr;
+
+    if (node.isDeclaration())
+    {
+      IDeclaration& decl = static_cast<IDeclaration&>(node);
+      auto it = m_replaced.find(decl.entity_ptr.get());
+
+      if (it != m_replaced.end())
+        decl.entity_ptr = it->second;
+
+      children = &decl.childvec;
+    }
+    else if (node.node_kind() == NodeKind::AstRootNode)
+    {
+      children = &static_cast<AstRootNode&>(node).childvec;
+    }
+
+    if (!children)
+      return;
+
+    for (const std::shared_ptr<AstNode>& child : *children)
+    {
+      if (child && child->isDeclaration())
+        relinkDeclarations(*child);
+    }
+  }
+
+  void relinkAst(AstNode& node, const std::unordered_map<const File*, std::shared_ptr<File>>& files)
+  {
+    auto fit = files.find(node.sourcerange.file.lock().get());
+
+    if (fit != files.end())
+      node.sourcerange.file = fit->second;
+
+    if (node.isDeclaration())
+    {
+      IDeclaration& decl = static_cast<IDeclaration&>(node);
+      auto it = m_replaced.find(decl.entity_ptr.get());
+
+      if (it != m_replaced.end())
+        decl.entity_ptr = it->second;
+    }
+
+    for (const std::shared_ptr<AstNode>& child : node.children())
+    {
+      if (child)
+        relinkAst(*child, files);
+    }
+  }
+
+private:
+  Program& m_target;
+  FileSystem& m_filesystem;
+  std::unordered_map<std::string, std::shared_ptr<File>> m_files;
+  std::set<std::string> m_merged_files;
+  std::set<std::string> m_macros;
+  std::unordered_map<const IEntity*, Index> m_indexes;
+  std::unordered_map<const INode*, std::shared_ptr<IEntity>> m_replaced;
+  std::vector<std::shared_ptr<IEntity>> m_appended;
+};
+
+} // namespace
+
+BatchParser::BatchParser()
+  : m_filesystem(FileSystem::GlobalInstance()),
+    m_program(std::make_shared<Program>())
+{
+
+}
+
+BatchParser::BatchParser(cxx::FileSystem& fs)
+  : m_filesystem(fs),
+    m_program(std::make_shared<Program>())
+{
+
+}
+
+BatchParser::BatchParser(std::shared_ptr<Program> prog, cxx::FileSystem& fs)
+  : m_filesystem(fs),
+    m_program(prog)
+{
+
+}
+
+std::shared_ptr<Program> BatchParser::program() const
+{
+  return m_program;
+}
+
+// The calling thread merges the partial programs as soon as they are
+// available, in order, while the worker threads parse the next files.
+// Files that cannot be parsed are listed in 'errors' and their partial
+// program is discarded.
+bool BatchParser::parse(const std::vector<std::string>& files)
+{
+  struct PartialProgram
+  {
+    std::shared_ptr<Program> program;
+    std::vector<std::shared_ptr<File>> files;
+    std::string error;
+    std::vector<Error> recovered_errors;
+    bool done = false;
+  };
+
+  std::vector<PartialProgram> partials{ files.size() };
+  std::atomic<size_t> next_file{ 0 };
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  size_t nb_threads = threads > 0 ? static_cast<size_t>(threads) : std::max<size_t>(1, std::thread::hardware_concurrency());
+  nb_threads = std::min(nb_threads, files.size());
+
+  // a worker has either a restricted parser or a libclang parser
+  struct Worker
+  {
+    FileSystem fs;
+    std::unique_ptr<RestrictedParser> restricted_parser;
+    std::unique_ptr<LibClangParser> clang_parser;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_data;
+  std::shared_ptr<ClangFileRegistry> file_registry = use_libclang && share_headers ? std::make_shared<ClangFileRegistry>() : nullptr;
+
+  for (size_t i(0); i < nb_threads; ++i)
+  {
+    workers_data.emplace_back(new Worker);
+
+    // created here so that a missing libclang is reported to the caller
+    if (use_libclang)
+    {
+      std::unique_ptr<LibClangParser> parser{ new LibClangParser(workers_data.back()->fs) };
+      parser->includedirs = includedirs;
+      parser->defines = defines;
+      parser->skip_function_bodies = skip_function_bodies;
+      parser->arena_allocation = arena_allocation;
+      parser->compilation_database = compilation_database;
+      parser->translation_unit_cache = translation_unit_cache;
+      parser->index_options = background_priority ? CXGlobalOpt_ThreadBackgroundPriorityForIndexing : CXGlobalOpt_None;
+      parser->file_registry = file_registry;
+      workers_data.back()->clang_parser = std::move(parser);
+    }
+    else
+    {
+      std::unique_ptr<RestrictedParser> parser{ new RestrictedParser(workers_data.back()->fs) };
+      parser->includedirs = includedirs;
+      parser->defines = defines;
+      parser->skip_function_bodies = skip_function_bodies;
+      parser->skip_function_body_tokens = skip_function_body_tokens;
+      parser->error_recovery = error_recovery;
+      parser->arena_allocation = arena_allocation;
+      workers_data.back()->restricted_parser = std::move(parser);
+    }
+  }
+
+  auto work = [&](Worker& worker) {
+    FileSystem& fs = worker.fs;
+
+    for (size_t i = next_file++; i < files.size(); i = next_file++)
+    {
+      PartialProgram& partial = partials[i];
+      std::shared_ptr<Program> program = std::make_shared<Program>();
+      std::string error;
+      std::vector<Error> recovered_errors;
+
+      if (worker.clang_parser)
+      {
+        LibClangParser& clang_parser = *worker.clang_parser;
+        clang_parser.setProgram(program);
+
+        try
+        {
+          if (!clang_parser.parse(files.at(i)))
+            error = "libclang could not parse the file";
+        }
+        catch (const std::exception& ex)
+        {
+          error = ex.what();
+        }
+
+        for (const LibClangParser::SkippedDeclaration& d : clang_parser.skipped_declarations)
+        {
+          if (!error_recovery)
+            break;
+
+          std::string path = d.loc.file() ? d.loc.file()->path() : files.at(i);
+          recovered_errors.push_back(Error{ std::move(path), "could not convert declaration '" + d.content + "'", d.loc.line(), d.loc.column() });
+        }
+      }
+      else
+      {
+        RestrictedParser& parser = *worker.restricted_parser;
+        parser.setProgram(program);
+
+        try
+        {
+          parser.parse(files.at(i));
+        }
+        catch (const std::exception& ex)
+        {
+          error = ex.what();
+        }
+
+        for (const RestrictedParser::Error& e : parser.errors)
+        {
+          std::string path = e.location.file() ? e.location.file()->path() : files.at(i);
+          recovered_errors.push_back(Error{ std::move(path), e.message, e.location.line(), e.location.column() });
+        }
+      }
+
+      {
+        std::lock_guard<std::mutex> lock{ mutex };
+        partial.program = std::move(program);
+        partial.files = std::move(fs.files);
+        partial.error = std::move(error);
+        partial.recovered_errors = std::move(recovered_errors);
+        partial.done = true;
+      }
+
+      fs.files.clear();
+      cv.notify_one();
+    }
+  };
+
+  // Joins the workers when leaving, also if merging or starting a thread
+  // throws; the remaining files are then not parsed.
+  struct WorkersGuard
+  {
+    std::vector<std::thread>& threads;
+    std::atomic<size_t>& next_file;
+    size_t end;
+
+    ~WorkersGuard()
+    {
+      next_file = end;
+
+      for (std::thread& t : threads)
+      {
+        if (t.joinable())
+          t.join();
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  WorkersGuard workers_guard{ workers, next_file, files.size() };
+
+  for (size_t i(0); i < nb_threads; ++i)
+    workers.emplace_back(work, std::ref(*workers_data.at(i)));
+
+  ProgramMerger merger{ *m_program, m_filesystem };
+
+  errors.clear();
+
+  for (size_t i(0); i < partials.size(); ++i)
+  {
+    PartialProgram partial;
+
+    {
+      std::unique_lock<std::mutex> lock{ mutex };
+      cv.wait(lock, [&]() { return partials[i].done; });
+      partial = std::move(partials[i]);
+    }
+
+    errors.insert(errors.end(), partial.recovered_errors.begin(), partial.recovered_errors.end());
+
+    if (!partial.error.empty())
+      errors.push_back(Error{ files.at(i), partial.error });
+    else
+      merger.merge(*partial.program, partial.files);
+  }
+
+  return errors.empty();
+}
+
+#if defined(_WIN32)
+
+static void list_files(const std::string& directory, const std::set<std::string>& extensions, std::vector<std::string>& result)
+{
+  WIN32_FIND_DATAA data;
+  HANDLE handle = FindFirstFileA((directory + "/*").c_str(), &data);
+
+  if (handle == INVALID_HANDLE_VALUE)
+    return;
+
+  do
+  {
+    const std::string name = data.cFileName;
+
+    if (name == "." || name == "..")
+      continue;
+
+    const std::string path = directory + "/" + name;
+
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+    {
+      list_files(path, extensions, result);
+    }
+    else
+    {
+      const size_t dot = name.rfind('.');
+
+      if (extensions.empty() || (dot != std::string::npos && extensions.count(name.substr(dot))))
+        result.push_back(path);
+    }
+  } while (FindNextFileA(handle, &data));
+
+  FindClose(handle);
+}
+
+#else
+
+static void list_files(const std::string& directory, const std::set<std::string>& extensions, std::vector<std::string>& result)
+{
+  DIR* dir = ::opendir(directory.c_str());
+
+  if (!dir)
+    return;
+
+  while (struct dirent* entry = ::readdir(dir))
+  {
+    const std::string name = entry->d_name;
+
+    if (name == "." || name == "..")
+      continue;
+
+    const std::string path = directory + "/" + name;
+
+    struct stat st;
+
+    if (::stat(path.c_str(), &st) != 0)
+      continue;
+
+    if (S_ISDIR(st.st_mode))
+    {
+      list_files(path, extensions, result);
+    }
+    else if (S_ISREG(st.st_mode))
+    {
+      const size_t dot = name.rfind('.');
+
+      if (extensions.empty() || (dot != std::string::npos && extensions.count(name.substr(dot))))
+        result.push_back(path);
+    }
+  }
+
+  ::closedir(dir);
+}
+
+#endif
+
+// Lists, recursively and in a sorted order, the files of a directory
+// that have one of the given extensions (e.g. ".h"); with no extension,
+// all files are listed.
+std::vector<std::string> BatchParser::listFiles(const std::string& directory, const std::set<std::string>& extensions)
+{
+  std::vector<std::string> result;
+  list_files(directory, extensions, result);
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+} // namespace parsers
+
+} // namespace cxx
@@ -0,0 +1,483 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/compilation-database.h"
+
+#include "cxx/file.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+namespace
+{
+
+// Reads the subset of JSON a compilation database is made of;
+// numbers, booleans and null are skipped.
+class JsonReader
+{
+public:
+  explicit JsonReader(const std::string& text)
+    : m_text(text)
+  {
+
+  }
+
+  bool atEnd()
+  {
+    skipSpaces();
+    return m_pos == m_text.size();
+  }
+
+  char peek()
+  {
+    skipSpaces();
+    return m_pos < m_text.size() ? m_text[m_pos] : '\0';
+  }
+
+  void expect(char c)
+  {
+    if (peek() != c)
+      fail(std::string("'") + c + "' expected");
+
+    ++m_pos;
+  }
+
+  bool tryRead(char c)
+  {
+    if (peek() != c)
+      return false;
+
+    ++m_pos;
+    return true;
+  }
+
+  std::string readString()
+  {
+    expect('"');
+
+    std::string result;
+
+    while (m_pos < m_text.size() && m_text[m_pos] != '"')
+    {
+      char c = m_text[m_pos++];
+
+      if (c != '\\')
+      {
+        result.push_back(c);
+        continue;
+      }
+
+      if (m_pos == m_text.size())
+        break;
+
+      c = m_text[m_pos++];
+
+      switch (c)
+      {
+      case 'b': result.push_back('\b'); break;
+      case 'f': result.push_back('\f'); break;
+      case 'n': result.push_back('\n'); break;
+      case 'r': result.push_back('\r'); break;
+      case 't': result.push_back('\t'); break;
+      case 'u': appendCodePoint(result); break;
+      default: result.push_back(c); break;
+      }
+    }
+
+    if (m_pos == m_text.size())
+      fail("unterminated string");
+
+    ++m_pos;
+    return result;
+  }
+
+  std::vector<std::string> readStringArray()
+  {
+    std::vector<std::string> result;
+    expect('[');
+
+    if (tryRead(']'))
+      return result;
+
+    do
+    {
+      result.push_back(readString());
+    } while (tryRead(','));
+
+    expect(']');
+    return result;
+  }
+
+  void skipValue()
+  {
+    switch (peek())
+    {
+    case '"':
+      readString();
+      break;
+    case '[':
+      skipList('[', ']', false);
+      break;
+    case '{':
+      skipList('{', '}', true);
+      break;
+    default:
+    {
+      const size_t start = m_pos;
+
+      while (m_pos < m_text.size() && std::strchr(",]} \t\r\n", m_text[m_pos]) == nullptr)
+        ++m_pos;
+
+      if (m_pos == start)
+        fail("value expected");
+    }
+    break;
+    }
+  }
+
+  [[noreturn]] void fail(const std::string& what) const
+  {
+    throw std::runtime_error{ "CompilationDatabase: " + what + " at offset " + std::to_string(m_pos) };
+  }
+
+private:
+  void skipSpaces()
+  {
+    while (m_pos < m_text.size() && std::strchr(" \t\r\n", m_text[m_pos]) != nullptr && m_text[m_pos] != '\0')
+      ++m_pos;
+  }
+
+  void skipList(char open, char close, bool keys)
+  {
+    expect(open);
+
+    if (tryRead(close))
+      return;
+
+    do
+    {
+      if (keys)
+      {
+        readString();
+        expect(':');
+      }
+
+      skipValue();
+    } while (tryRead(','));
+
+    expect(close);
+  }
+
+  // \uXXXX, encoded in UTF-8 (surrogate pairs are not combined)
+  void appendCodePoint(std::string& str)
+  {
+    if (m_text.size() - m_pos < 4)
+      fail("malformed unicode escape");
+
+    for (size_t i(0); i < 4; ++i)
+    {
+      if (!std::isxdigit(static_cast<unsigned char>(m_text[m_pos + i])))
+        fail("malformed unicode escape");
+    }
+
+    const unsigned long cp = std::stoul(m_text.substr(m_pos, 4), nullptr, 16);
+    m_pos += 4;
+
+    if (cp < 0x80)
+    {
+      str.push_back(static_cast<char>(cp));
+    }
+    else if (cp < 0x800)
+    {
+      str.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+      str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else
+    {
+      str.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+      str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+  }
+
+private:
+  const std::string& m_text;
+  size_t m_pos = 0;
+};
+
+} // namespace
+
+static bool is_absolute(const std::string& path)
+{
+  return (!path.empty() && path.front() == '/') || (path.size() >= 2 && path[1] == ':');
+}
+
+// Joins 'path' to 'directory' if it is relative and removes the '.' and '..'
+static std::string absolute_path(const std::string& directory, const std::string& path)
+{
+  std::string full = is_absolute(path) || directory.empty() ? path : directory + "/" + path;
+  File::normalizePath(full);
+
+  std::vector<std::string> parts;
+  std::istringstream stream{ full };
+  std::string part;
+
+  while (std::getline(stream, part, '/'))
+  {
+    if (part == "..")
+    {
+      if (!parts.empty() && !parts.back().empty())
+        parts.pop_back();
+    }
+    else if (part != "." && (!part.empty() || parts.empty()))
+    {
+      parts.push_back(part);
+    }
+  }
+
+  std::string result;
+
+  for (size_t i(0); i < parts.size(); ++i)
+  {
+    if (i > 0)
+      result += "/";
+
+    result += parts.at(i);
+  }
+
+  return parts.size() == 1 && parts.front().empty() ? "/" : result;
+}
+
+CompilationDatabase CompilationDatabase::load(const std::string& path)
+{
+  std::ifstream file{ path };
+
+  if (!file.is_open())
+    throw std::runtime_error{ "CompilationDatabase: could not open " + path };
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return fromJson(buffer.str());
+}
+
+// Each entry has a 'directory', a 'file' and either 'arguments' or a
+// 'command' line; the other members are ignored.
+CompilationDatabase CompilationDatabase::fromJson(const std::string& json)
+{
+  CompilationDatabase result;
+  JsonReader reader{ json };
+
+  reader.expect('[');
+
+  if (!reader.tryRead(']'))
+  {
+    do
+    {
+      Command command;
+      std::string command_line;
+      reader.expect('{');
+
+      if (!reader.tryRead('}'))
+      {
+        do
+        {
+          const std::string key = reader.readString();
+          reader.expect(':');
+
+          if (key == "directory")
+            command.directory = reader.readString();
+          else if (key == "file")
+            command.file = reader.readString();
+          else if (key == "arguments")
+            command.arguments = reader.readStringArray();
+          else if (key == "command")
+            command_line = reader.readString();
+          else
+            reader.skipValue();
+        } while (reader.tryRead(','));
+
+        reader.expect('}');
+      }
+
+      if (command.file.empty())
+        reader.fail("entry without a file");
+
+      if (command.arguments.empty())
+        command.arguments = splitCommandLine(command_line);
+
+      result.add(std::move(command));
+    } while (reader.tryRead(','));
+
+    reader.expect(']');
+  }
+
+  if (!reader.atEnd())
+    reader.fail("unexpected content");
+
+  return result;
+}
+
+void CompilationDatabase::add(Command command)
+{
+  command.file = absolute_path(command.directory, command.file);
+  m_files[command.file] = m_commands.size();
+  m_commands.push_back(std::move(command));
+}
+
+// Returns the command that compiles 'file', or nullptr.
+// A relative path matches the file that has the same trailing components.
+const CompilationDatabase::Command* CompilationDatabase::find(const std::string& file) const
+{
+  const std::string path = absolute_path("", file);
+  auto it = m_files.find(path);
+
+  if (it != m_files.end())
+    return &m_commands.at(it->second);
+
+  if (is_absolute(path))
+    return nullptr;
+
+  const std::string suffix = "/" + path;
+
+  for (const Command& c : m_commands)
+  {
+    if (c.file.size() > suffix.size() && c.file.compare(c.file.size() - suffix.size(), suffix.size(), suffix) == 0)
+      return &c;
+  }
+
+  return nullptr;
+}
+
+// Splits a command line the way a POSIX shell would,
+// handling quotes and backslashes.
+std::vector<std::string> CompilationDatabase::splitCommandLine(const std::string& command)
+{
+  std::vector<std::string> result;
+  std::string arg;
+  bool in_arg = false;
+  char quote = '\0';
+
+  for (size_t i(0); i < command.size(); ++i)
+  {
+    const char c = command[i];
+
+    if (quote == '\'')
+    {
+      if (c == '\'')
+        quote = '\0';
+      else
+        arg.push_back(c);
+    }
+    else if (c == '\\' && i + 1 < command.size() && (quote == '\0' || std::strchr("\"\\$`", command[i + 1])))
+    {
+      arg.push_back(command[++i]);
+      in_arg = true;
+    }
+    else if (quote == '"')
+    {
+      if (c == '"')
+        quote = '\0';
+      else
+        arg.push_back(c);
+    }
+    else if (c == '"' || c == '\'')
+    {
+      quote = c;
+      in_arg = true;
+    }
+    else if (c == ' ' || c == '\t' || c == '\n')
+    {
+      if (in_arg)
+        result.push_back(std::move(arg));
+
+      arg.clear();
+      in_arg = false;
+    }
+    else
+    {
+      arg.push_back(c);
+      in_arg = true;
+    }
+  }
+
+  if (in_arg)
+    result.push_back(std::move(arg));
+
+  return result;
+}
+
+// The arguments of 'command' that matter to a parser: include paths (made
+// absolute), macro definitions, forced includes, the language and its
+// standard. Everything else (the compiler, the input and output files,
+// warnings, optimizations, dependency files...) is left out.
+std::vector<std::string> CompilationDatabase::parserArguments(const Command& command)
+{
+  static const char* path_options[] = { "-I", "-isystem", "-iquote", "-idirafter", "-include" };
+  static const char* other_options[] = { "-D", "-U", "-x" };
+
+  std::vector<std::string> result;
+  const std::vector<std::string>& args = command.arguments;
+
+  auto starts_with = [](const std::string& str, const char* prefix) {
+    return str.compare(0, std::strlen(prefix), prefix) == 0;
+  };
+
+  for (size_t i(args.empty() || starts_with(args.front(), "-") ? 0 : 1); i < args.size(); ++i)
+  {
+    const std::string& arg = args.at(i);
+    bool kept = false;
+
+    for (const char* opt : path_options)
+    {
+      if (!starts_with(arg, opt))
+        continue;
+
+      const size_t n = std::strlen(opt);
+      std::string value;
+
+      if (arg.size() > n)
+        value = arg.substr(n);
+      else if (i + 1 < args.size())
+        value = args.at(++i);
+
+      result.push_back(opt);
+      result.push_back(absolute_path(command.directory, value));
+      kept = true;
+      break;
+    }
+
+    for (size_t j(0); !kept && j < sizeof(other_options) / sizeof(other_options[0]); ++j)
+    {
+      const char* opt = other_options[j];
+
+      if (!starts_with(arg, opt))
+        continue;
+
+      result.push_back(arg);
+
+      if (arg.size() == std::strlen(opt) && i + 1 < args.size())
+        result.push_back(args.at(++i));
+
+      kept = true;
+    }
+
+    if (!kept && (starts_with(arg, "-std=") || starts_with(arg, "--std=")))
+      result.push_back(arg);
+  }
+
+  return result;
+}
+
+} // namespace parsers
+
+} // namespace cxx
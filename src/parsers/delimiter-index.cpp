@@ -0,0 +1,182 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/delimiter-index.h"
+
+#include <cassert>
+#include <limits>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+static const std::uint32_t no_entry = std::numeric_limits<std::uint32_t>::max();
+
+const size_t DelimiterIndex::npos;
+
+void DelimiterIndex::AngleStack::reset()
+{
+  size = 0;
+  emplace_back();
+}
+
+void DelimiterIndex::AngleStack::emplace_back()
+{
+  if (size == levels.size())
+    levels.emplace_back();
+
+  levels[size++].clear();
+}
+
+void DelimiterIndex::build(const TokenBuffer& tokens)
+{
+  m_entries.assign(tokens.size(), Entry{ no_entry, Unknown });
+  m_nested = true;
+
+  // the stacks keep their capacity from one build to the next
+  std::vector<std::uint32_t>& parens = m_parens;
+  std::vector<std::uint32_t>& brackets = m_brackets;
+  std::vector<std::uint32_t>& braces = m_braces;
+  std::vector<TokenType::Value>& nesting = m_nesting;
+  parens.clear();
+  brackets.clear();
+  braces.clear();
+  nesting.clear();
+
+  // The '<' that are waiting for a '>', grouped by parenthesis/bracket
+  // nesting level as '<' and '>' only pair at the same level.
+  AngleStack& angles = m_angles;
+  angles.reset();
+
+  auto open = [&](std::vector<std::uint32_t>& stack, std::uint32_t i) {
+    stack.push_back(i);
+    nesting.push_back(tokens.type(i).value());
+  };
+
+  auto close = [&](std::vector<std::uint32_t>& stack, TokenType::Value opening, std::uint32_t i) {
+    if (!stack.empty())
+    {
+      m_entries[stack.back()].match = i;
+      stack.pop_back();
+    }
+
+    if (nesting.empty() || nesting.back() != opening)
+      m_nested = false;
+    else
+      nesting.pop_back();
+  };
+
+  auto close_angles = [&](AngleStatus status, std::uint32_t i) {
+    for (std::uint32_t a : angles.back())
+      m_entries[a] = Entry{ i, status };
+
+    if (angles.size > 1)
+      angles.pop_back();
+    else
+      angles.back().clear();
+  };
+
+  for (std::uint32_t i(0); i < tokens.size(); ++i)
+  {
+    switch (tokens.type(i).value())
+    {
+    case TokenType::LeftPar:
+      open(parens, i);
+      angles.emplace_back();
+      break;
+    case TokenType::RightPar:
+      close(parens, TokenType::LeftPar, i);
+      close_angles(UnmatchedParen, i);
+      break;
+    case TokenType::LeftBracket:
+      open(brackets, i);
+      angles.emplace_back();
+      break;
+    case TokenType::RightBracket:
+      close(brackets, TokenType::LeftBracket, i);
+      close_angles(UnmatchedBracket, i);
+      break;
+    case TokenType::LeftBrace:
+      open(braces, i);
+      break;
+    case TokenType::RightBrace:
+      close(braces, TokenType::LeftBrace, i);
+      break;
+    case TokenType::Less:
+      angles.back().push_back(i);
+      break;
+    case TokenType::GreaterThan:
+      if (!angles.back().empty())
+      {
+        m_entries[angles.back().back()] = Entry{ i, Matched };
+        angles.back().pop_back();
+      }
+      break;
+    case TokenType::RightShift:
+    {
+      std::vector<std::uint32_t>& pending = angles.back();
+
+      if (pending.size() >= 2)
+      {
+        m_entries[pending.back()] = Entry{ i, MatchedNested };
+        pending.pop_back();
+        m_entries[pending.back()] = Entry{ i, MatchedShift };
+        pending.pop_back();
+      }
+      else if (pending.size() == 1)
+      {
+        // the parser takes this '>>' for a shift operator and keeps 
+        // looking for a '>'; this is left to a scan
+        pending.pop_back();
+      }
+    }
+      break;
+    default:
+      break;
+    }
+  }
+
+  for (size_t level(0); level < angles.size; ++level)
+  {
+    for (std::uint32_t a : angles.levels[level])
+      m_entries[a] = Entry{ no_entry, Unmatched };
+  }
+
+  if (!nesting.empty())
+    m_nested = false;
+}
+
+void DelimiterIndex::clear()
+{
+  m_entries.clear();
+  m_nested = false;
+}
+
+// Returns the index of the token closing the '(', '[' or '{' at 'index', 
+// or npos.
+size_t DelimiterIndex::closing(size_t index) const
+{
+  assert(index < m_entries.size());
+  const std::uint32_t match = m_entries[index].match;
+  return match == no_entry ? npos : match;
+}
+
+// Returns how the template argument list started by the '<' at 'index' ends,
+// assuming the parser scans up to the end of input.
+DelimiterIndex::AngleMatch DelimiterIndex::angle(size_t index) const
+{
+  assert(index < m_entries.size());
+
+  if (!m_nested)
+    return AngleMatch{ Unknown, npos };
+
+  const Entry& e = m_entries[index];
+  return AngleMatch{ e.status, e.match == no_entry ? npos : e.match };
+}
+
+} // namespace parsers
+
+} // namespace cxx
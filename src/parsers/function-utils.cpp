@@ -0,0 +1,88 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/function-utils.h"
+
+#include "cxx/class.h"
+#include "cxx/namespace.h"
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+static bool are_equiv_param(const cxx::FunctionParameter& a, const cxx::FunctionParameter& b)
+{
+  return a.type == b.type;
+}
+
+bool are_equiv_func(const cxx::Function& a, const cxx::Function& b)
+{
+  if (a.name != b.name)
+    return false;
+
+  if (a.parameters.size() != b.parameters.size())
+    return false;
+
+  if (a.return_type != b.return_type)
+    return false;
+
+  for (size_t i(0); i < a.parameters.size(); ++i)
+  {
+    if (!are_equiv_param(*a.parameters.at(i), *b.parameters.at(i)))
+      return false;
+  }
+
+  return true;
+}
+
+std::shared_ptr<cxx::Function> find_equiv_func(cxx::INode& current_node, const cxx::Function& func)
+{
+  if (current_node.is<cxx::Class>())
+  {
+    for (const auto& m : static_cast<cxx::Class&>(current_node).members)
+    {
+      if (m->is<cxx::Function>())
+      {
+        if (are_equiv_func(static_cast<cxx::Function&>(*m), func))
+          return std::static_pointer_cast<cxx::Function>(m);
+      }
+    }
+  }
+  else if (current_node.is<cxx::Namespace>())
+  {
+    for (const auto& m : static_cast<cxx::Namespace&>(current_node).entities)
+    {
+      if (m->is<cxx::Function>())
+      {
+        if (are_equiv_func(static_cast<cxx::Function&>(*m), func))
+          return std::static_pointer_cast<cxx::Function>(m);
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+void update_func(cxx::Function& func, const cxx::Function& new_one)
+{
+  for (size_t i(0); i < func.parameters.size(); ++i)
+  {
+    if (func.parameters.at(i)->default_value == cxx::Expression())
+    {
+      if (new_one.parameters.at(i)->default_value != cxx::Expression())
+        func.parameters.at(i)->default_value = new_one.parameters.at(i)->default_value;
+    }
+  }
+
+  if (func.body.isNull() && !new_one.body.isNull())
+  {
+    func.body = new_one.body;
+  }
+}
+
+} // namespace parsers
+
+} // namespace cxx
@@ -4,10 +4,28 @@
 
 #include "cxx/parsers/lexer.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
+#include <limits>
 #include <memory>
 #include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CXXAST_LEXER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CXXAST_TARGET(iset) __attribute__((target(iset)))
+#else
+#define CXXAST_TARGET(iset)
+#endif
 
 namespace cxx
 {
@@ -21,14 +39,14 @@ private:
   Lexer& m_lex;
   size_t m_pos;
   int m_line;
-  int m_col;
+  size_t m_line_start;
 
 public:
   LexerGuard(Lexer* lex)
     : m_lex(*lex),
-      m_pos(lex->pos()),
-      m_line(lex->line()),
-      m_col(lex->col())
+      m_pos(lex->m_pos),
+      m_line(lex->m_line),
+      m_line_start(lex->m_line_start)
   {
 
   }
@@ -39,21 +57,437 @@ public:
     {
       m_lex.m_pos = m_pos;
       m_lex.m_line = m_line;
-      m_lex.m_col = m_col;
+      m_lex.m_line_start = m_line_start;
     }
   }
 };
 
+// Vectorized scanning routines used to skip whitespaces and comments.
+// Each routine has the same semantic as the character-by-character loop
+// it replaces; the Lexer selects one of them at runtime.
+
+struct DiscardableRun
+{
+  const char* end;
+  int newlines;
+  const char* last_newline;
+};
+
+static inline int count_trailing_zeros(unsigned int mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+static inline int highest_bit(unsigned int mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanReverse(&index, mask);
+  return static_cast<int>(index);
+#else
+  return 31 - __builtin_clz(mask);
+#endif
+}
+
+static inline int popcount(unsigned int mask)
+{
+  int n = 0;
+
+  while (mask)
+  {
+    mask &= mask - 1;
+    ++n;
+  }
+
+  return n;
+}
+
+static inline bool is_discardable_char(char c)
+{
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline void account_newlines(DiscardableRun& run, const char* base, unsigned int nl_mask)
+{
+  if (nl_mask)
+  {
+    run.newlines += popcount(nl_mask);
+    run.last_newline = base + highest_bit(nl_mask);
+  }
+}
+
+static DiscardableRun skip_discardable_tail(DiscardableRun run, const char* end)
+{
+  while (run.end != end && is_discardable_char(*run.end))
+  {
+    if (*run.end == '\n')
+    {
+      run.newlines += 1;
+      run.last_newline = run.end;
+    }
+
+    ++run.end;
+  }
+
+  return run;
+}
+
+static const char* find_char_tail(const char* begin, const char* end, char c)
+{
+  while (begin != end && *begin != c)
+    ++begin;
+
+  return begin;
+}
+
+static const char* find_comment_end_tail(const char* begin, const char* end)
+{
+  while (end - begin >= 2)
+  {
+    if (begin[0] == '*' && begin[1] == '/')
+      return begin;
+
+    ++begin;
+  }
+
+  return end;
+}
+
+static void find_line_starts_tail(const char* begin, const char* end, const char* base, std::vector<std::uint32_t>& line_starts)
+{
+  for (; begin != end; ++begin)
+  {
+    if (*begin == '\n')
+      line_starts.push_back(static_cast<std::uint32_t>(begin + 1 - base));
+  }
+}
+
+#if defined(CXXAST_LEXER_X86)
+
+CXXAST_TARGET("sse2")
+static DiscardableRun skip_discardable_sse2(const char* begin, const char* end)
+{
+  DiscardableRun run{ begin, 0, nullptr };
+
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i tab = _mm_set1_epi8('\t');
+
+  while (end - run.end >= 16)
+  {
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(run.end));
+    const __m128i nl = _mm_cmpeq_epi8(chars, lf);
+    const __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, space), nl),
+      _mm_or_si128(_mm_cmpeq_epi8(chars, cr), _mm_cmpeq_epi8(chars, tab)));
+
+    const unsigned int ws_mask = static_cast<unsigned int>(_mm_movemask_epi8(ws));
+    const unsigned int nl_mask = static_cast<unsigned int>(_mm_movemask_epi8(nl));
+
+    if (ws_mask != 0xFFFF)
+    {
+      const int n = count_trailing_zeros(~ws_mask);
+      account_newlines(run, run.end, nl_mask & ((1u << n) - 1));
+      run.end += n;
+      return run;
+    }
+
+    account_newlines(run, run.end, nl_mask);
+    run.end += 16;
+  }
+
+  return skip_discardable_tail(run, end);
+}
+
+CXXAST_TARGET("sse2")
+static const char* find_char_sse2(const char* begin, const char* end, char c)
+{
+  const __m128i needle = _mm_set1_epi8(c);
+
+  while (end - begin >= 16)
+  {
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, needle)));
+
+    if (mask)
+      return begin + count_trailing_zeros(mask);
+
+    begin += 16;
+  }
+
+  return find_char_tail(begin, end, c);
+}
+
+CXXAST_TARGET("sse2")
+static const char* find_comment_end_sse2(const char* begin, const char* end)
+{
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i slash = _mm_set1_epi8('/');
+
+  // the second load reads one byte past the block
+  while (end - begin >= 17)
+  {
+    const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + 1));
+    const __m128i match = _mm_and_si128(_mm_cmpeq_epi8(first, star), _mm_cmpeq_epi8(second, slash));
+    const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(match));
+
+    if (mask)
+      return begin + count_trailing_zeros(mask);
+
+    begin += 16;
+  }
+
+  return find_comment_end_tail(begin, end);
+}
+
+CXXAST_TARGET("sse2")
+static void find_line_starts_sse2(const char* begin, const char* end, std::vector<std::uint32_t>& line_starts)
+{
+  const char* it = begin;
+  const __m128i lf = _mm_set1_epi8('\n');
+
+  while (end - it >= 16)
+  {
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+    unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, lf)));
+
+    while (mask)
+    {
+      line_starts.push_back(static_cast<std::uint32_t>(it - begin + count_trailing_zeros(mask) + 1));
+      mask &= mask - 1;
+    }
+
+    it += 16;
+  }
+
+  find_line_starts_tail(it, end, begin, line_starts);
+}
+
+CXXAST_TARGET("avx2")
+static DiscardableRun skip_discardable_avx2(const char* begin, const char* end)
+{
+  DiscardableRun run{ begin, 0, nullptr };
+
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i tab = _mm256_set1_epi8('\t');
+
+  while (end - run.end >= 32)
+  {
+    const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(run.end));
+    const __m256i nl = _mm256_cmpeq_epi8(chars, lf);
+    const __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chars, space), nl),
+      _mm256_or_si256(_mm256_cmpeq_epi8(chars, cr), _mm256_cmpeq_epi8(chars, tab)));
+
+    const unsigned int ws_mask = static_cast<unsigned int>(_mm256_movemask_epi8(ws));
+    const unsigned int nl_mask = static_cast<unsigned int>(_mm256_movemask_epi8(nl));
+
+    if (ws_mask != 0xFFFFFFFF)
+    {
+      const int n = count_trailing_zeros(~ws_mask);
+      account_newlines(run, run.end, nl_mask & ((1u << n) - 1));
+      run.end += n;
+      return run;
+    }
+
+    account_newlines(run, run.end, nl_mask);
+    run.end += 32;
+  }
+
+  return skip_discardable_tail(run, end);
+}
+
+CXXAST_TARGET("avx2")
+static const char* find_char_avx2(const char* begin, const char* end, char c)
+{
+  const __m256i needle = _mm256_set1_epi8(c);
+
+  while (end - begin >= 32)
+  {
+    const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, needle)));
+
+    if (mask)
+      return begin + count_trailing_zeros(mask);
+
+    begin += 32;
+  }
+
+  return find_char_tail(begin, end, c);
+}
+
+CXXAST_TARGET("avx2")
+static const char* find_comment_end_avx2(const char* begin, const char* end)
+{
+  const __m256i star = _mm256_set1_epi8('*');
+  const __m256i slash = _mm256_set1_epi8('/');
+
+  while (end - begin >= 33)
+  {
+    const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin + 1));
+    const __m256i match = _mm256_and_si256(_mm256_cmpeq_epi8(first, star), _mm256_cmpeq_epi8(second, slash));
+    const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(match));
+
+    if (mask)
+      return begin + count_trailing_zeros(mask);
+
+    begin += 32;
+  }
+
+  return find_comment_end_tail(begin, end);
+}
+
+CXXAST_TARGET("avx2")
+static void find_line_starts_avx2(const char* begin, const char* end, std::vector<std::uint32_t>& line_starts)
+{
+  const char* it = begin;
+  const __m256i lf = _mm256_set1_epi8('\n');
+
+  while (end - it >= 32)
+  {
+    const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(it));
+    unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, lf)));
+
+    while (mask)
+    {
+      line_starts.push_back(static_cast<std::uint32_t>(it - begin + count_trailing_zeros(mask) + 1));
+      mask &= mask - 1;
+    }
+
+    it += 32;
+  }
+
+  find_line_starts_tail(it, end, begin, line_starts);
+}
+
+static Lexer::InstructionSet detect_instruction_set()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  const int nids = info[0];
+
+  __cpuid(info, 1);
+  const bool sse2 = (info[3] & (1 << 26)) != 0;
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+
+  bool avx2 = false;
+
+  if (nids >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+  {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#else
+  __builtin_cpu_init();
+  const bool sse2 = __builtin_cpu_supports("sse2");
+  const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+  if (avx2)
+    return Lexer::AVX2;
+  else if (sse2)
+    return Lexer::SSE2;
+  else
+    return Lexer::Scalar;
+}
+
+#else
+
+static Lexer::InstructionSet detect_instruction_set()
+{
+  return Lexer::Scalar;
+}
+
+#endif // defined(CXXAST_LEXER_X86)
+
+static DiscardableRun skip_discardable(Lexer::InstructionSet iset, const char* begin, const char* end)
+{
+  switch (iset)
+  {
+#if defined(CXXAST_LEXER_X86)
+  case Lexer::AVX2:
+    return skip_discardable_avx2(begin, end);
+  case Lexer::SSE2:
+    return skip_discardable_sse2(begin, end);
+#endif
+  default:
+    return skip_discardable_tail(DiscardableRun{ begin, 0, nullptr }, end);
+  }
+}
+
+static const char* find_char(Lexer::InstructionSet iset, const char* begin, const char* end, char c)
+{
+  switch (iset)
+  {
+#if defined(CXXAST_LEXER_X86)
+  case Lexer::AVX2:
+    return find_char_avx2(begin, end, c);
+  case Lexer::SSE2:
+    return find_char_sse2(begin, end, c);
+#endif
+  default:
+    return find_char_tail(begin, end, c);
+  }
+}
+
+static const char* find_comment_end(Lexer::InstructionSet iset, const char* begin, const char* end)
+{
+  switch (iset)
+  {
+#if defined(CXXAST_LEXER_X86)
+  case Lexer::AVX2:
+    return find_comment_end_avx2(begin, end);
+  case Lexer::SSE2:
+    return find_comment_end_sse2(begin, end);
+#endif
+  default:
+    return find_comment_end_tail(begin, end);
+  }
+}
+
+static void find_line_starts(Lexer::InstructionSet iset, const char* begin, const char* end, std::vector<std::uint32_t>& line_starts)
+{
+  switch (iset)
+  {
+#if defined(CXXAST_LEXER_X86)
+  case Lexer::AVX2:
+    return find_line_starts_avx2(begin, end, line_starts);
+  case Lexer::SSE2:
+    return find_line_starts_sse2(begin, end, line_starts);
+#endif
+  default:
+    return find_line_starts_tail(begin, end, begin, line_starts);
+  }
+}
+
 Lexer::Lexer(const std::string* src)
-  : m_source(src),
-    m_chars(src->data())
+  : m_chars(src->data()),
+    m_length(src->size())
 {
 
 }
 
-const std::string& Lexer::source() const
+Lexer::Lexer(const SourceBuffer& src)
+  : m_chars(src.data()),
+    m_length(src.size())
 {
-  return *m_source;
+
+}
+
+StringView Lexer::source() const
+{
+  return StringView(m_chars, m_length);
 }
 
 void Lexer::start()
@@ -63,11 +497,20 @@ void Lexer::start()
 
 Token Lexer::read()
 {
+  m_error = NoError;
+
   if (this->atEnd())
-    throw std::runtime_error{ "Lexer::read() : reached end of input" };
+    return fail(pos(), UnexpectedEndOfInput, "Lexer::read() : reached end of input");
+
+  if (m_error_mode == ErrorTokens)
+    return readToken();
 
   LexerGuard guard{ this };
+  return readToken();
+}
 
+Token Lexer::readToken()
+{
   size_t p = pos();
 
   char c = readChar();
@@ -126,16 +569,42 @@ Token Lexer::read()
     result = readFromPunctuator(p);
     break;
   default:
-    throw std::runtime_error{ "Lexer::read() : Unexpected input char" };
+    result = fail(p, UnexpectedCharacter, "Lexer::read() : Unexpected input char");
+    break;
   }
 
   consumeDiscardable();
   return result;
 }
 
+Lexer::ErrorMode Lexer::errorMode() const
+{
+  return m_error_mode;
+}
+
+void Lexer::setErrorMode(ErrorMode mode)
+{
+  m_error_mode = mode;
+}
+
+Lexer::Error Lexer::error() const
+{
+  return m_error;
+}
+
+bool Lexer::internIdentifiers() const
+{
+  return m_intern_identifiers;
+}
+
+void Lexer::setInternIdentifiers(bool on)
+{
+  m_intern_identifiers = on;
+}
+
 bool Lexer::atEnd() const
 {
-  return m_pos == m_source->length();
+  return m_pos == m_length;
 }
 
 size_t Lexer::pos() const
@@ -150,21 +619,153 @@ int Lexer::line() const
 
 int Lexer::col() const
 {
-  return m_col;
+  return static_cast<int>(m_pos - m_line_start);
+}
+
+Lexer::InstructionSet Lexer::supportedInstructionSet()
+{
+  static const InstructionSet value = detect_instruction_set();
+  return value;
+}
+
+Lexer::InstructionSet Lexer::instructionSet() const
+{
+  return m_iset;
+}
+
+// Returns the offset of the first char of each line of the source.
+std::vector<std::uint32_t> Lexer::lineOffsets(StringView source)
+{
+  if (source.size() > std::numeric_limits<std::uint32_t>::max())
+    throw std::runtime_error{ "Lexer::lineOffsets() : source is too large" };
+
+  std::vector<std::uint32_t> result;
+  result.reserve(source.size() / 32 + 1);
+  result.push_back(0);
+  find_line_starts(supportedInstructionSet(), source.data(), source.data() + source.size(), result);
+  return result;
+}
+
+// Returns at most (chunks - 1) offsets where the source can be split so that 
+// each part can be lexed on its own.
+// A split point is the start of a line that the Lexer reaches between two tokens,
+// i.e. outside of comments and string or char literals; the pre-scan follows 
+// the same rules as the Lexer. 
+// No split point is searched past input that the Lexer would reject.
+std::vector<size_t> Lexer::splitPoints(StringView source, size_t chunks)
+{
+  std::vector<size_t> result;
+
+  if (chunks < 2)
+    return result;
+
+  const InstructionSet iset = supportedInstructionSet();
+  const char* const begin = source.data();
+  const char* const end = begin + source.size();
+  const size_t chunk_size = source.size() / chunks;
+
+  const char* it = begin;
+  const char* target = begin + chunk_size;
+
+  while (it != end && result.size() < chunks - 1)
+  {
+    switch (*it)
+    {
+    case '\n':
+    {
+      ++it;
+
+      if (it >= target && it != end)
+      {
+        result.push_back(it - begin);
+        target = begin + chunk_size * (result.size() + 1);
+      }
+    }
+    break;
+    case '/':
+    {
+      if (end - it >= 2 && it[1] == '/')
+      {
+        it = find_char(iset, it + 2, end, '\n');
+      }
+      else if (end - it >= 2 && it[1] == '*')
+      {
+        const char* star = find_comment_end(iset, it + 2, end);
+
+        if (star == end)
+          return result;
+
+        it = star + 2;
+      }
+      else
+      {
+        ++it;
+      }
+    }
+    break;
+    case '"':
+    {
+      ++it;
+
+      while (it != end && *it != '"')
+      {
+        if (*it == '\\')
+        {
+          if (++it != end)
+            ++it;
+        }
+        else if (*it == '\n')
+        {
+          return result;
+        }
+        else
+        {
+          ++it;
+        }
+      }
+
+      if (it == end)
+        return result;
+
+      ++it;
+    }
+    break;
+    case '\'':
+    {
+      if (end - it < 3 || it[2] != '\'')
+        return result;
+
+      it += 3;
+    }
+    break;
+    default:
+      ++it;
+      break;
+    }
+  }
+
+  return result;
+}
+
+// If the requested instruction set is not supported by the CPU, 
+// the best supported one is used instead.
+void Lexer::setInstructionSet(InstructionSet iset)
+{
+  m_iset = iset <= supportedInstructionSet() ? iset : supportedInstructionSet();
 }
 
 void Lexer::seek(size_t pos)
 {
-  if (pos > m_source->length())
+  if (pos > m_length)
   {
-    seek(m_source->length());
+    seek(m_length);
   }
   else if (pos < m_pos)
   {
     // @TODO: there is a more efficient way to do that!
     m_pos = 0;
     m_line = 0;
-    m_col = 0;
+    m_line_start = 0;
     seek(pos);
   }
   else if (pos > m_pos)
@@ -176,37 +777,248 @@ void Lexer::seek(size_t pos)
   }
 }
 
+// Moves to the '}' that closes a brace the caller has just read, without
+// producing the tokens in between; only braces, comments and literals are
+// recognized there.
+// Returns false, without moving, if the '}' is not found.
+bool Lexer::skipBraces()
+{
+  const char* const begin = m_chars + m_pos;
+  const char* const end = m_chars + m_length;
+  const char* it = begin;
+  int depth = 1;
+
+  auto is_ident_char = [](char c) {
+    return isLetter(c) || isDigit(c) || c == '_';
+  };
+
+  // skips a string or char literal, 'it' being on the opening quote
+  auto skip_quoted = [&it, end]() -> bool {
+    const char quote = *it++;
+
+    while (it != end && *it != quote)
+    {
+      if (*it == '\\' && ++it == end)
+        return false;
+      else if (*it == '\n')
+        return false;
+
+      ++it;
+    }
+
+    if (it == end)
+      return false;
+
+    ++it;
+    return true;
+  };
+
+  // skips R"delim( ... )delim", 'it' being on the opening quote
+  auto skip_raw_string = [&it, end]() -> bool {
+    const char* delim = ++it;
+
+    while (it != end && *it != '(')
+      ++it;
+
+    if (it == end)
+      return false;
+
+    const std::string closing = ")" + std::string(delim, it) + "\"";
+    const char* found = std::search(it, end, closing.begin(), closing.end());
+
+    if (found == end)
+      return false;
+
+    it = found + closing.size();
+    return true;
+  };
+
+  while (it != end)
+  {
+    const char c = *it;
+
+    if (c == '{')
+    {
+      ++depth;
+      ++it;
+    }
+    else if (c == '}')
+    {
+      if (--depth == 0)
+        break;
+
+      ++it;
+    }
+    else if (c == '/' && end - it >= 2 && it[1] == '/')
+    {
+      it = find_char(m_iset, it + 2, end, '\n');
+    }
+    else if (c == '/' && end - it >= 2 && it[1] == '*')
+    {
+      const char* star = find_comment_end(m_iset, it + 2, end);
+
+      if (star == end)
+        return false;
+
+      it = star + 2;
+    }
+    else if (c == '"' || c == '\'')
+    {
+      if (!skip_quoted())
+        return false;
+    }
+    else if (isDigit(c))
+    {
+      // a number, whose digit separators are not char literals
+      while (it != end && (is_ident_char(*it) || *it == '\'' || *it == '.'))
+        ++it;
+    }
+    else if (is_ident_char(c))
+    {
+      const char* word = it;
+
+      while (it != end && is_ident_char(*it))
+        ++it;
+
+      // the prefix of a raw string literal
+      if (it != end && *it == '"')
+      {
+        const std::string prefix{ word, it };
+
+        if (prefix == "R" || prefix == "u8R" || prefix == "uR" || prefix == "UR" || prefix == "LR")
+        {
+          if (!skip_raw_string())
+            return false;
+        }
+      }
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  if (it == end)
+    return false;
+
+  for (const char* p = begin; p != it; )
+  {
+    p = find_char(m_iset, p, it, '\n');
+
+    if (p != it)
+    {
+      ++m_line;
+      m_line_start = ++p - m_chars;
+    }
+  }
+
+  m_pos = it - m_chars;
+  return true;
+}
+
 void Lexer::reset(const std::string* src)
 {
-  m_source = src;
-  m_chars = src->data();
+  reset(src->data(), src->size());
+}
+
+void Lexer::reset(const SourceBuffer& src)
+{
+  reset(src.data(), src.size());
+}
+
+void Lexer::reset(const char* data, size_t length)
+{
+  m_chars = data;
+  m_length = length;
   m_pos = 0;
   m_line = 0;
-  m_col = 0;
+  m_line_start = 0;
   consumeDiscardable();
 }
 
+// Updates 'tokens', which holds the tokens of the source before 'edit', 
+// to hold the tokens of the source the lexer was reset to.
+// Lexing restarts at the last token starting before the edit and stops as soon 
+// as a token starts where an old token started, from which point both token 
+// streams are the same; the old tokens after that are only moved.
+// Returns the range of the new tokens in the buffer.
+// The line and column of the lexer are not meaningful afterwards.
+std::pair<size_t, size_t> Lexer::relex(TokenBuffer& tokens, const SourceEdit& edit, bool discard_comments)
+{
+  const std::ptrdiff_t shift = static_cast<std::ptrdiff_t>(edit.inserted) - static_cast<std::ptrdiff_t>(edit.removed);
+  const size_t edit_end = edit.offset + edit.inserted;
+
+  // first token starting at or after the edit
+  size_t first = 0;
+  size_t count = tokens.size();
+
+  while (count > 0)
+  {
+    const size_t half = count / 2;
+
+    if (tokens.offset(first + half) < edit.offset)
+    {
+      first += half + 1;
+      count -= half + 1;
+    }
+    else
+    {
+      count = half;
+    }
+  }
+
+  // the token before the edit may be extended by it (e.g. 'a' -> 'ab')
+  if (first > 0)
+    --first;
+
+  m_pos = first < tokens.size() && tokens.offset(first) < edit.offset ? tokens.offset(first) : 0;
+  m_line = 0;
+  m_line_start = m_pos;
+  consumeDiscardable();
+
+  TokenBuffer relexed;
+  relexed.reset(source());
+
+  size_t last = first;
+
+  while (!atEnd())
+  {
+    if (pos() >= edit_end)
+    {
+      while (last < tokens.size() && static_cast<std::ptrdiff_t>(tokens.offset(last)) + shift < static_cast<std::ptrdiff_t>(pos()))
+        ++last;
+
+      if (last < tokens.size() && static_cast<std::ptrdiff_t>(tokens.offset(last)) + shift == static_cast<std::ptrdiff_t>(pos()))
+        break;
+    }
+
+    const Token tok = read();
+
+    if (!discard_comments || (tok != TokenType::SingleLineComment && tok != TokenType::MultiLineComment))
+      relexed.push_back(tok);
+  }
+
+  if (atEnd())
+    last = tokens.size();
+
+  tokens.splice(first, last, relexed, shift);
+  return std::make_pair(first, first + relexed.size());
+}
+
 char Lexer::readChar()
 {
   if (atEnd())
     throw std::runtime_error{ "Lexer::readChar() : end of input" };
 
-  ++m_col;
   return *(m_chars + m_pos++);
 }
 
 void Lexer::discardChar() noexcept
 {
-  char c = *(m_chars + m_pos++);
-
-  if (c == '\n')
+  if (*(m_chars + m_pos++) == '\n')
   {
     ++m_line;
-    m_col = 0;
-  }
-  else
-  {
-    ++m_col;
+    m_line_start = m_pos;
   }
 }
 
@@ -222,18 +1034,44 @@ char Lexer::currentChar() const
 
 void Lexer::consumeDiscardable()
 {
-  while (!atEnd() && isDiscardable(peekChar()))
-    discardChar();
+  if (m_iset == Scalar)
+  {
+    while (!atEnd() && isDiscardable(peekChar()))
+      discardChar();
+
+    return;
+  }
+
+  const char* begin = m_chars + m_pos;
+  DiscardableRun run = skip_discardable(m_iset, begin, m_chars + m_length);
+
+  if (run.newlines)
+  {
+    m_line += run.newlines;
+    m_line_start = run.last_newline + 1 - m_chars;
+  }
+
+  m_pos = run.end - m_chars;
 }
 
 Token Lexer::create(size_t pos, size_t length, TokenType type)
 {
-  return Token{ type, StringView(m_chars + pos, length), m_line, static_cast<int>(m_col - length) };
+  return Token{ type, StringView(m_chars + pos, length), m_line, static_cast<int>(pos - m_line_start) };
+}
+
+// Throws, or returns an Invalid token spanning from 'pos' to the current position.
+Token Lexer::fail(size_t pos, Error err, const char* what)
+{
+  if (m_error_mode == ThrowOnError)
+    throw std::runtime_error{ what };
+
+  m_error = err;
+  return create(pos, TokenType::Invalid);
 }
 
 Token Lexer::create(size_t pos, TokenType type)
 {
-  return Token{ type, StringView(m_chars + pos, this->pos() - pos), m_line, static_cast<int>(m_col - (this->pos() - pos)) };
+  return Token{ type, StringView(m_chars + pos, this->pos() - pos), m_line, static_cast<int>(pos - m_line_start) };
 }
 
 Lexer::CharacterType Lexer::ctype(char c)
@@ -369,8 +1207,10 @@ Lexer::CharacterType Lexer::ctype(char c)
     Invalid, // DEL    (delete)
   };
 
-  if(c <= 127)
-    return map[c];
+  const unsigned char uc = static_cast<unsigned char>(c);
+
+  if(uc <= 127)
+    return map[uc];
   return Other;
 }
 
@@ -433,13 +1273,13 @@ Token Lexer::readHexa(size_t start)
   assert(x == 'x');
 
   if (atEnd())  // input ends with '0x' -> error
-    throw std::runtime_error{ "Lexer::readHexa() : unexpected end of input" };
+    return fail(start, MalformedNumericLiteral, "Lexer::readHexa() : unexpected end of input");
 
   while (!atEnd() && Lexer::isHexa(peekChar()))
     readChar();
 
   if(pos() - start == 2/* || !checkAfter<Token::HexadecimalLiteral>()*/) // e.g. 0x+
-    throw std::runtime_error{ "Lexer::readHexa() : unexpected end of input" };
+    return fail(start, MalformedNumericLiteral, "Lexer::readHexa() : unexpected end of input");
   
   return create(start, TokenType::HexadecimalLiteral);
 }
@@ -474,7 +1314,7 @@ Token Lexer::readBinary(size_t start)
   assert(b == 'b');
 
   if (atEnd())  // input ends with '0b' -> error
-    throw std::runtime_error{ "Lexer::readBinary() : unexpected end of input" };
+    return fail(start, MalformedNumericLiteral, "Lexer::readBinary() : unexpected end of input");
 
   while (!atEnd() && Lexer::isBinary(peekChar()))
     readChar();
@@ -499,7 +1339,7 @@ Token Lexer::readDecimal(size_t start)
     readChar();
 
   if (atEnd())
-    create(start, TokenType::IntegerLiteral);
+    return create(start, TokenType::IntegerLiteral);
 
   bool is_decimal = false;
 
@@ -521,13 +1361,13 @@ Token Lexer::readDecimal(size_t start)
     is_decimal = true;
 
     if (atEnd())
-      throw std::runtime_error{ "Lexer::readDecimal() : unexpected end of input while reading floating point literal" };
+      return fail(start, MalformedNumericLiteral, "Lexer::readDecimal() : unexpected end of input while reading floating point literal");
 
     if (peekChar() == '+' || peekChar() == '-')
     {
       readChar();
       if (atEnd())
-        throw std::runtime_error{ "Lexer::readDecimal() : unexpected end of input while reading floating point literal" };
+        return fail(start, MalformedNumericLiteral, "Lexer::readDecimal() : unexpected end of input while reading floating point literal");
     }
 
     while (!atEnd() && Lexer::isDigit(peekChar()))
@@ -575,125 +1415,148 @@ Token Lexer::readIdentifier(size_t start)
 {
   while (!this->atEnd() && (Lexer::isLetter(peekChar()) || Lexer::isDigit(peekChar()) || peekChar() == '_'))
     readChar();
-  return create(start, pos() - start, identifierType(start, pos()));
+
+  Token result = create(start, pos() - start, identifierType(start, pos()));
+
+  if (m_intern_identifiers && result.type() == TokenType::UserDefinedName)
+    result.setSymbol(Symbol(m_chars + start, pos() - start));
+
+  return result;
 }
 
 
 struct Keyword {
-  const char *name;
-  TokenType toktype;
+  const char* name = nullptr;
+  size_t length = 0;
+  TokenType::Value toktype = TokenType::UserDefinedName;
 };
 
-const Keyword l2k[] = {
-  { "do", TokenType::Do },
-  { "if", TokenType::If },
+constexpr Keyword keywords[] = {
+  { "auto", 4, TokenType::Auto },
+  { "bool", 4, TokenType::Bool },
+  { "break", 5, TokenType::Break },
+  { "case", 4, TokenType::Case },
+  { "catch", 5, TokenType::Catch },
+  { "char", 4, TokenType::Char },
+  { "class", 5, TokenType::Class },
+  { "const", 5, TokenType::Const },
+  { "constexpr", 9, TokenType::Constexpr },
+  { "continue", 8, TokenType::Continue },
+  { "default", 7, TokenType::Default },
+  { "delete", 6, TokenType::Delete },
+  { "do", 2, TokenType::Do },
+  { "double", 6, TokenType::Double },
+  { "else", 4, TokenType::Else },
+  { "enum", 4, TokenType::Enum },
+  { "explicit", 8, TokenType::Explicit },
+  { "export", 6, TokenType::Export },
+  { "false", 5, TokenType::False },
+  { "final", 5, TokenType::Final },
+  { "float", 5, TokenType::Float },
+  { "for", 3, TokenType::For },
+  { "friend", 6, TokenType::Friend },
+  { "if", 2, TokenType::If },
+  { "import", 6, TokenType::Import },
+  { "inline", 6, TokenType::Inline },
+  { "int", 3, TokenType::Int },
+  { "mutable", 7, TokenType::Mutable },
+  { "namespace", 9, TokenType::Namespace },
+  { "noexcept", 8, TokenType::Noexcept },
+  { "operator", 8, TokenType::Operator },
+  { "override", 8, TokenType::Override },
+  { "private", 7, TokenType::Private },
+  { "protected", 9, TokenType::Protected },
+  { "public", 6, TokenType::Public },
+  { "return", 6, TokenType::Return },
+  { "static", 6, TokenType::Static },
+  { "struct", 6, TokenType::Struct },
+  { "template", 8, TokenType::Template },
+  { "this", 4, TokenType::This },
+  { "throw", 5, TokenType::Throw },
+  { "true", 4, TokenType::True },
+  { "try", 3, TokenType::Try },
+  { "typedef", 7, TokenType::Typedef },
+  { "typeid", 6, TokenType::Typeid },
+  { "typename", 8, TokenType::Typename },
+  { "using", 5, TokenType::Using },
+  { "virtual", 7, TokenType::Virtual },
+  { "void", 4, TokenType::Void },
+  { "while", 5, TokenType::While },
 };
 
-const Keyword l3k[] = {
-  { "for", TokenType::For },
-  { "int", TokenType::Int },
-  { "try", TokenType::Try },
-};
+constexpr size_t keyword_min_length = 2;
+constexpr size_t keyword_max_length = 9;
 
-const Keyword l4k[] = {
-  { "auto", TokenType::Auto },
-  { "bool", TokenType::Bool },
-  { "case", TokenType::Case },
-  { "char", TokenType::Char },
-  { "else", TokenType::Else },
-  { "enum", TokenType::Enum },
-  { "this", TokenType::This },
-  { "true", TokenType::True },
-  { "void", TokenType::Void },
-};
+// Keywords are looked up in a perfect hash table built at compile-time.
+// The hash only reads the length and the first two and last two chars of 
+// the identifier; a multiplicative seed is searched so that no two keywords 
+// share a slot.
 
-const Keyword l5k[] = {
-  { "break", TokenType::Break },
-  { "catch", TokenType::Catch },
-  { "class", TokenType::Class },
-  { "const", TokenType::Const },
-  { "false", TokenType::False },
-  { "final", TokenType::Final },
-  { "float", TokenType::Float },
-  { "throw", TokenType::Throw },
-  { "using", TokenType::Using },
-  { "while", TokenType::While },
+struct KeywordTable
+{
+  std::uint32_t seed = 0;
+  Keyword slots[256] = {};
 };
 
-const Keyword l6k[] = {
-  { "delete", TokenType::Delete },
-  { "double", TokenType::Double },
-  { "export", TokenType::Export },
-  { "friend", TokenType::Friend },
-  { "import", TokenType::Import },
-  { "inline", TokenType::Inline },
-  { "public", TokenType::Public },
-  { "return", TokenType::Return },
-  { "static", TokenType::Static },
-  { "struct", TokenType::Struct },
-  { "typeid", TokenType::Typeid },
-};
+constexpr std::uint32_t keyword_hash(const char* str, size_t length, std::uint32_t seed)
+{
+  const std::uint32_t x = (static_cast<std::uint32_t>(static_cast<unsigned char>(str[0]))
+    | static_cast<std::uint32_t>(static_cast<unsigned char>(str[1])) << 8
+    | static_cast<std::uint32_t>(static_cast<unsigned char>(str[length - 2])) << 16
+    | static_cast<std::uint32_t>(static_cast<unsigned char>(str[length - 1])) << 24)
+    ^ static_cast<std::uint32_t>(length << 5);
 
-const Keyword l7k[] = {
-  { "default", TokenType::Default },
-  { "mutable", TokenType::Mutable },
-  { "private", TokenType::Private },
-  { "typedef", TokenType::Typedef },
-  { "virtual", TokenType::Virtual },
-};
+  return (x * seed) >> 24;
+}
 
-const Keyword l8k[] = {
-  { "continue", TokenType::Continue },
-  { "explicit", TokenType::Explicit },
-  { "noexcept", TokenType::Noexcept },
-  { "operator", TokenType::Operator },
-  { "override", TokenType::Override },
-  { "template", TokenType::Template },
-  { "typename", TokenType::Typename },
-};
+constexpr bool is_perfect_keyword_hash(std::uint32_t seed)
+{
+  bool used[256] = {};
 
-const Keyword l9k[] = {
-  { "constexpr", TokenType::Constexpr },
-  { "namespace", TokenType::Namespace },
-  { "protected", TokenType::Protected },
-};
+  for (const Keyword& kw : keywords)
+  {
+    const std::uint32_t h = keyword_hash(kw.name, kw.length, seed);
 
-static TokenType findKeyword(const Keyword * keywords, size_t arraySize, const char *str, size_t length)
-{
-  for (int i(0); i < arraySize; ++i) {
-    if (std::memcmp(keywords[i].name, str, length) == 0)
-      return keywords[i].toktype;
+    if (used[h])
+      return false;
+
+    used[h] = true;
   }
-  return TokenType::UserDefinedName;
+
+  return true;
 }
 
+constexpr KeywordTable make_keyword_table()
+{
+  KeywordTable table{};
+
+  std::uint32_t seed = 2654435761u;
+
+  while (!is_perfect_keyword_hash(seed))
+    seed = (seed * 1103515245u + 12345u) | 1u;
+
+  table.seed = seed;
+
+  for (const Keyword& kw : keywords)
+    table.slots[keyword_hash(kw.name, kw.length, seed)] = kw;
+
+  return table;
+}
+
+constexpr KeywordTable keyword_table = make_keyword_table();
+
 TokenType Lexer::identifierType(size_t begin, size_t end) const
 {
   const char *str = m_chars + begin;
   const size_t l = end - begin;
 
-  switch (l) {
-  case 1:
+  if (l < keyword_min_length || l > keyword_max_length)
     return TokenType::UserDefinedName;
-  case 2:
-    return findKeyword(l2k, sizeof(l2k) / sizeof(Keyword), str, l);
-  case 3:
-    return findKeyword(l3k, sizeof(l3k) / sizeof(Keyword), str, l);
-  case 4:
-    return findKeyword(l4k, sizeof(l4k) / sizeof(Keyword), str, l);
-  case 5:
-    return findKeyword(l5k, sizeof(l5k) / sizeof(Keyword), str, l);
-  case 6:
-    return findKeyword(l6k, sizeof(l6k) / sizeof(Keyword), str, l);
-  case 7:
-    return findKeyword(l7k, sizeof(l7k) / sizeof(Keyword), str, l);
-  case 8:
-    return findKeyword(l8k, sizeof(l8k) / sizeof(Keyword), str, l);
-  case 9:
-    return findKeyword(l9k, sizeof(l9k) / sizeof(Keyword), str, l);
-  default:
-    break;
-  }
+
+  const Keyword& kw = keyword_table.slots[keyword_hash(str, l, keyword_table.seed)];
+
+  if (kw.length == l && std::memcmp(kw.name, str, l) == 0)
+    return kw.toktype;
 
   return TokenType::UserDefinedName;
 }
@@ -716,13 +1579,13 @@ Token Lexer::readStringLiteral(size_t start)
         readChar();
     }
     else if (peekChar() == '\n')
-      throw std::runtime_error{ "Lexer::readStringLiteral() : end of line reached before end of string literal " };
+      return fail(start, UnterminatedStringLiteral, "Lexer::readStringLiteral() : end of line reached before end of string literal ");
     else
       readChar();
   }
 
   if(atEnd())
-    throw std::runtime_error{ "Lexer::readStringLiteral() : unexpected end of input before end of string literal " };
+    return fail(start, UnterminatedStringLiteral, "Lexer::readStringLiteral() : unexpected end of input before end of string literal ");
 
   assert(peekChar() == '"');
   readChar();
@@ -739,15 +1602,32 @@ Token Lexer::readStringLiteral(size_t start)
 Token Lexer::readCharLiteral(size_t start)
 {
   if(atEnd())
-    throw std::runtime_error{ "Lexer::readCharLiteral() : unexpected end of input before end of char-literal " };
+    return fail(start, MalformedCharLiteral, "Lexer::readCharLiteral() : unexpected end of input before end of char-literal ");
+
+  if (peekChar() == '\n')
+    return fail(start, MalformedCharLiteral, "Lexer::readCharLiteral() : malformed char-literal ");
 
   readChar();
 
   if (atEnd())
-    throw std::runtime_error{ "Lexer::readCharLiteral() : unexpected end of input before end of char-literal " };
+    return fail(start, MalformedCharLiteral, "Lexer::readCharLiteral() : unexpected end of input before end of char-literal ");
+
+  if (ctype(peekChar()) != SingleQuote)
+  {
+    if (m_error_mode == ErrorTokens)
+    {
+      // the error token extends to the closing quote, if there is one on the line
+      while (!atEnd() && peekChar() != '\n')
+      {
+        if (readChar() == '\'')
+          break;
+      }
+    }
 
-  if(ctype(readChar()) != SingleQuote)
-    throw std::runtime_error{ "Lexer::readCharLiteral() : malformed char-literal " };
+    return fail(start, MalformedCharLiteral, "Lexer::readCharLiteral() : malformed char-literal ");
+  }
+
+  readChar();
 
   return create(start, TokenType::StringLiteral);
 }
@@ -788,11 +1668,10 @@ Token Lexer::readColonOrColonColon(size_t start)
 
 struct OperatorLexeme {
   const char *name;
-  TokenType toktype;
+  TokenType::Value toktype;
 };
 
-
-const OperatorLexeme l1op[] = {
+constexpr OperatorLexeme operators[] = {
   { "+", TokenType::Plus },
   { "-", TokenType::Minus },
   { "!", TokenType::LogicalNot },
@@ -806,9 +1685,6 @@ const OperatorLexeme l1op[] = {
   { "^", TokenType::BitwiseXor },
   { "|", TokenType::BitwiseOr },
   { "=", TokenType::Eq },
-};
-
-const OperatorLexeme l2op[] = {
   { "++", TokenType::PlusPlus },
   { "--", TokenType::MinusMinus },
   { "<<", TokenType::LeftShift },
@@ -827,73 +1703,109 @@ const OperatorLexeme l2op[] = {
   { "&=", TokenType::BitAndEq },
   { "|=", TokenType::BitOrEq },
   { "^=", TokenType::BitXorEq },
-};
-
-
-const OperatorLexeme l3op[] = {
   { "<<=", TokenType::LeftShiftEq },
   { ">>=", TokenType::RightShiftEq },
 };
 
+// Operators are recognized with a trie built at compile-time.
+// Node 0 is the root; a child index of 0 means there is no transition.
 
-static TokenType findOperator(const OperatorLexeme * ops, size_t arraySize, const char *str, size_t length)
+struct OperatorTrie
 {
-  for (int i(0); i < arraySize; ++i) {
-    if (std::memcmp(ops[i].name, str, length) == 0)
-      return ops[i].toktype;
+  struct Node
+  {
+    TokenType::Value toktype = TokenType::Invalid;
+    unsigned char children[128] = {};
+  };
+
+  Node nodes[40] = {};
+  int size = 1;
+
+  constexpr int next(int node, char c) const
+  {
+    return static_cast<unsigned char>(c) < 128 ? nodes[node].children[static_cast<unsigned char>(c)] : 0;
+  }
+};
+
+constexpr OperatorTrie make_operator_trie()
+{
+  OperatorTrie trie{};
+
+  for (const OperatorLexeme& op : operators)
+  {
+    int node = 0;
+
+    for (const char* c = op.name; *c != '\0'; ++c)
+    {
+      unsigned char& child = trie.nodes[node].children[static_cast<unsigned char>(*c)];
+
+      if (child == 0)
+        child = static_cast<unsigned char>(trie.size++);
+
+      node = child;
+    }
+
+    trie.nodes[node].toktype = op.toktype;
   }
-  return TokenType::Invalid;
+
+  return trie;
 }
 
+constexpr OperatorTrie operator_trie = make_operator_trie();
+
 
 TokenType Lexer::getOperator(size_t begin, size_t end) const
 {
-  const char *str = m_chars + begin;
-  const size_t l = end - begin;
+  int node = 0;
 
-  switch (l) {
-  case 1:
-    return findOperator(l1op, sizeof(l1op) / sizeof(OperatorLexeme), str, l);
-  case 2:
-    return findOperator(l2op, sizeof(l2op) / sizeof(OperatorLexeme), str, l);
-  case 3:
-    return findOperator(l3op, sizeof(l3op) / sizeof(OperatorLexeme), str, l);
-  default:
-    break;
+  for (size_t i = begin; i < end; ++i)
+  {
+    node = operator_trie.next(node, m_chars[i]);
+
+    if (node == 0)
+      return TokenType::Invalid;
   }
 
-  return TokenType::Invalid;
+  return operator_trie.nodes[node].toktype;
 }
 
 Token Lexer::readOperator(size_t start)
 {
-  TokenType op = getOperator(start, pos());
-  if (op == TokenType::Invalid)
-    throw std::runtime_error{ "Lexer::readOperator() : no operator found starting with given chars" };
+  // every prefix of an operator is itself an operator, so the longest 
+  // match is found by following the trie until there is no transition
+  int node = operator_trie.next(0, m_chars[start]);
+
+  if (node == 0)
+    return fail(start, UnexpectedCharacter, "Lexer::readOperator() : no operator found starting with given chars");
   
   while (!atEnd())
   {
-    size_t p = pos();
-    readChar();
-    TokenType candidate = getOperator(start, pos());
-    if (candidate == TokenType::Invalid)
-    {
-      seek(p);
+    const int child = operator_trie.next(node, peekChar());
+
+    if (child == 0)
       break;
-    }
-    else
-      op = candidate;
+
+    readChar();
+    node = child;
   }
 
-  return create(start, op);
+  return create(start, operator_trie.nodes[node].toktype);
 }
 
 Token Lexer::readSingleLineComment(size_t start)
 {
   readChar(); // reads the second '/'
 
-  while (!atEnd() && peekChar() != '\n')
-    readChar();
+  if (m_iset == Scalar)
+  {
+    while (!atEnd() && peekChar() != '\n')
+      readChar();
+  }
+  else
+  {
+    const char* newline = find_char(m_iset, m_chars + m_pos, m_chars + m_length, '\n');
+    m_pos = newline - m_chars;
+  }
 
   return create(start, TokenType::SingleLineComment);
 }
@@ -902,23 +1814,58 @@ Token Lexer::readMultiLineComment(size_t start)
 {
   readChar(); // reads the '*' after opening '/'
 
+  // the comment token is positioned at its opening '/*', 
+  // line breaks inside the comment are tracked to position the next token
+  const int line = m_line;
+  const int col = static_cast<int>(start - m_line_start);
+
+  if (m_iset != Scalar)
+  {
+    const char* end = m_chars + m_length;
+    const char* star = find_comment_end(m_iset, m_chars + m_pos, end);
+
+    if (star == end)
+    {
+      m_pos = m_length;
+      return fail(start, UnterminatedComment, "Lexer::readMultiLineComment() : unexpected end of input before end of comment");
+    }
+
+    const char* it = m_chars + m_pos;
+
+    while ((it = find_char(m_iset, it, star, '\n')) != star)
+    {
+      ++m_line;
+      m_line_start = ++it - m_chars;
+    }
+
+    m_pos = star + 2 - m_chars;
+
+    return Token{ TokenType::MultiLineComment, StringView(m_chars + start, pos() - start), line, col };
+  }
+
   do {
     while (!atEnd() && peekChar() != '*')
-      readChar();
+      discardChar();
 
     if (atEnd())
-      throw std::runtime_error{ "Lexer::readMultiLineComment() : unexpected end of input before end of comment" };
+    {
+      const Token tok = fail(start, UnterminatedComment, "Lexer::readMultiLineComment() : unexpected end of input before end of comment");
+      return Token{ tok.type(), tok.text(), line, col };
+    }
 
     assert(peekChar() == '*');
     readChar(); // reads the '*'
 
     if (atEnd())
-      throw std::runtime_error{ "Lexer::readMultiLineComment() : unexpected end of input before end of comment" };
+    {
+      const Token tok = fail(start, UnterminatedComment, "Lexer::readMultiLineComment() : unexpected end of input before end of comment");
+      return Token{ tok.type(), tok.text(), line, col };
+    }
 
   } while (peekChar() != '/');
 
   readChar(); // reads the closing '/'
-  return create(start, TokenType::MultiLineComment);
+  return Token{ TokenType::MultiLineComment, StringView(m_chars + start, pos() - start), line, col };
 }
 
 } // namespace parsers
@@ -5,7 +5,9 @@
 #include "cxx/parsers/parser.h"
 
 #include "cxx/parsers/restricted-parser.h"
+#include "cxx/parsers/function-utils.h"
 #include "cxx/parsers/raii-utils.h"
+#include "cxx/parsers/reparse-utils.h"
 
 #include "cxx/clang/clang-translation-unit.h"
 #include "cxx/clang/clang-token.h"
@@ -106,22 +108,160 @@ std::shared_ptr<Program> LibClangParser::program() const
   return m_program;
 }
 
+// Parses the next files into 'p'. The files already parsed, and the 
+// translation units kept for reparse(), are forgotten.
+void LibClangParser::setProgram(std::shared_ptr<Program> p)
+{
+  m_program = p;
+  m_parsed_files.clear();
+  m_class_map.clear();
+  m_translation_units.clear();
+  m_registry_owner = 0;
+}
+
 bool LibClangParser::parse(const std::string& file)
 {
   this->skipped_declarations.clear();
 
   try
   {
-    m_tu = m_index.parseTranslationUnit(file, includedirs, skip_function_bodies ? CXTranslationUnit_SkipFunctionBodies : CXTranslationUnit_None);
+    unsigned int options = parse_options | (skip_function_bodies ? CXTranslationUnit_SkipFunctionBodies : CXTranslationUnit_None);
+
+    if (keep_translation_units)
+      options |= CXTranslationUnit_PrecompiledPreamble | CXTranslationUnit_CreatePreambleOnFirstParse;
+
+    clang_CXIndex_setGlobalOptions(m_index.index, index_options);
+
+    const std::vector<std::string> args = arguments(file);
+
+    // a translation unit loaded from a file cannot be reparsed
+    const bool use_cache = translation_unit_cache && !keep_translation_units;
+
+    m_tu = use_cache ? translation_unit_cache->load(m_index, file, args, static_cast<int>(options)) : ClangTranslationUnit();
+
+    if (!m_tu.translation_unit)
+    {
+      m_tu = m_index.parseTranslationUnit(file, args, static_cast<int>(options));
+
+      if (use_cache)
+        translation_unit_cache->store(m_tu, file, args, static_cast<int>(options));
+    }
   }
   catch (...)
   {
     return false;
   }
 
+  visitTranslationUnit(file);
+
+  if (keep_translation_units)
+    m_translation_units[getFile(file)->path()] = std::move(m_tu);
+
+  return true;
+}
+
+// Parses again a file previously parsed with 'keep_translation_units', 
+// either from the disk or from 'content'.
+// libclang only rebuilds the part of the translation unit that follows the 
+// preamble (the leading #include directives), and only the declarations of 
+// the main file are visited again; the included files are not.
+// The existing AST root of the file is kept and refilled, and the namespaces,
+// classes and functions that are still declared, in this file or in another 
+// one, keep their entities. Other entities (variables, enums...) declared in 
+// the file are created again and appended to their namespace; the members of
+// a class keep the order of its definition.
+// Returns false if the file cannot be reparsed, in which case it should 
+// be parsed with parse(). If visiting the new translation unit fails, the 
+// previous declarations cannot be restored: the file is left empty, as if 
+// it had not been parsed, and false is returned too.
+bool LibClangParser::reparse(const std::string& file)
+{
+  return reparseTranslationUnit(file, nullptr);
+}
+
+bool LibClangParser::reparse(const std::string& file, const std::string& content)
+{
+  return reparseTranslationUnit(file, &content);
+}
+
+bool LibClangParser::reparseTranslationUnit(const std::string& file, const std::string* content)
+{
+  std::shared_ptr<File> fileobj = getFile(file);
+  auto it = m_translation_units.find(fileobj->path());
+
+  if (it == m_translation_units.end() || !fileobj->ast || fileobj->ast->node_kind() != NodeKind::AstRootNode)
+    return false;
+
+  this->skipped_declarations.clear();
+
+  m_tu = std::move(it->second);
+  m_translation_units.erase(it);
+
+  CXUnsavedFile unsaved;
+
+  if (content)
+  {
+    unsaved.Filename = file.c_str();
+    unsaved.Contents = content->data();
+    unsaved.Length = static_cast<unsigned long>(content->size());
+  }
+
+  if (clang_reparseTranslationUnit(m_tu, content ? 1 : 0, content ? &unsaved : nullptr, clang_defaultReparseOptions(m_tu)) != 0)
+  {
+    // libclang requires the translation unit to be disposed
+    m_tu = ClangTranslationUnit();
+    return false;
+  }
+
+  auto root = std::static_pointer_cast<AstRootNode>(fileobj->ast);
+  std::vector<std::shared_ptr<IEntity>> previous;
+  detachFile(fileobj, previous);
+
+  {
+    // like with RestrictedParser::reparse(), the new nodes are allocated on the heap 
+    // so that the arena of the file does not grow with each edit
+    RAIIGuard<bool> arena_guard{ arena_allocation };
+    arena_allocation = false;
+
+    try
+    {
+      visitTranslationUnit(file);
+    }
+    catch (...)
+    {
+      // the file being visited may be another one, included for the first time
+      std::shared_ptr<File> current = m_current_file;
+      m_current_file = nullptr;
+      m_arena = nullptr;
+      m_unlocated_nodes.clear();
+      m_ast_stack.clear();
+
+      detachFile(fileobj, previous);
+
+      if (current && current != fileobj)
+        detachFile(current, previous);
+
+      remove_discarded(*root, previous, m_filesystem);
+
+      m_tu = ClangTranslationUnit();
+      return false;
+    }
+  }
+
+  remove_discarded(*root, previous, m_filesystem);
+
+  m_translation_units[fileobj->path()] = std::move(m_tu);
+
+  return true;
+}
+
+void LibClangParser::visitTranslationUnit(const std::string& file)
+{
   StateGuard stack_guard{ m_program_stack, m_program->globalNamespace() };
 
   m_tu_file = clang_getFile(m_tu, file.data());
+  m_current_cxfile = nullptr;
+  m_skipped_cxfile = nullptr;
 
   ClangCursor c = m_tu.getCursor();
 
@@ -129,10 +269,104 @@ bool LibClangParser::parse(const std::string& file)
     visit_tu(c);
     });
 
-
   commitCurrentFile();
+}
 
-  return true;
+// Unbinds the declarations of a node of the file being reparsed and 
+// appends their entities to 'entities'.
+// Namespaces, classes and functions stay in the program so that visiting 
+// the new translation unit finds them again; a class template loses its 
+// template parameters and a function the body that 'node' defines, as these 
+// are parsed again. The other entities are removed from their parent.
+void LibClangParser::detach(AstNode& node, std::vector<std::shared_ptr<IEntity>>& entities)
+{
+  for (std::shared_ptr<AstNode> child : node.children())
+  {
+    if (child)
+      detach(*child, entities);
+  }
+
+  if (!node.isDeclaration())
+    return;
+
+  std::shared_ptr<IEntity> entity = static_cast<IDeclaration&>(node).entity_ptr;
+
+  if (!entity)
+    return;
+
+  bool defined_here = false;
+  auto it = program()->astmap.find(entity.get());
+
+  if (it != program()->astmap.end() && it->second.get() == &node)
+  {
+    program()->astmap.erase(it);
+    defined_here = true;
+  }
+
+  if (entity->is<Function>())
+  {
+    if (defined_here)
+      static_cast<Function&>(*entity).body = Statement();
+  }
+  else if (entity->is<ClassTemplate>())
+  {
+    if (defined_here)
+      static_cast<ClassTemplate&>(*entity).template_parameters.clear();
+  }
+  else if (!entity->is<Class>() && !entity->is<Namespace>())
+  {
+    std::shared_ptr<IEntity> parent = entity->parent();
+
+    auto remove_from = [&entity](std::vector<std::shared_ptr<IEntity>>& entities) {
+      entities.erase(std::remove(entities.begin(), entities.end(), entity), entities.end());
+    };
+
+    if (parent && parent->is<Namespace>())
+      remove_from(static_cast<Namespace&>(*parent).entities);
+    else if (parent && parent->is<Class>())
+      remove_from(static_cast<Class&>(*parent).members);
+  }
+
+  entities.push_back(entity);
+}
+
+// Detaches the declarations of 'file' and empties its AST, so that the file 
+// is visited again by the next translation unit that includes it.
+void LibClangParser::detachFile(const std::shared_ptr<File>& file, std::vector<std::shared_ptr<IEntity>>& entities)
+{
+  if (file->ast && file->ast->node_kind() == NodeKind::AstRootNode)
+  {
+    for (std::shared_ptr<AstNode> child : file->ast->children())
+    {
+      if (child)
+        detach(*child, entities);
+    }
+
+    std::static_pointer_cast<AstRootNode>(file->ast)->childvec.clear();
+  }
+
+  m_parsed_files.erase(file);
+}
+
+// The command line used to parse 'file': the relevant arguments of its
+// compile command if the compilation database has one, followed by
+// 'includedirs' and 'defines'.
+std::vector<std::string> LibClangParser::arguments(const std::string& file) const
+{
+  const CompilationDatabase::Command* command = compilation_database ? compilation_database->find(file) : nullptr;
+
+  std::vector<std::string> result = command ? CompilationDatabase::parserArguments(*command) : std::vector<std::string>{ "-x", "c++" };
+
+  for (const std::string& dir : includedirs)
+  {
+    result.push_back("-I");
+    result.push_back(dir);
+  }
+
+  for (const auto& def : defines)
+    result.push_back("-D" + (def.second.empty() ? def.first : def.first + "=" + def.second));
+
+  return result;
 }
 
 cxx::AccessSpecifier LibClangParser::getAccessSpecifier(CX_CXXAccessSpecifier as)
@@ -162,6 +396,7 @@ void LibClangParser::commitCurrentFile()
     m_parsed_files.insert(m_current_file);
     m_current_file->ast->updateSourceRange();
     m_current_file = nullptr;
+    m_arena = nullptr;
     m_unlocated_nodes.clear();
   }
 }
@@ -440,7 +675,7 @@ static AstNodeKind convert_astnodekind(CXCursorKind k)
 
 std::shared_ptr<AstNode> LibClangParser::createAstNode(const ClangCursor& c)
 {
-  auto ret = std::make_shared<UnexposedAstNode>(convert_astnodekind(c.kind()));
+  auto ret = make<UnexposedAstNode>(convert_astnodekind(c.kind()));
 
   localize(ret, c);
 
@@ -509,14 +744,19 @@ void LibClangParser::visit_tu(const ClangCursor& cursor)
 
   auto cursor_file = getCursorFile(cursor);
 
+  if (m_skipped_cxfile && clang_File_isEqual(m_skipped_cxfile, cursor_file))
+    return;
+
   if (!clang_File_isEqual(m_current_cxfile, cursor_file))
   {
     // We have reached another file, let's see if it has already been parsed
     auto file = getFile(getCursorFilePath(cursor));
 
-    if (m_parsed_files.find(file) != m_parsed_files.end())
+    if (m_parsed_files.find(file) != m_parsed_files.end() || !claim(cursor_file))
     {
-      // The file has already been parsed, we skip until we reach a non-parsed file
+      // The file has already been parsed, by this parser or another one, 
+      // we skip until we reach a non-parsed file
+      m_skipped_cxfile = cursor_file;
       return;
     }
 
@@ -525,8 +765,15 @@ void LibClangParser::visit_tu(const ClangCursor& cursor)
     m_current_cxfile = cursor_file;
     m_current_file = file;
 
+    // the nodes of a file are allocated in the same arena, whatever the 
+    // translation unit they come from
+    if (arena_allocation && !m_current_file->arena)
+      m_current_file->arena = std::make_shared<Arena>();
+
+    m_arena = arena_allocation ? m_current_file->arena : nullptr;
+
     if (m_current_file->ast == nullptr)
-      m_current_file->ast = std::make_shared<AstRootNode>();
+      m_current_file->ast = make<AstRootNode>();
 
     assert(m_ast_stack.size() <= 1);
     m_ast_stack.clear();
@@ -541,7 +788,7 @@ void LibClangParser::visit_namespace(const ClangCursor& cursor)
   std::string name = cursor.getSpelling();
   auto entity = static_cast<Namespace*>(m_program_stack.back().get())->getOrCreateNamespace(name);
 
-  auto decl = std::make_shared<NamespaceDeclaration>(entity);
+  auto decl = make<NamespaceDeclaration>(entity);
   localizeParentize(decl, cursor);
   astWrite(decl);
   
@@ -555,34 +802,103 @@ void LibClangParser::visit_namespace(const ClangCursor& cursor)
   }
 }
 
+// Returns the class of that name in 'scope', a namespace or a class,
+// creating it if there is none.
+std::shared_ptr<Class> LibClangParser::getOrCreateClass(INode& scope, std::string name, bool is_template, AccessSpecifier access)
+{
+  if (scope.is<Namespace>())
+  {
+    auto& ns = static_cast<Namespace&>(scope);
+
+    if (is_template)
+      return ns.getOrCreate<ClassTemplate>(name, std::vector<std::shared_ptr<TemplateParameter>>(), std::move(name));
+    else
+      return ns.getOrCreate<Class>(name, std::move(name));
+  }
+
+  Class& cla = static_cast<Class&>(scope);
+
+  // a member class declared before, or kept by reparse()
+  for (const std::shared_ptr<IEntity>& m : cla.members)
+  {
+    if (m->is<Class>() && m->is<ClassTemplate>() == is_template && m->name == name)
+      return std::static_pointer_cast<Class>(m);
+  }
+
+  std::shared_ptr<Class> result = !is_template ? (make<Class>(std::move(name), cla.shared_from_this())) :
+    (make<ClassTemplate>(std::vector<std::shared_ptr<TemplateParameter>>(), std::move(name), cla.shared_from_this()));
+  result->setAccessSpecifier(access);
+  cla.members.push_back(result);
+  return result;
+}
+
+// Returns the namespace or class that 'cursor' designates.
+// A class this parser has not seen, because its file was skipped (see 
+// file_registry), is created with its enclosing scopes so that its 
+// members defined outside of it have a place in the program.
+std::shared_ptr<IEntity> LibClangParser::getScope(const ClangCursor& cursor)
+{
+  switch (cursor.kind())
+  {
+  case CXCursor_TranslationUnit:
+    return m_program->globalNamespace();
+  case CXCursor_Namespace:
+  {
+    std::shared_ptr<IEntity> parent = getScope(cursor.getSemanticParent());
+
+    if (!parent || !parent->is<Namespace>())
+      return nullptr;
+
+    return static_cast<Namespace&>(*parent).getOrCreateNamespace(cursor.getSpelling());
+  }
+  case CXCursor_ClassDecl:
+  case CXCursor_StructDecl:
+  case CXCursor_ClassTemplate:
+  {
+    std::string usr = cursor.getUSR();
+    auto it = m_class_map.find(usr);
+
+    if (it != m_class_map.end() && !it->second.expired())
+      return it->second.lock();
+
+    std::shared_ptr<IEntity> parent = getScope(cursor.getSemanticParent());
+
+    if (!parent)
+      return nullptr;
+
+    std::shared_ptr<Class> result = getOrCreateClass(*parent, cursor.getSpelling(), cursor.kind() == CXCursor_ClassTemplate, getAccessSpecifier(cursor.getCXXAccessSpecifier()));
+    m_class_map[std::move(usr)] = result;
+    return result;
+  }
+  default:
+    return nullptr;
+  }
+}
+
+// Returns false if the declarations of 'file' are converted by another 
+// parser sharing the file registry, or by this parser into another program.
+bool LibClangParser::claim(CXFile file)
+{
+  CXFileUniqueID id;
+
+  if (!file_registry || clang_getFileUniqueID(file, &id) != 0)
+    return true;
+
+  if (m_registry_owner == 0)
+    m_registry_owner = ClangFileRegistry::newOwner();
+
+  return file_registry->claim(id, m_registry_owner);
+}
+
 void LibClangParser::visit_class(const ClangCursor& cursor)
 {
   std::string name = cursor.getSpelling();
 
   const bool is_template = cursor.kind() == CXCursor_ClassTemplate;
 
-  auto entity = [&]() -> std::shared_ptr<Class> {
-    if (curNode().is<Namespace>())
-    {
-      auto& ns = static_cast<Namespace&>(curNode());
-
-      if (is_template)
-        return ns.getOrCreate<ClassTemplate>(name, std::vector<std::shared_ptr<TemplateParameter>>(), std::move(name));
-      else
-        return ns.getOrCreate<Class>(name, std::move(name));
-    }
-    else
-    {
-      Class& cla = static_cast<Class&>(curNode());
-      std::shared_ptr<Class> result = !is_template ? (std::make_shared<Class>(std::move(name), cla.shared_from_this())) :
-        (std::make_shared<ClassTemplate>(std::vector<std::shared_ptr<TemplateParameter>>(), std::move(name), cla.shared_from_this()));
-      result->setAccessSpecifier(m_access_specifier);
-      cla.members.push_back(result);
-      return result;
-    }
-  }();
+  std::shared_ptr<Class> entity = getOrCreateClass(curNode(), std::move(name), is_template, m_access_specifier);
 
-  auto decl = std::make_shared<ClassDeclaration>(entity);
+  auto decl = make<ClassDeclaration>(entity);
   localizeParentize(decl, cursor);
   astWrite(decl);
 
@@ -593,7 +909,7 @@ void LibClangParser::visit_class(const ClangCursor& cursor)
 
   bind(decl, entity);
 
-  m_cursor_entity_map[cursor] = entity;
+  m_class_map[cursor.getUSR()] = entity;
 
   cxx::AccessSpecifier default_access = [&]() {
     if (clang_getCursorKind(cursor) == CXCursor_StructDecl)
@@ -623,14 +939,14 @@ void LibClangParser::visit_enum(const ClangCursor& cursor)
       return static_cast<Namespace&>(curNode()).createEnum(name);
 
     Class& cla = static_cast<Class&>(curNode());
-    auto result = std::make_shared<Enum>(std::move(name), cla.shared_from_this());
+    auto result = make<Enum>(std::move(name), cla.shared_from_this());
     result->enum_class = clang_EnumDecl_isScoped(cursor);
     result->setAccessSpecifier(m_access_specifier);
     cla.members.push_back(result);
     return result;
   }();
 
-  auto decl = std::make_shared<EnumDeclaration>(entity);
+  auto decl = make<EnumDeclaration>(entity);
   localizeParentize(decl, cursor);
   astWrite(decl);
 
@@ -651,86 +967,16 @@ void LibClangParser::visit_enumconstant(const ClangCursor& cursor)
   std::string n = cursor.getSpelling();
 
   auto& en = static_cast<Enum&>(curNode());
-  auto val = std::make_shared<EnumValue>(std::move(n), std::static_pointer_cast<cxx::Enum>(en.shared_from_this()));
+  auto val = make<EnumValue>(std::move(n), std::static_pointer_cast<cxx::Enum>(en.shared_from_this()));
   en.values.push_back(val);
 
-  auto decl = std::make_shared<EnumeratorDeclaration>(val);
+  auto decl = make<EnumeratorDeclaration>(val);
   localizeParentize(decl, cursor);
   astWrite(decl);
 
   bind(decl, val);
 }
 
-static bool are_equiv_param(const cxx::FunctionParameter& a, const cxx::FunctionParameter& b)
-{
-  return a.type == b.type;
-}
-
-static bool are_equiv_func(const cxx::Function& a, const cxx::Function& b)
-{
-  if (a.name != b.name)
-    return false;
-
-  if (a.parameters.size() != b.parameters.size())
-    return false;
-
-  if (a.return_type != b.return_type)
-    return false;
-
-  for (size_t i(0); i < a.parameters.size(); ++i)
-  {
-    if (!are_equiv_param(*a.parameters.at(i), *b.parameters.at(i)))
-      return false;
-  }
-
-  return true;
-}
-
-static std::shared_ptr<cxx::Function> find_equiv_func(cxx::INode& current_node, const cxx::Function& func)
-{
-  if (current_node.is<cxx::Class>())
-  {
-    for (const auto& m : static_cast<cxx::Class&>(current_node).members)
-    {
-      if (m->is<cxx::Function>())
-      {
-        if (are_equiv_func(static_cast<cxx::Function&>(*m), func))
-          return std::static_pointer_cast<cxx::Function>(m);
-      }
-    }
-  }
-  else if(current_node.is<cxx::Namespace>())
-  { 
-    for (const auto& m : static_cast<cxx::Namespace&>(current_node).entities)
-    {
-      if (m->is<cxx::Function>())
-      {
-        if (are_equiv_func(static_cast<cxx::Function&>(*m), func))
-          return std::static_pointer_cast<cxx::Function>(m);
-      }
-    }
-  }
-
-  return nullptr;
-}
-
-static void update_func(cxx::Function& func, const cxx::Function& new_one)
-{
-  for (size_t i(0); i < func.parameters.size(); ++i)
-  {
-    if (func.parameters.at(i)->default_value == cxx::Expression())
-    {
-      if (new_one.parameters.at(i)->default_value != cxx::Expression())
-        func.parameters.at(i)->default_value = new_one.parameters.at(i)->default_value;
-    }
-  }
-
-  if (func.body.isNull() && !new_one.body.isNull())
-  {
-    func.body = new_one.body;
-  }
-}
-
 void LibClangParser::visit_function(const ClangCursor& cursor)
 {
   // Tricky:
@@ -738,7 +984,7 @@ void LibClangParser::visit_function(const ClangCursor& cursor)
   // We must create the Function nonetheless, even without the body.
   // Further declarations may provide the body or additional default parameters.
 
-  auto decl = std::make_shared<FunctionDeclaration>();
+  auto decl = make<FunctionDeclaration>();
   localizeParentize(decl, cursor);
   astWrite(decl);
 
@@ -777,13 +1023,7 @@ void LibClangParser::visit_function(const ClangCursor& cursor)
   auto semantic_parent = [&]() -> std::shared_ptr<cxx::INode> {
     if (is_member)
     {
-      ClangCursor parent = cursor.getSemanticParent();
-      auto it = m_cursor_entity_map.find(parent);
-
-      if (it == m_cursor_entity_map.end())
-        return nullptr;
-
-      return it->second;
+      return getScope(cursor.getSemanticParent());
     }
     else
     {
@@ -828,7 +1068,7 @@ void LibClangParser::visit_function(const ClangCursor& cursor)
 
 void LibClangParser::visit_vardecl(const ClangCursor& cursor)
 {
-  auto decl = std::make_shared<VariableDeclaration>();
+  auto decl = make<VariableDeclaration>();
   localizeParentize(decl, cursor);
   astWrite(decl);
 
@@ -879,7 +1119,7 @@ void LibClangParser::visit_fielddecl(const ClangCursor& cursor)
 {
   assert(curNode().is<cxx::Class>());
 
-  auto decl = std::make_shared<VariableDeclaration>();
+  auto decl = make<VariableDeclaration>();
   localizeParentize(decl, cursor);
   astWrite(decl);
 
@@ -922,7 +1162,7 @@ void LibClangParser::visit_template_type_parameter(const ClangCursor& cursor)
   if (!curNode().is<ClassTemplate>())
     throw std::runtime_error{ "Not implemented" };
 
-  auto decl = std::make_shared<TemplateParameterDeclaration>();
+  auto decl = make<TemplateParameterDeclaration>();
   localizeParentize(decl, cursor);
   astWrite(decl);
 
@@ -930,7 +1170,7 @@ void LibClangParser::visit_template_type_parameter(const ClangCursor& cursor)
 
   ClassTemplate& ct = static_cast<ClassTemplate&>(curNode());
 
-  auto ttparam = std::make_shared<TemplateParameter>(cursor.getSpelling());
+  auto ttparam = make<TemplateParameter>(cursor.getSpelling());
   ttparam->weak_parent = ct.shared_from_this();
   ct.template_parameters.push_back(ttparam);
 
@@ -958,7 +1198,7 @@ std::shared_ptr<cxx::Variable> LibClangParser::parseVariable(const ClangCursor&
   Type type = parseType(cursor.getType());
 
   auto parent = std::static_pointer_cast<cxx::IEntity>(curNode().shared_from_this());
-  auto var = std::make_shared<Variable>(type, std::move(name), parent);
+  auto var = make<Variable>(type, std::move(name), parent);
 
   if (cursor.childCount() == 1)
     var->defaultValue() = parseExpression(cursor.childAt(0));
@@ -968,7 +1208,7 @@ std::shared_ptr<cxx::Variable> LibClangParser::parseVariable(const ClangCursor&
 
 std::shared_ptr<cxx::Function> LibClangParser::parseFunction(const ClangCursor& cursor)
 {
-  auto func = std::make_shared<cxx::Function>(getCursorSpelling(cursor), std::dynamic_pointer_cast<cxx::IEntity>(m_program_stack.back()));
+  auto func = make<cxx::Function>(getCursorSpelling(cursor), std::dynamic_pointer_cast<cxx::IEntity>(m_program_stack.back()));
 
   RAIIVectorSharedGuard<cxx::INode> guard{ m_program_stack, func };
 
@@ -1043,7 +1283,7 @@ void LibClangParser::parseFunctionArgument(cxx::Function& func, CXCursor cursor)
   Type t = parseType(clang_getCursorType(cursor));
   std::string name = getCursorSpelling(cursor);
 
-  auto param = std::make_shared<cxx::FunctionParameter>(t, std::move(name), std::static_pointer_cast<cxx::Function>(func.shared_from_this()));
+  auto param = make<cxx::FunctionParameter>(t, std::move(name), std::static_pointer_cast<cxx::Function>(func.shared_from_this()));
 
   // Parse default-argument
   {
@@ -1130,7 +1370,7 @@ Statement LibClangParser::parseStatement(const ClangCursor& c)
 
 Statement LibClangParser::parseFunctionBody(std::shared_ptr<cxx::Function> f, const ClangCursor& c)
 {
-  auto astnode = std::make_shared<FunctionBody>(f);
+  auto astnode = make<FunctionBody>(f);
   localizeParentize(astnode, c);
   astWrite(astnode);
 
@@ -1145,21 +1385,21 @@ Statement LibClangParser::parseFunctionBody(std::shared_ptr<cxx::Function> f, co
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseNullStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<NullStatement>();
+  auto result = make<NullStatement>();
   localizeParentize(result, c);
   return result;
 }
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseBreakStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<BreakStatement>();
+  auto result = make<BreakStatement>();
   localizeParentize(result, c);
   return result;
 }
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseCaseStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<CaseStatement>();
+  auto result = make<CaseStatement>();
 
   localizeParentize(result, c);
 
@@ -1179,7 +1419,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseCaseStatement(const ClangC
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseCatchStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<CatchStatement>();
+  auto result = make<CatchStatement>();
 
   localizeParentize(result, c);
 
@@ -1199,14 +1439,14 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseCatchStatement(const Clang
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseContinueStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<ContinueStatement>();
+  auto result = make<ContinueStatement>();
   localizeParentize(result, c);
   return result;
 }
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseCompoundStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<CompoundStatement>();
+  auto result = make<CompoundStatement>();
   localizeParentize(result, c);
 
   RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, result };
@@ -1220,7 +1460,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseCompoundStatement(const Cl
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseDefaultStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<DefaultStatement>();
+  auto result = make<DefaultStatement>();
   localizeParentize(result, c);
 
   RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, result };
@@ -1236,7 +1476,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseDefaultStatement(const Cla
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseDoWhileLoop(const ClangCursor& c)
 {
-  auto result = std::make_shared<DoWhileLoop>();
+  auto result = make<DoWhileLoop>();
 
   localizeParentize(result, c);
 
@@ -1260,7 +1500,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseDoWhileLoop(const ClangCur
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseIf(const ClangCursor& c)
 {
-  auto result = std::make_shared<IfStatement>();
+  auto result = make<IfStatement>();
 
   localizeParentize(result, c);
 
@@ -1304,7 +1544,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseIf(const ClangCursor& c)
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseForLoop(const ClangCursor& c)
 {
-  auto result = std::make_shared<ForLoop>();
+  auto result = make<ForLoop>();
   localizeParentize(result, c);
 
   RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, result };
@@ -1348,7 +1588,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseForLoop(const ClangCursor&
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseForRange(const ClangCursor& c)
 {
-  auto result = std::make_shared<ForRange>();
+  auto result = make<ForRange>();
   localizeParentize(result, c);
 
   RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, result };
@@ -1386,7 +1626,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseForRange(const ClangCursor
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseReturnStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<ReturnStatement>();
+  auto result = make<ReturnStatement>();
 
   localizeParentize(result, c);
 
@@ -1399,7 +1639,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseReturnStatement(const Clan
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseSwitchStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<SwitchStatement>();
+  auto result = make<SwitchStatement>();
 
   localizeParentize(result, c);
 
@@ -1432,7 +1672,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseSwitchStatement(const Clan
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseTryBlock(const ClangCursor& c)
 {
-  auto result = std::make_shared<TryBlock>();
+  auto result = make<TryBlock>();
 
   localizeParentize(result, c);
 
@@ -1457,7 +1697,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseTryBlock(const ClangCursor
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseWhile(const ClangCursor& c)
 {
-  auto result = std::make_shared<WhileLoop>();
+  auto result = make<WhileLoop>();
 
   localizeParentize(result, c);
 
@@ -1494,7 +1734,7 @@ std::shared_ptr<cxx::IStatement> LibClangParser::parseWhile(const ClangCursor& c
 
 std::shared_ptr<cxx::IStatement> LibClangParser::parseUnexposedStatement(const ClangCursor& c)
 {
-  auto result = std::make_shared<UnexposedStatement>(convert_astnodekind(c.kind()));
+  auto result = make<UnexposedStatement>(convert_astnodekind(c.kind()));
  
   localizeParentize(result, c);
 
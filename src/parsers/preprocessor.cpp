@@ -0,0 +1,795 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/preprocessor.h"
+
+#include "cxx/file.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+static bool is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static bool is_identifier_char(char c)
+{
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+static std::string trim(const std::string& str)
+{
+  size_t first = 0;
+  size_t last = str.size();
+
+  while (first < last && is_blank(str[first]))
+    ++first;
+
+  while (last > first && is_blank(str[last - 1]))
+    --last;
+
+  return str.substr(first, last - first);
+}
+
+static std::string read_identifier(const std::string& str, size_t& pos)
+{
+  while (pos < str.size() && is_blank(str[pos]))
+    ++pos;
+
+  const size_t start = pos;
+
+  while (pos < str.size() && is_identifier_char(str[pos]))
+    ++pos;
+
+  return str.substr(start, pos - start);
+}
+
+namespace
+{
+
+// Evaluates the controlling expression of a #if or #elif.
+// Identifiers that are not macros and calls to function-like macros
+// evaluate to 0, as do macros whose value is not an expression.
+class ExpressionEvaluator
+{
+public:
+  static const int max_depth = 32;
+
+  ExpressionEvaluator(const Preprocessor& pp, const std::string& expr, int depth)
+    : m_pp(pp),
+      m_it(expr.data()),
+      m_end(expr.data() + expr.size()),
+      m_depth(depth)
+  {
+
+  }
+
+  long long run()
+  {
+    long long result = conditional();
+
+    skipBlanks();
+
+    if (m_it != m_end)
+      error();
+
+    return result;
+  }
+
+private:
+  struct BinaryOperator
+  {
+    const char* text;
+    int precedence;
+  };
+
+  [[noreturn]] void error()
+  {
+    throw std::runtime_error{ "Preprocessor : invalid expression" };
+  }
+
+  void skipBlanks()
+  {
+    while (m_it != m_end && is_blank(*m_it))
+      ++m_it;
+  }
+
+  void expect(char c)
+  {
+    skipBlanks();
+
+    if (m_it == m_end || *m_it != c)
+      error();
+
+    ++m_it;
+  }
+
+  long long conditional()
+  {
+    const long long cond = binary(1);
+
+    skipBlanks();
+
+    if (m_it == m_end || *m_it != '?')
+      return cond;
+
+    ++m_it;
+
+    const long long lhs = conditional();
+    expect(':');
+    const long long rhs = conditional();
+
+    return cond ? lhs : rhs;
+  }
+
+  const BinaryOperator* peekOperator() const
+  {
+    static const BinaryOperator operators[] = {
+      { "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 }, { ">=", 7 }, { "<<", 8 }, { ">>", 8 },
+      { "|", 3 }, { "^", 4 }, { "&", 5 }, { "<", 7 }, { ">", 7 }, { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 },
+    };
+
+    for (const BinaryOperator& op : operators)
+    {
+      const size_t n = std::strlen(op.text);
+
+      if (static_cast<size_t>(m_end - m_it) >= n && std::strncmp(m_it, op.text, n) == 0)
+        return &op;
+    }
+
+    return nullptr;
+  }
+
+  static long long negate(long long value)
+  {
+    return static_cast<long long>(0 - static_cast<unsigned long long>(value));
+  }
+
+  static long long apply(const char* op, long long lhs, long long rhs)
+  {
+    const int shift = static_cast<int>(rhs < 0 ? 0 : (rhs > 63 ? 63 : rhs));
+
+    switch (op[0])
+    {
+    case '|': return op[1] == '|' ? (lhs || rhs) : (lhs | rhs);
+    case '&': return op[1] == '&' ? (lhs && rhs) : (lhs & rhs);
+    case '^': return lhs ^ rhs;
+    case '=': return lhs == rhs;
+    case '!': return lhs != rhs;
+    case '<': return op[1] == '<' ? static_cast<long long>(static_cast<unsigned long long>(lhs) << shift) : (op[1] == '=' ? lhs <= rhs : lhs < rhs);
+    case '>': return op[1] == '>' ? (lhs >> shift) : (op[1] == '=' ? lhs >= rhs : lhs > rhs);
+    case '+': return static_cast<long long>(static_cast<unsigned long long>(lhs) + static_cast<unsigned long long>(rhs));
+    case '-': return static_cast<long long>(static_cast<unsigned long long>(lhs) - static_cast<unsigned long long>(rhs));
+    case '*': return static_cast<long long>(static_cast<unsigned long long>(lhs) * static_cast<unsigned long long>(rhs));
+    // LLONG_MIN / -1 overflows (and traps on x86): the result wraps, as with the other operators
+    case '/': return rhs == 0 ? 0 : (rhs == -1 ? negate(lhs) : lhs / rhs);
+    case '%': return rhs == 0 || rhs == -1 ? 0 : lhs % rhs;
+    default: return 0;
+    }
+  }
+
+  long long binary(int min_precedence)
+  {
+    long long lhs = unary();
+
+    for (;;)
+    {
+      skipBlanks();
+
+      const BinaryOperator* op = peekOperator();
+
+      if (!op || op->precedence < min_precedence)
+        return lhs;
+
+      m_it += std::strlen(op->text);
+
+      const long long rhs = binary(op->precedence + 1);
+      lhs = apply(op->text, lhs, rhs);
+    }
+  }
+
+  long long unary()
+  {
+    skipBlanks();
+
+    if (m_it == m_end)
+      error();
+
+    const char c = *m_it;
+
+    switch (c)
+    {
+    case '!':
+      ++m_it;
+      return !unary();
+    case '~':
+      ++m_it;
+      return ~unary();
+    case '-':
+      ++m_it;
+      return negate(unary());
+    case '+':
+      ++m_it;
+      return unary();
+    case '(':
+    {
+      ++m_it;
+      const long long result = conditional();
+      expect(')');
+      return result;
+    }
+    case '\'':
+      return character();
+    default:
+      break;
+    }
+
+    if (std::isdigit(static_cast<unsigned char>(c)))
+      return number();
+    else if (is_identifier_char(c))
+      return identifier();
+
+    error();
+  }
+
+  static int digit_value(char c)
+  {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    else if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+
+  long long number()
+  {
+    std::string digits;
+
+    while (m_it != m_end && (is_identifier_char(*m_it) || *m_it == '\''))
+    {
+      if (*m_it != '\'')
+        digits.push_back(*m_it);
+      ++m_it;
+    }
+
+    unsigned long long base = 10;
+    size_t i = 0;
+
+    if (digits.size() > 1 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X'))
+      base = 16, i = 2;
+    else if (digits.size() > 1 && digits[0] == '0' && (digits[1] == 'b' || digits[1] == 'B'))
+      base = 2, i = 2;
+    else if (digits[0] == '0')
+      base = 8;
+
+    unsigned long long value = 0;
+
+    for (; i < digits.size(); ++i)
+    {
+      const int d = digit_value(digits[i]);
+
+      if (d < 0 || static_cast<unsigned long long>(d) >= base)
+        break;
+
+      value = value * base + d;
+    }
+
+    for (; i < digits.size(); ++i)
+    {
+      if (std::strchr("uUlL", digits[i]) == nullptr)
+        error();
+    }
+
+    return static_cast<long long>(value);
+  }
+
+  long long character()
+  {
+    ++m_it;
+
+    if (m_it == m_end)
+      error();
+
+    char c = *(m_it++);
+
+    if (c == '\\')
+    {
+      if (m_it == m_end)
+        error();
+
+      switch (*(m_it++))
+      {
+      case 'n': c = '\n'; break;
+      case 't': c = '\t'; break;
+      case 'r': c = '\r'; break;
+      case '0': c = '\0'; break;
+      default: c = *(m_it - 1); break;
+      }
+    }
+
+    if (m_it == m_end || *m_it != '\'')
+      error();
+
+    ++m_it;
+    return c;
+  }
+
+  void skipArguments()
+  {
+    int depth = 0;
+
+    do
+    {
+      if (m_it == m_end)
+        error();
+
+      if (*m_it == '(')
+        ++depth;
+      else if (*m_it == ')')
+        --depth;
+
+      ++m_it;
+    } while (depth > 0);
+  }
+
+  long long identifier()
+  {
+    const char* start = m_it;
+
+    while (m_it != m_end && is_identifier_char(*m_it))
+      ++m_it;
+
+    const std::string name{ start, m_it };
+
+    if (name == "defined")
+    {
+      skipBlanks();
+
+      const bool par = m_it != m_end && *m_it == '(';
+
+      if (par)
+        ++m_it;
+
+      skipBlanks();
+
+      start = m_it;
+
+      while (m_it != m_end && is_identifier_char(*m_it))
+        ++m_it;
+
+      if (start == m_it)
+        error();
+
+      const bool result = m_pp.isDefined(std::string(start, m_it));
+
+      if (par)
+        expect(')');
+
+      return result;
+    }
+    else if (name == "true")
+    {
+      return 1;
+    }
+    else if (name == "false")
+    {
+      return 0;
+    }
+
+    skipBlanks();
+
+    if (m_it != m_end && *m_it == '(')
+    {
+      skipArguments();
+      return 0;
+    }
+
+    auto it = m_pp.macros.find(name);
+
+    if (it == m_pp.macros.end() || m_depth >= max_depth || trim(it->second).empty())
+      return 0;
+
+    try
+    {
+      return ExpressionEvaluator(m_pp, it->second, m_depth + 1).run();
+    }
+    catch (const std::runtime_error&)
+    {
+      return 0;
+    }
+  }
+
+private:
+  const Preprocessor& m_pp;
+  const char* m_it;
+  const char* m_end;
+  int m_depth;
+};
+
+} // namespace
+
+// Resolves '.' and '..' components so that a file has a single path.
+static std::string normalize_path(std::string path)
+{
+  File::normalizePath(path);
+
+  std::vector<std::string> parts;
+  size_t start = 0;
+
+  while (start <= path.size())
+  {
+    size_t slash = path.find('/', start);
+
+    if (slash == std::string::npos)
+      slash = path.size();
+
+    std::string part = path.substr(start, slash - start);
+
+    if (part == ".." && !parts.empty() && !parts.back().empty() && parts.back() != "..")
+      parts.pop_back();
+    else if (part != "." && (part != "" || parts.empty()))
+      parts.push_back(std::move(part));
+
+    start = slash + 1;
+  }
+
+  std::string result;
+
+  for (size_t i(0); i < parts.size(); ++i)
+  {
+    if (i > 0)
+      result += "/";
+
+    result += parts.at(i);
+  }
+
+  return result;
+}
+
+static bool file_exists(const std::string& path)
+{
+  std::ifstream file{ path };
+  return file.is_open();
+}
+
+// Reads a directive up to the end of its line, 'it' pointing just after the '#'.
+// Continued lines are joined and comments are replaced by a space.
+static const char* read_directive(const char* it, const char* end, std::string& text)
+{
+  while (it != end && *it != '\n')
+  {
+    const char c = *it;
+
+    if (c == '\\' && end - it >= 2 && (it[1] == '\n' || (it[1] == '\r' && end - it >= 3 && it[2] == '\n')))
+    {
+      it += it[1] == '\n' ? 2 : 3;
+      text.push_back(' ');
+    }
+    else if (c == '/' && end - it >= 2 && it[1] == '/')
+    {
+      while (it != end && *it != '\n')
+        ++it;
+    }
+    else if (c == '/' && end - it >= 2 && it[1] == '*')
+    {
+      it += 2;
+
+      while (it != end && !(*it == '*' && end - it >= 2 && it[1] == '/'))
+        ++it;
+
+      it = it == end ? end : it + 2;
+      text.push_back(' ');
+    }
+    else if (c == '"' || c == '\'')
+    {
+      text.push_back(*(it++));
+
+      while (it != end && *it != c && *it != '\n')
+      {
+        if (*it == '\\' && end - it >= 2)
+          text.push_back(*(it++));
+
+        text.push_back(*(it++));
+      }
+
+      if (it != end && *it == c)
+        text.push_back(*(it++));
+    }
+    else
+    {
+      text.push_back(*(it++));
+    }
+  }
+
+  return it == end ? end : it + 1;
+}
+
+bool Preprocessor::hasDirectives(StringView source)
+{
+  return std::memchr(source.data(), '#', source.size()) != nullptr;
+}
+
+// Returns the ranges [begin, end) of 'source' that remain once the directives
+// and the inactive blocks are removed.
+// Included files are processed, through the include handler, when their
+// #include is reached so that the macros they define are visible afterwards.
+std::vector<std::pair<size_t, size_t>> Preprocessor::process(const std::string& filepath, StringView source)
+{
+  struct Condition
+  {
+    bool parent_active;
+    bool taken;
+    bool active;
+    bool seen_else;
+  };
+
+  const std::string path = normalize_path(filepath);
+
+  std::vector<std::pair<size_t, size_t>> result;
+  std::vector<Condition> conditions;
+
+  const char* const begin = source.data();
+  const char* const end = begin + source.size();
+  const char* it = begin;
+  const char* active_begin = begin;
+  bool active = true;
+  bool line_start = true;
+
+  // the include guard is a #ifndef that encloses everything else
+  std::string guard;
+  bool outside_guard = false;
+
+  while (it != end)
+  {
+    if (line_start)
+    {
+      line_start = false;
+
+      const char* line = it;
+
+      while (it != end && is_blank(*it))
+        ++it;
+
+      if (it == end || *it != '#')
+        continue;
+
+      std::string text;
+      const char* next = read_directive(it + 1, end, text);
+
+      if (active && line != active_begin)
+        result.emplace_back(active_begin - begin, line - begin);
+
+      size_t pos = 0;
+      const std::string name = read_identifier(text, pos);
+      const std::string rest = trim(text.substr(pos));
+
+      if (conditions.empty())
+      {
+        if (name == "ifndef" && guard.empty() && !outside_guard)
+        {
+          size_t p = 0;
+          guard = read_identifier(rest, p);
+        }
+        else
+        {
+          outside_guard = true;
+        }
+      }
+      else if (conditions.size() == 1 && (name == "else" || name == "elif"))
+      {
+        outside_guard = true;
+      }
+
+      if (name == "if" || name == "ifdef" || name == "ifndef")
+      {
+        bool value = false;
+
+        if (active)
+        {
+          if (name == "if")
+          {
+            value = evaluate(rest) != 0;
+          }
+          else
+          {
+            size_t p = 0;
+            value = isDefined(read_identifier(rest, p)) == (name == "ifdef");
+          }
+        }
+
+        conditions.push_back(Condition{ active, value, value, false });
+      }
+      else if (name == "elif" || name == "else")
+      {
+        if (conditions.empty() || conditions.back().seen_else)
+          throw std::runtime_error{ "Preprocessor : unexpected #" + name };
+
+        Condition& cond = conditions.back();
+
+        cond.active = cond.parent_active && !cond.taken && (name == "else" || evaluate(rest) != 0);
+        cond.taken = cond.taken || cond.active;
+        cond.seen_else = name == "else";
+      }
+      else if (name == "endif")
+      {
+        if (conditions.empty())
+          throw std::runtime_error{ "Preprocessor : unexpected #endif" };
+
+        conditions.pop_back();
+      }
+      else if (active && name == "define")
+      {
+        size_t p = 0;
+        const std::string macro = read_identifier(rest, p);
+
+        if (!macro.empty())
+          macros[macro] = trim(rest.substr(p));
+      }
+      else if (active && name == "undef")
+      {
+        size_t p = 0;
+        macros.erase(read_identifier(rest, p));
+      }
+      else if (active && name == "pragma")
+      {
+        if (rest == "once")
+          m_once.insert(path);
+      }
+      else if (active && name == "include")
+      {
+        const char close = rest.empty() ? '\0' : (rest.front() == '<' ? '>' : (rest.front() == '"' ? '"' : '\0'));
+        const size_t last = close ? rest.find(close, 1) : std::string::npos;
+
+        if (last != std::string::npos)
+        {
+          const std::string included = resolveInclude(rest.substr(1, last - 1), close == '>', path);
+
+          if (!included.empty())
+            include(included);
+        }
+      }
+
+      active = conditions.empty() || conditions.back().active;
+      active_begin = next;
+      it = next;
+      line_start = true;
+      continue;
+    }
+
+    const char c = *it;
+
+    if (c == '\n')
+    {
+      line_start = true;
+      ++it;
+    }
+    else if (c == '/' && end - it >= 2 && it[1] == '/')
+    {
+      while (it != end && *it != '\n')
+        ++it;
+    }
+    else if (c == '/' && end - it >= 2 && it[1] == '*')
+    {
+      it += 2;
+
+      while (it != end && !(*it == '*' && end - it >= 2 && it[1] == '/'))
+        ++it;
+
+      it = it == end ? end : it + 2;
+    }
+    else
+    {
+      if (!is_blank(c) && conditions.empty())
+        outside_guard = true;
+
+      if (active && (c == '"' || (c == '\'' && (it == begin || !is_identifier_char(it[-1])))))
+      {
+        ++it;
+
+        while (it != end && *it != c && *it != '\n')
+          it += (*it == '\\' && end - it >= 2) ? 2 : 1;
+
+        if (it != end && *it == c)
+          ++it;
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+
+  if (!conditions.empty())
+    throw std::runtime_error{ "Preprocessor : unterminated conditional directive" };
+
+  if (active && active_begin != end)
+    result.emplace_back(active_begin - begin, end - begin);
+
+  if (!guard.empty() && !outside_guard)
+    m_guards[path] = guard;
+
+  return result;
+}
+
+bool Preprocessor::isDefined(const std::string& name) const
+{
+  return macros.find(name) != macros.end();
+}
+
+long long Preprocessor::evaluate(const std::string& expr) const
+{
+  return ExpressionEvaluator(*this, expr, 0).run();
+}
+
+// Quoted includes are searched next to the including file first.
+// Returns an empty string if the file is not found.
+std::string Preprocessor::resolveInclude(const std::string& name, bool angled, const std::string& includer) const
+{
+  if (!angled && !includer.empty())
+  {
+    const size_t slash = includer.find_last_of('/');
+    const std::string path = normalize_path(slash == std::string::npos ? name : includer.substr(0, slash + 1) + name);
+
+    if (file_exists(path))
+      return path;
+  }
+
+  for (const std::string& dir : includedirs)
+  {
+    const std::string path = normalize_path(dir + "/" + name);
+
+    if (file_exists(path))
+      return path;
+  }
+
+  return {};
+}
+
+// Returns whether including the file again would have no effect.
+bool Preprocessor::isGuarded(const std::string& filepath) const
+{
+  if (m_once.find(filepath) != m_once.end())
+    return true;
+
+  auto it = m_guards.find(filepath);
+  return it != m_guards.end() && isDefined(it->second);
+}
+
+void Preprocessor::include(const std::string& filepath)
+{
+  if (!include_handler || isGuarded(filepath))
+    return;
+
+  if (m_include_depth >= 200)
+    throw std::runtime_error{ "Preprocessor : #include nested too deeply" };
+
+  ++m_include_depth;
+
+  try
+  {
+    include_handler(filepath);
+  }
+  catch (...)
+  {
+    --m_include_depth;
+    throw;
+  }
+
+  --m_include_depth;
+}
+
+} // namespace parsers
+
+} // namespace cxx
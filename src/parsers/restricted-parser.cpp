@@ -4,9 +4,13 @@
 
 #include "cxx/parsers/restricted-parser.h"
 
+#include "cxx/parsers/function-utils.h"
 #include "cxx/parsers/raii-utils.h"
+#include "cxx/parsers/reparse-utils.h"
+#include "cxx/parsers/type-cache.h"
 
 #include "cxx/class.h"
+#include "cxx/expressions.h"
 #include "cxx/filesystem.h"
 #include "cxx/name_p.h"
 #include "cxx/namespace.h"
@@ -15,8 +19,11 @@
 #include "cxx/function-body.h"
 #include "cxx/declarations.h"
 
-#include <fstream>
+#include <algorithm>
+#include <exception>
 #include <map>
+#include <set>
+#include <thread>
 
 namespace cxx
 {
@@ -80,121 +87,276 @@ public:
   }
 };
 
-class ParserParenView : public ParserViewRAII
+static const size_t no_match = static_cast<size_t>(-1);
+
+// Returns the index of the 'close' token that matches an 'open' token
+// located just before 'pos', or no_match.
+static size_t find_closing(const TokenBuffer& toks, const DelimiterIndex& delims, size_t pos, size_t end, TokenType::Value open, TokenType::Value close)
 {
-public:
+  if (!delims.empty() && pos > 0 && toks.type(pos - 1) == open)
+  {
+    const size_t it = delims.closing(pos - 1);
+    return it < end ? it : no_match;
+  }
 
-  ParserParenView(const std::vector<Token>& toks, std::pair<size_t, size_t>& view, size_t pos)
-    : ParserViewRAII(view)
+  size_t depth = 0;
+
+  for (size_t it = pos; it != end; ++it)
   {
-    size_t par_depth = 0;
+    if (toks.type(it) == close)
+    {
+      if (depth == 0)
+        return it;
 
-    auto begin = toks.begin() + pos;
-    auto end = toks.begin() + view.second;
+      --depth;
+    }
+    else if (toks.type(it) == open)
+    {
+      ++depth;
+    }
+  }
 
-    auto it = begin;
+  return no_match;
+}
 
-    while (it != end)
+// Returns the index of the '>' (or '>>') that closes a template argument
+// list starting at 'pos', or no_match and an error message.
+static size_t find_template_angle_end(const TokenBuffer& toks, const DelimiterIndex& delims, size_t pos, size_t end, bool& right_shift, const char*& error)
+{
+  size_t bracket_depth = 0;
+  size_t paren_depth = 0;
+  size_t angle_depth = 0;
+
+  right_shift = false;
+
+  if (delims.nested() && pos > 0 && toks.type(pos - 1) == TokenType::Less)
+  {
+    const DelimiterIndex::AngleMatch m = delims.angle(pos - 1);
+
+    if (m.status != DelimiterIndex::Unknown && m.index >= end)
+      return error = "no matching angle bracket", no_match;
+
+    switch (m.status)
+    {
+    case DelimiterIndex::Unmatched:
+      return error = "no matching angle bracket", no_match;
+    case DelimiterIndex::Matched:
+      return m.index;
+    case DelimiterIndex::MatchedShift:
+      // unless the '>>' is already split
+      if (toks.type(m.index) == TokenType::RightShift)
+        return right_shift = true, m.index;
+      break;
+    case DelimiterIndex::MatchedNested:
+      // only once the '>>' is split
+      if (toks.type(m.index) == TokenType::GreaterThan)
+        return m.index;
+      break;
+    case DelimiterIndex::UnmatchedParen:
+      return error = "no matching parenthesis", no_match;
+    case DelimiterIndex::UnmatchedBracket:
+      return error = "no matching bracket", no_match;
+    default:
+      break;
+    }
+  }
+
+  for (size_t it = pos; it != end; ++it)
+  {
+    if (toks.type(it) == TokenType::GreaterThan)
     {
-      if (it->type() == TokenType::RightPar)
+      if (bracket_depth == 0 && paren_depth == 0)
       {
-        if (par_depth == 0)
-        {
-          view = std::make_pair(pos, std::distance(toks.begin(), it));
-          return;
-        }
-        else
+        if (angle_depth == 0)
+          return it;
+
+        --angle_depth;
+      }
+    }
+    else if (toks.type(it) == TokenType::RightShift)
+    {
+      if (bracket_depth == 0 && paren_depth == 0)
+      {
+        if (angle_depth == 1)
         {
-          --par_depth;
+          right_shift = true;
+          return it;
         }
+
+        angle_depth -= 2;
       }
-      else if (it->type() == TokenType::LeftPar)
+    }
+    else if (toks.type(it) == TokenType::Less)
+    {
+      if (bracket_depth == 0 && paren_depth == 0)
       {
-        ++par_depth;
+        ++angle_depth;
       }
+    }
+    else if (toks.type(it) == TokenType::RightBracket)
+    {
+      if (bracket_depth == 0)
+        return error = "no matching bracket", no_match;
 
-      ++it;
+      --bracket_depth;
+    }
+    else if (toks.type(it) == TokenType::LeftBracket)
+    {
+      ++bracket_depth;
     }
+    else if (toks.type(it) == TokenType::RightPar)
+    {
+      if (paren_depth == 0)
+        return error = "no matching parenthesis", no_match;
 
-    throw RestrictedParserError{ "no matching parenthesis" };
+      --paren_depth;
+    }
+    else if (toks.type(it) == TokenType::LeftPar)
+    {
+      ++paren_depth;
+    }
   }
-};
 
-class ParserBracketView : public ParserViewRAII
+  return error = "no matching angle bracket", no_match;
+}
+
+// Returns the index of the comma that ends the list element starting at
+// 'pos', 'end' if there is none, or no_match and an error message.
+static size_t find_list_end(const TokenBuffer& toks, const DelimiterIndex& delims, size_t pos, size_t end, bool ignore_angle, const char*& error)
 {
-public:
-  ParserBracketView(const std::vector<Token>& toks, std::pair<size_t, size_t>& view, size_t pos)
-    : ParserViewRAII(view)
+  size_t bracket_depth = 0;
+  size_t paren_depth = 0;
+  size_t brace_depth = 0;
+  size_t angle_depth = 0;
+
+  // if the delimiters are properly nested, the content of a parenthesis,
+  // bracket or brace does not matter and can be skipped
+  const bool skip_nested = delims.nested();
+
+  for (size_t it = pos; it != end; ++it)
   {
-    size_t bracket_depth = 0;
+    if (skip_nested && (toks.type(it) == TokenType::LeftPar || toks.type(it) == TokenType::LeftBracket || toks.type(it) == TokenType::LeftBrace))
+    {
+      const size_t closing = delims.closing(it);
 
-    auto begin = toks.begin() + pos;
-    auto end = toks.begin() + view.second;
+      if (closing == DelimiterIndex::npos || closing >= end)
+        return error = "no matching bracket/brace/paren", no_match;
 
-    auto it = begin;
+      it = closing;
+    }
+    else if (toks.type(it) == TokenType::Comma)
+    {
+      if (brace_depth == 0 && paren_depth == 0 && bracket_depth == 0 && angle_depth == 0)
+        return it;
+    }
+    else if (toks.type(it) == TokenType::GreaterThan)
+    {
+      if (!ignore_angle && bracket_depth == 0 && paren_depth == 0 && brace_depth == 0)
+      {
+        if (angle_depth == 0)
+          return error = "no matching angle bracket", no_match;
 
-    while (it != end)
+        --angle_depth;
+      }
+    }
+    else if (toks.type(it) == TokenType::Less)
     {
-      if (it->type() == TokenType::RightBracket)
+      if (!ignore_angle && bracket_depth == 0 && paren_depth == 0 && brace_depth == 0)
       {
-        if (bracket_depth == 0)
-        {
-          view = std::make_pair(pos, std::distance(toks.begin(), it));
-          return;
-        }
-        else
-        {
-          --bracket_depth;
-        }
+        ++angle_depth;
       }
-      else if (it->type() == TokenType::LeftBracket)
+    }
+    else if (toks.type(it) == TokenType::RightShift)
+    {
+      if (!ignore_angle && bracket_depth == 0 && paren_depth == 0 && brace_depth == 0)
       {
-        ++bracket_depth;
+        angle_depth -= 2;
       }
+    }
+    else if (toks.type(it) == TokenType::RightBracket)
+    {
+      if (bracket_depth == 0)
+        return error = "no matching bracket", no_match;
 
-      ++it;
+      --bracket_depth;
+    }
+    else if (toks.type(it) == TokenType::LeftBracket)
+    {
+      ++bracket_depth;
+    }
+    else if (toks.type(it) == TokenType::RightPar)
+    {
+      if (paren_depth == 0)
+        return error = "no matching parenthesis", no_match;
+
+      --paren_depth;
+    }
+    else if (toks.type(it) == TokenType::LeftPar)
+    {
+      ++paren_depth;
     }
+    else if (toks.type(it) == TokenType::RightBrace)
+    {
+      if (brace_depth == 0)
+        return error = "no matching brace", no_match;
+
+      --brace_depth;
+    }
+    else if (toks.type(it) == TokenType::LeftBrace)
+    {
+      ++brace_depth;
+    }
+  }
+
+  if (bracket_depth != 0 || paren_depth != 0 || brace_depth != 0)
+    return error = "no matching bracket/brace/paren", no_match;
+
+  return end;
+}
+
+class ParserParenView : public ParserViewRAII
+{
+public:
+
+  ParserParenView(const TokenBuffer& toks, const DelimiterIndex& delims, std::pair<size_t, size_t>& view, size_t pos)
+    : ParserViewRAII(view)
+  {
+    const size_t it = find_closing(toks, delims, pos, view.second, TokenType::LeftPar, TokenType::RightPar);
 
-    throw RestrictedParserError{ "no matching bracket" };
+    if (it == no_match)
+      throw RestrictedParserError{ "no matching parenthesis" };
+
+    view = std::make_pair(pos, it);
   }
 };
 
-class ParserBraceView : public ParserViewRAII
+class ParserBracketView : public ParserViewRAII
 {
 public:
-  ParserBraceView(const std::vector<Token>& toks, std::pair<size_t, size_t>& view, size_t pos)
+  ParserBracketView(const TokenBuffer& toks, const DelimiterIndex& delims, std::pair<size_t, size_t>& view, size_t pos)
     : ParserViewRAII(view)
   {
-    size_t brace_depth = 0;
+    const size_t it = find_closing(toks, delims, pos, view.second, TokenType::LeftBracket, TokenType::RightBracket);
 
-    auto begin = toks.begin() + pos;
-    auto end = toks.begin() + view.second;
+    if (it == no_match)
+      throw RestrictedParserError{ "no matching bracket" };
 
-    auto it = begin;
+    view = std::make_pair(pos, it);
+  }
+};
 
-    while (it != end)
-    {
-      if (it->type() == TokenType::RightBrace)
-      {
-        if (brace_depth == 0)
-        {
-          view = std::make_pair(pos, std::distance(toks.begin(), it));
-          return;
-        }
-        else
-        {
-          --brace_depth;
-        }
-      }
-      else if (it->type() == TokenType::LeftBrace)
-      {
-        ++brace_depth;
-      }
+class ParserBraceView : public ParserViewRAII
+{
+public:
+  ParserBraceView(const TokenBuffer& toks, const DelimiterIndex& delims, std::pair<size_t, size_t>& view, size_t pos)
+    : ParserViewRAII(view)
+  {
+    const size_t it = find_closing(toks, delims, pos, view.second, TokenType::LeftBrace, TokenType::RightBrace);
 
-      ++it;
-    }
+    if (it == no_match)
+      throw RestrictedParserError{ "no matching brace" };
 
-    throw RestrictedParserError{ "no matching brace" };
+    view = std::make_pair(pos, it);
   }
 };
 
@@ -202,97 +364,40 @@ class TemplateAngleView : public ParserViewRAII
 {
 public:
   bool split_right_shift = false;
-  std::vector<Token>& tokens;
+  TokenBuffer& tokens;
 
 public:
-  TemplateAngleView(std::vector<Token>& toks, std::pair<size_t, size_t>& view, size_t pos)
+  TemplateAngleView(TokenBuffer& toks, const DelimiterIndex& delims, std::pair<size_t, size_t>& view, size_t pos)
     : ParserViewRAII(view),
       tokens(toks)
   {
-    size_t bracket_depth = 0;
-    size_t paren_depth = 0;
-    size_t angle_depth = 0;
+    const char* error = nullptr;
+    const size_t it = find_template_angle_end(toks, delims, pos, view.second, split_right_shift, error);
 
-    auto begin = toks.begin() + pos;
-    auto end = toks.begin() + view.second;
+    if (it == no_match)
+      throw RestrictedParserError{ error };
 
-    auto it = begin;
-
-    while (it != end)
+    if (split_right_shift)
     {
-      if (it->type() == TokenType::GreaterThan)
-      {
-        if (bracket_depth == 0 && paren_depth == 0)
-        {
-          if (angle_depth == 0)
-          {
-            view = std::make_pair(pos, std::distance(toks.begin(), it));
-            return;
-          }
-
-          --angle_depth;
-        }
-      }
-      else if (it->type() == TokenType::RightShift)
-      {
-        if (bracket_depth == 0 && paren_depth == 0)
-        {
-          if (angle_depth == 1)
-          {
-            Token tok = *it;
-            *it = Token(TokenType::RightAngle, StringView(tok.text().data() + 1, 1));
-            it = toks.insert(it, Token(TokenType::RightAngle, StringView(tok.text().data(), 1)));
-            view = std::make_pair(pos, std::distance(toks.begin(), it) + 1);
-            split_right_shift = true;
-            return;
-          }
-
-          angle_depth -= 2;
-        }
-      }
-      else if (it->type() == TokenType::Less)
-      {
-        if (bracket_depth == 0 && paren_depth == 0)
-        {
-          ++angle_depth;
-        }
-      }
-      else if (it->type() == TokenType::RightBracket)
-      {
-        if (bracket_depth == 0)
-          throw RestrictedParserError{ "no matching bracket" };
-
-        --bracket_depth;
-      }
-      else if (it->type() == TokenType::LeftBracket)
-      {
-        ++bracket_depth;
-      }
-      else if (it->type() == TokenType::RightPar)
-      {
-        if (paren_depth == 0)
-          throw RestrictedParserError{ "no matching parenthesis" };
-
-        --paren_depth;
-      }
-      else if (it->type() == TokenType::LeftPar)
-      {
-        ++paren_depth;
-      }
-
-      ++it;
+      // The '>>' becomes the '>' closing the nested list, which is the
+      // last token of the view; the second '>' is implied. 
+      // Splitting in place keeps the indices of the tokens unchanged.
+      StringView text = toks.text(it);
+      toks.set(it, Token(TokenType::RightAngle, StringView(text.data(), 1)));
+      view = std::make_pair(pos, it + 1);
+    }
+    else
+    {
+      view = std::make_pair(pos, it);
     }
-
-    throw RestrictedParserError{ "no matching angle bracket" };
   }
 
   ~TemplateAngleView()
   {
     if (split_right_shift)
     {
-      Token tok = tokens.at(m_view.second - 1);
-      tokens.erase(tokens.begin() + m_view.second);
-      tokens[m_view.second - 1] = Token(TokenType::RightShift, StringView(tok.text().data(), 2));
+      StringView text = tokens.text(m_view.second - 1);
+      tokens.set(m_view.second - 1, Token(TokenType::RightShift, StringView(text.data(), 2)));
     }
   }
 };
@@ -300,95 +405,17 @@ public:
 class ListView : public ParserViewRAII
 {
 public:
-  ListView(const std::vector<Token>& toks, std::pair<size_t, size_t>& view, size_t pos, bool ignore_angle = true)
+  ListView(const TokenBuffer& toks, const DelimiterIndex& delims, std::pair<size_t, size_t>& view, size_t pos, bool ignore_angle = true)
     : ParserViewRAII(view)
   {
-    size_t bracket_depth = 0;
-    size_t paren_depth = 0;
-    size_t brace_depth = 0;
-    size_t angle_depth = 0;
-
-    auto begin = toks.begin() + pos;
-    auto end = toks.begin() + view.second;
-
-    auto it = begin;
-
-    while (it != end)
-    {
-      if (it->type() == TokenType::Comma)
-      {
-        if (brace_depth == 0 && paren_depth == 0 && bracket_depth == 0 && angle_depth == 0)
-        {
-          view = std::make_pair(pos, std::distance(toks.begin(), it));
-          return;
-        }
-      }
-      else if (it->type() == TokenType::GreaterThan)
-      {
-        if (!ignore_angle && bracket_depth == 0 && paren_depth == 0 && brace_depth == 0)
-        {
-          if (angle_depth == 0)
-            throw RestrictedParserError{ "no matching angle bracket" };
-
-          --angle_depth;
-        }
-      }
-      else if (it->type() == TokenType::Less)
-      {
-        if (!ignore_angle && bracket_depth == 0 && paren_depth == 0 && brace_depth == 0)
-        {
-          ++angle_depth;
-        }
-      }
-      else if (it->type() == TokenType::RightShift)
-      {
-        if (!ignore_angle && bracket_depth == 0 && paren_depth == 0 && brace_depth == 0)
-        {
-          angle_depth -= 2;
-        }
-      }
-      else if (it->type() == TokenType::RightBracket)
-      {
-        if (bracket_depth == 0)
-          throw RestrictedParserError{ "no matching bracket" };
-
-        --bracket_depth;
-      }
-      else if (it->type() == TokenType::LeftBracket)
-      {
-        ++bracket_depth;
-      }
-      else if (it->type() == TokenType::RightPar)
-      {
-        if (paren_depth == 0)
-          throw RestrictedParserError{ "no matching parenthesis" };
-
-        --paren_depth;
-      }
-      else if (it->type() == TokenType::LeftPar)
-      {
-        ++paren_depth;
-      }
-      else if (it->type() == TokenType::RightBrace)
-      {
-        if (brace_depth == 0)
-          throw RestrictedParserError{ "no matching brace" };
-
-        --brace_depth;
-      }
-      else if (it->type() == TokenType::LeftBrace)
-      {
-        ++brace_depth;
-      }
-
+    const char* error = nullptr;
+    const size_t it = find_list_end(toks, delims, pos, view.second, ignore_angle, error);
 
-      ++it;
-    }
+    if (it == no_match)
+      throw RestrictedParserError{ error };
 
-    if (bracket_depth != 0 || paren_depth != 0 || brace_depth != 0)
-    {
-      throw RestrictedParserError{ "no matching bracket/brace/paren" };
-    }
+    if (it != view.second)
+      view = std::make_pair(pos, it);
   }
 };
 
@@ -396,19 +423,17 @@ class ParserSentinelView : public ParserViewRAII
 {
 public:
 
-  ParserSentinelView(const std::vector<Token>& toks, std::pair<size_t, size_t>& view, size_t pos, TokenType tt)
+  ParserSentinelView(const TokenBuffer& toks, std::pair<size_t, size_t>& view, size_t pos, TokenType tt)
     : ParserViewRAII(view)
   {
-    auto begin = toks.begin() + pos;
-    auto end = toks.begin() + view.second;
-
-    auto it = begin;
+    size_t it = pos;
+    const size_t end = view.second;
 
     while (it != end)
     {
-      if (it->type() == tt)
+      if (toks.type(it) == tt)
       {
-        view = std::make_pair(pos, std::distance(toks.begin(), it));
+        view = std::make_pair(pos, it);
         return;
       }
 
@@ -423,7 +448,7 @@ class ParserSemicolonView : public ParserSentinelView
 {
 public:
 
-  ParserSemicolonView(const std::vector<Token>& toks, std::pair<size_t, size_t>& view, size_t pos)
+  ParserSemicolonView(const TokenBuffer& toks, std::pair<size_t, size_t>& view, size_t pos)
     : ParserSentinelView(toks, view, pos, TokenType::Semicolon)
   {
 
@@ -434,116 +459,901 @@ class ParserColonView : public ParserSentinelView
 {
 public:
 
-  ParserColonView(const std::vector<Token>& toks, std::pair<size_t, size_t>& view, size_t pos)
+  ParserColonView(const TokenBuffer& toks, std::pair<size_t, size_t>& view, size_t pos)
     : ParserSentinelView(toks, view, pos, TokenType::Colon)
   {
 
   }
 };
 
-RestrictedParser::RestrictedParser(const std::string *src)
-  : m_lexer(src)
+// Whether the '{' that ends 'tokens' opens the body of a function (or of a lambda).
+// The guess is conservative, it is only made after a parameter list and 
+// the specifiers that may follow it.
+static bool opens_function_body(const TokenBuffer& tokens)
 {
-  m_lexer.start();
-
-  while (!m_lexer.atEnd())
-  {
-    const Token t = m_lexer.read();
-    if (!isDiscardable(t))
-      m_buffer.push_back(t);
-  }
+  auto is_specifier = [&tokens](size_t i) {
+    switch (tokens.type(i).value())
+    {
+    case TokenType::Const:
+    case TokenType::Final:
+    case TokenType::Mutable:
+    case TokenType::Noexcept:
+    case TokenType::Override:
+    case TokenType::Ref:
+    case TokenType::RefRef:
+      return true;
+    case TokenType::UserDefinedName:
+      return tokens.text(i) == "volatile";
+    default:
+      return false;
+    }
+  };
 
-  m_view = std::make_pair(0, m_buffer.size());
+  size_t i = tokens.size() - 1;
 
-  m_ast_stack.push_back(std::make_shared<AstRootNode>());
-}
+  while (i > 0 && is_specifier(i - 1))
+    --i;
 
-RestrictedParser::RestrictedParser()
-  : m_filesystem(&cxx::FileSystem::GlobalInstance()),
-    m_program(std::make_shared<Program>())
-{
-  setProgram(m_program);
-}
+  if (i == 0 || tokens.type(--i) != TokenType::RightPar)
+    return false;
 
-bool RestrictedParser::parse(const std::string& filepath)
-{
-  std::ifstream stream{ filepath };
+  // the matching '('
+  for (int depth = 0; ; --i)
+  {
+    const TokenType t = tokens.type(i);
 
-  std::string line;
-  std::string filecontent;
+    if (t == TokenType::RightPar)
+      ++depth;
+    else if (t == TokenType::LeftPar && --depth == 0)
+      break;
+    else if (t == TokenType::LeftBrace || t == TokenType::RightBrace || t == TokenType::Semicolon)
+      return false;
 
-  while (std::getline(stream, line))
-  {
-    filecontent += line;
-    filecontent.push_back('\n');
+    if (i == 0)
+      return false;
   }
 
-  return parse(filepath, filecontent);
-}
+  // e.g. struct alignas(8) Foo or namespace ns __attribute__((visibility("default")))
+  if (i == 0 || tokens.type(i - 1) == TokenType::LeftPar)
+    return false;
 
-bool RestrictedParser::parse(const std::string& filepath, const std::string& content)
-{
-  auto fileobj = m_filesystem->get(filepath);
-  m_lexer.reset(&content);
+  const StringView name = tokens.text(i - 1);
 
-  m_lexer.start();
-  m_buffer.clear();
+  if (name == "decltype" || name == "alignas" || name == "__attribute__" || name == "__declspec")
+    return false;
 
-  while (!m_lexer.atEnd())
+  while (i-- > 0)
   {
-    const Token t = m_lexer.read();
-    if (!isDiscardable(t))
-      m_buffer.push_back(t);
-  }
+    const TokenType t = tokens.type(i);
 
-  m_index = 0;
-  m_view = std::make_pair(size_t(0), m_buffer.size());
+    if (t == TokenType::LeftBrace || t == TokenType::RightBrace || t == TokenType::Semicolon)
+      break;
+    else if (t == TokenType::Namespace || t == TokenType::Enum)
+      return false;
+  }
 
-  auto astnode = std::make_shared<AstRootNode>();
-  fileobj->ast = astnode;
+  return true;
+}
 
-  m_current_file = fileobj;
-  RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, astnode };
+// With 'skip_bodies', the content of the function bodies is not lexed: 
+// only their braces are kept.
+static void lex(Lexer& lexer, TokenBuffer& buffer, bool skip_bodies = false)
+{
+  lexer.start();
 
-  while (!atEnd())
+  while (!lexer.atEnd())
   {
-    Statement stmt = parseStatement();
-    astnode->childvec.push_back(cxx::to_ast_node(stmt));
-  }
+    const Token t = lexer.read();
+    if (t != TokenType::MultiLineComment && t != TokenType::SingleLineComment)
+      buffer.push_back(t);
 
-  return false;
+    if (skip_bodies && t == TokenType::LeftBrace && opens_function_body(buffer))
+      lexer.skipBraces();
+  }
 }
 
-std::shared_ptr<AstRootNode> RestrictedParser::parseSource(const std::string& content)
+RestrictedParser::RestrictedParser(const std::string *src)
 {
-  m_lexer.reset(&content);
+  m_ast_stack.push_back(std::make_shared<AstRootNode>());
+  resetSource(src);
+}
 
-  m_lexer.start();
-  m_buffer.clear();
+// Makes the parser parse 'src', keeping its buffers so that it can be 
+// reused without allocating again.
+void RestrictedParser::resetSource(const std::string* src)
+{
+  m_source.clear();
+  m_shared_source.reset();
+  m_lexer.reset(src);
 
-  while (!m_lexer.atEnd())
-  {
-    const Token t = m_lexer.read();
-    if (!isDiscardable(t))
-      m_buffer.push_back(t);
-  }
+  tokenize();
 
   m_index = 0;
   m_view = std::make_pair(size_t(0), m_buffer.size());
+  m_access_specifier = cxx::AccessSpecifier::PUBLIC;
+  m_parsing_function_body = false;
+  m_ast_stack.resize(1);
+}
 
-  auto astnode = std::make_shared<AstRootNode>();
+// The parser used by the static functions: the one of the calling thread,
+// or a new one if it is already in use further up the stack.
+class RestrictedParser::StringParser
+{
+public:
+  explicit StringParser(const std::string& str, TypeCache* type_cache = nullptr)
+  {
+    static const std::string empty;
+    static thread_local RestrictedParser thread_parser{ &empty };
+    bool& busy = threadParserInUse();
 
-  RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, astnode };
+    if (!busy)
+    {
+      busy = true;
+      m_busy = &busy;
+      m_parser = &thread_parser;
 
-  while (!atEnd())
+      try
+      {
+        m_parser->resetSource(&str);
+      }
+      catch (...)
+      {
+        // (the destructor does not run if the string cannot be lexed)
+        release();
+        throw;
+      }
+    }
+    else
+    {
+      m_own.reset(new RestrictedParser{ &str });
+      m_parser = m_own.get();
+    }
+
+    m_parser->m_type_cache = type_cache;
+  }
+
+  ~StringParser()
   {
-    Statement stmt = parseStatement();
+    if (m_busy)
+      release();
+  }
+
+  RestrictedParser* operator->() const { return m_parser; }
+
+  static bool& threadParserInUse()
+  {
+    static thread_local bool busy = false;
+    return busy;
+  }
+
+private:
+  void release()
+  {
+    // the tokens refer to the string being parsed
+    m_parser->m_buffer.clear();
+    m_parser->m_view = std::make_pair(size_t(0), size_t(0));
+    m_parser->m_index = 0;
+    m_parser->m_type_cache = nullptr;
+    *m_busy = false;
+  }
+
+  RestrictedParser* m_parser = nullptr;
+  std::unique_ptr<RestrictedParser> m_own;
+  bool* m_busy = nullptr;
+};
+
+// Whether the parser of the calling thread is used by a static parse function
+bool RestrictedParser::threadParserInUse()
+{
+  return StringParser::threadParserInUse();
+}
+
+RestrictedParser::RestrictedParser()
+  : m_filesystem(&cxx::FileSystem::GlobalInstance()),
+    m_program(std::make_shared<Program>())
+{
+  setProgram(m_program);
+}
+
+RestrictedParser::RestrictedParser(cxx::FileSystem& fs)
+  : m_filesystem(&fs),
+    m_program(std::make_shared<Program>())
+{
+  setProgram(m_program);
+}
+
+RestrictedParser::RestrictedParser(std::shared_ptr<Program> prog, cxx::FileSystem& fs)
+  : m_filesystem(&fs),
+    m_program(prog)
+{
+  setProgram(m_program);
+}
+
+bool RestrictedParser::parse(const std::string& filepath)
+{
+  return parse(filepath, SourceBuffer::open(filepath));
+}
+
+bool RestrictedParser::parse(const std::string& filepath, const std::string& content)
+{
+  m_source.clear();
+  m_shared_source.reset();
+  m_lexer.reset(&content);
+  return parseFile(filepath);
+}
+
+// The parser takes ownership of the buffer so that the tokens, 
+// which point into it, remain valid until the next parse.
+bool RestrictedParser::parse(const std::string& filepath, SourceBuffer content)
+{
+  m_source = std::move(content);
+  m_shared_source.reset();
+  m_lexer.reset(m_source);
+  return parseFile(filepath);
+}
+
+// The files included by 'filepath' are parsed into the same program 
+// when their #include is reached, with the same preprocessor.
+bool RestrictedParser::parseFile(const std::string& filepath)
+{
+  auto fileobj = m_filesystem->get(filepath);
+
+  RAIIGuard<std::shared_ptr<Preprocessor>> preprocessor_guard{ m_preprocessor };
+
+  if (!m_preprocessor)
+  {
+    m_preprocessor = std::make_shared<Preprocessor>();
+    m_preprocessor->includedirs = includedirs;
+    m_preprocessor->macros = defines;
+    m_preprocessor->include_handler = [this](const std::string& path) {
+      parseInclude(path);
+    };
+  }
+
+  m_current_file = fileobj;
+  errors.clear();
+
+  // the nodes of the file are allocated together, nodes created later by 
+  // reparse() are allocated on the heap
+  RAIIGuard<std::shared_ptr<Arena>> arena_guard{ m_arena };
+  m_arena = arena_allocation ? std::make_shared<Arena>() : nullptr;
+  fileobj->arena = m_arena;
+
+  if (incremental)
+  {
+    // the tokens must outlive the content passed to parse()
+    const size_t size = m_lexer.source().size();
+    std::shared_ptr<const char> source = sharedSource();
+    m_lexer.reset(source.get(), size);
+  }
+
+  tokenize();
+
+  m_index = 0;
+  m_view = std::make_pair(size_t(0), m_buffer.size());
+
+  auto astnode = make<AstRootNode>();
+  fileobj->ast = astnode;
+
+  RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, astnode };
+
+  while (!atEnd())
+  {
+    Statement stmt = parseStatementOrRecover();
+    astnode->childvec.push_back(cxx::to_ast_node(stmt));
+  }
+
+  if (incremental)
+  {
+    IncrementalFile& state = m_incremental_files[fileobj->path()];
+    state.source = m_shared_source;
+    state.size = m_buffer.source().size();
+    state.tokens = m_buffer;
+    state.preprocessed = Preprocessor::hasDirectives(m_buffer.source());
+  }
+
+  return false;
+}
+
+void RestrictedParser::parseInclude(const std::string& filepath)
+{
+  RestrictedParser parser{ m_program, *m_filesystem };
+  parser.skip_function_bodies = skip_function_bodies;
+  parser.skip_function_body_tokens = skip_function_body_tokens;
+  parser.lexer_threads = lexer_threads;
+  parser.error_recovery = error_recovery;
+  parser.arena_allocation = arena_allocation;
+  parser.m_preprocessor = m_preprocessor;
+  parser.parse(filepath);
+  errors.insert(errors.end(), parser.errors.begin(), parser.errors.end());
+}
+
+std::shared_ptr<AstRootNode> RestrictedParser::parseSource(const std::string& content)
+{
+  m_source.clear();
+  m_shared_source.reset();
+  m_lexer.reset(&content);
+  errors.clear();
+
+  tokenize();
+
+  m_index = 0;
+  m_view = std::make_pair(size_t(0), m_buffer.size());
+
+  auto astnode = make<AstRootNode>();
+
+  RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, astnode };
+
+  while (!atEnd())
+  {
+    Statement stmt = parseStatementOrRecover();
     astnode->childvec.push_back(cxx::to_ast_node(stmt));
   }
 
   return astnode;
 }
 
+// The previous source of a file being reparsed and the edits, sorted by offset, 
+// that turn it into the new source.
+struct RestrictedParser::ReparseState
+{
+  StringView old_source;
+  std::vector<std::uint32_t> old_lines;
+  std::vector<Edit> edits;
+  std::vector<size_t> edit_ends;
+  std::vector<std::ptrdiff_t> shifts; // shifts[i]: size change due to edits[0..i)
+  std::vector<std::shared_ptr<IEntity>> discarded; // entities of the discarded declarations
+
+  // what is restored if the reparse fails
+  std::vector<std::pair<std::vector<std::shared_ptr<AstNode>>*, std::vector<std::shared_ptr<AstNode>>>> scopes;
+  std::vector<std::pair<std::shared_ptr<AstNode>, int>> moved; // nodes whose lines were shifted
+  std::vector<std::pair<std::shared_ptr<AstNode>, SourceRange>> ranges;
+  std::vector<std::pair<std::shared_ptr<Function>, Statement>> bodies;
+
+  size_t offset(const SourceRange::Position& p) const
+  {
+    return old_lines.at(p.line) + p.column;
+  }
+
+  // index of the first edit that ends after 'offset'
+  size_t firstEditAfter(size_t offset) const
+  {
+    return std::upper_bound(edit_ends.begin(), edit_ends.end(), offset) - edit_ends.begin();
+  }
+
+  // maps an offset that is not in an edited range to the new source
+  size_t map(size_t offset) const
+  {
+    const size_t i = std::upper_bound(edit_ends.begin(), edit_ends.end(), offset) - edit_ends.begin();
+    return static_cast<size_t>(static_cast<std::ptrdiff_t>(offset) + shifts[i]);
+  }
+
+  void restore();
+};
+
+// Applies 'edits' to the source that 'filepath' had when it was last parsed 
+// (with 'incremental' set) and parses the result again.
+// The declarations that the edits do not touch are kept as they are, with 
+// their entities; only their source range is updated. Edits must not overlap.
+// Included files are not parsed again, they are only preprocessed.
+// Returns false if the file cannot be reparsed, in which case it should 
+// be parsed with parse().
+// If the new source cannot be parsed, the exception is propagated and the 
+// file, its AST and the entities are left as they were before the call.
+bool RestrictedParser::reparse(const std::string& filepath, const std::vector<Edit>& edits)
+{
+  auto fileobj = m_filesystem->get(filepath);
+  auto it = m_incremental_files.find(fileobj->path());
+
+  if (it == m_incremental_files.end() || !fileobj->ast || fileobj->ast->node_kind() != NodeKind::AstRootNode)
+    return false;
+
+  IncrementalFile& file = it->second;
+
+  ReparseState state;
+  state.old_source = StringView(file.source.get(), file.size);
+  state.old_lines = Lexer::lineOffsets(state.old_source);
+  state.edits = edits;
+
+  std::sort(state.edits.begin(), state.edits.end(), [](const Edit& a, const Edit& b) {
+    return a.offset < b.offset;
+    });
+
+  auto content = std::make_shared<std::string>();
+  content->reserve(file.size);
+
+  size_t copied = 0;
+  std::ptrdiff_t shift = 0;
+  state.shifts.push_back(0);
+
+  for (const Edit& e : state.edits)
+  {
+    if (e.offset < copied || e.offset + e.length > file.size)
+      throw RestrictedParserError{ "invalid edit" };
+
+    content->append(file.source.get() + copied, e.offset - copied);
+    content->append(e.text);
+    copied = e.offset + e.length;
+
+    shift += static_cast<std::ptrdiff_t>(e.text.size()) - static_cast<std::ptrdiff_t>(e.length);
+    state.edit_ends.push_back(copied);
+    state.shifts.push_back(shift);
+  }
+
+  content->append(file.source.get() + copied, file.size - copied);
+
+  m_source.clear();
+  m_shared_source = std::shared_ptr<const char>(content, content->data());
+  m_lexer.reset(content->data(), content->size());
+  m_current_file = fileobj;
+  errors.clear();
+
+  RAIIGuard<std::shared_ptr<Preprocessor>> preprocessor_guard{ m_preprocessor };
+  m_preprocessor = std::make_shared<Preprocessor>();
+  m_preprocessor->includedirs = includedirs;
+  m_preprocessor->macros = defines;
+  m_preprocessor->include_handler = [pp = m_preprocessor.get()](const std::string& path) {
+    SourceBuffer buffer = SourceBuffer::open(path);
+    pp->process(path, buffer.str());
+  };
+
+  if (file.preprocessed || file.tokens.empty() || Preprocessor::hasDirectives(m_lexer.source()) || state.edits.empty())
+  {
+    tokenize();
+  }
+  else
+  {
+    // a single edit spanning all the edits
+    SourceEdit edit;
+    edit.offset = state.edits.front().offset;
+    edit.removed = state.edit_ends.back() - edit.offset;
+    edit.inserted = static_cast<size_t>(static_cast<std::ptrdiff_t>(edit.removed) + shift);
+
+    m_memo.clear();
+    m_horizon = 0;
+    m_buffer = std::move(file.tokens);
+    m_lexer.relex(m_buffer, edit, true);
+    m_delimiters.build(m_buffer);
+  }
+
+  m_index = 0;
+  m_view = std::make_pair(size_t(0), m_buffer.size());
+
+  auto astnode = std::static_pointer_cast<AstRootNode>(fileobj->ast);
+
+  // the entities added and the bindings changed are journaled as in 
+  // parseStatementOrRecover(), the rest is recorded in 'state'
+  const size_t scopes = m_recovery.scopes.size();
+  const size_t bindings = m_recovery.bindings.size();
+
+  ++m_recovery.depth;
+  journalScope(curNode());
+
+  try
+  {
+    RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, astnode };
+    reparseScope(astnode->childvec, state);
+  }
+  catch (...)
+  {
+    --m_recovery.depth;
+    rollback(scopes, bindings);
+    state.restore();
+
+    // the tokens were relexed in place, they will be read again
+    file.tokens.clear();
+
+    throw;
+  }
+
+  if (--m_recovery.depth == 0)
+  {
+    m_recovery.scopes.clear();
+    m_recovery.bindings.clear();
+  }
+
+  remove_discarded(*astnode, state.discarded, *m_filesystem);
+
+  file.source = m_shared_source;
+  file.size = content->size();
+  file.tokens = m_buffer;
+  file.preprocessed = Preprocessor::hasDirectives(m_buffer.source());
+
+  return true;
+}
+
+static void shift_lines(AstNode& node, int lines)
+{
+  if (node.sourcerange.begin.line >= 0)
+  {
+    node.sourcerange.begin.line += lines;
+    node.sourcerange.end.line += lines;
+  }
+
+  for (std::shared_ptr<AstNode> child : node.children())
+  {
+    if (child)
+      shift_lines(*child, lines);
+  }
+}
+
+void RestrictedParser::ReparseState::restore()
+{
+  for (auto it = bodies.rbegin(); it != bodies.rend(); ++it)
+    it->first->body = it->second;
+
+  for (auto it = ranges.rbegin(); it != ranges.rend(); ++it)
+    it->first->sourcerange = it->second;
+
+  for (auto it = moved.rbegin(); it != moved.rend(); ++it)
+    shift_lines(*it->first, -it->second);
+
+  for (auto& s : scopes)
+    std::swap(*s.first, s.second);
+}
+
+// Reparses the content of a scope (the file or a namespace definition) that 
+// spans the current view, with 'childvec' holding its previous content.
+// A previous declaration is kept, and its tokens skipped, if no edit overlaps
+// it and its tokens and columns are the same in the new source. 
+// A namespace definition whose braces are not touched is kept too and its 
+// content reparsed in the same way.
+// The other declarations are discarded and the tokens between the kept ones
+// are parsed again, as they would be by parse().
+void RestrictedParser::reparseScope(std::vector<std::shared_ptr<AstNode>>& childvec, ReparseState& state)
+{
+  struct Reuse
+  {
+    std::shared_ptr<AstNode> node;
+    size_t first; // index of the first token of the node
+    size_t last;  // index of the token that follows the node
+    size_t brace; // index of the '{' of a namespace definition that is reparsed
+  };
+
+  const size_t npos = DelimiterIndex::npos;
+
+  // index of the token that starts at 'offset', or of the token that follows
+  auto find_token = [this](size_t offset) -> size_t {
+    size_t first = m_index;
+    size_t count = m_view.second - m_index;
+
+    while (count > 0)
+    {
+      const size_t half = count / 2;
+
+      if (m_buffer.offset(first + half) < offset)
+      {
+        first += half + 1;
+        count -= half + 1;
+      }
+      else
+      {
+        count = half;
+      }
+    }
+
+    return first;
+  };
+
+  auto find_reuse = [&](const std::shared_ptr<AstNode>& node) -> Reuse {
+    Reuse result{ node, npos, npos, npos };
+    const SourceRange& range = node->sourcerange;
+
+    // the extent of a statement that could not be parsed depends on what follows it
+    if (node->node_kind() == NodeKind::UnexposedStatement)
+      return result;
+
+    if (range.begin.line < 0 || range.end.line < 0 || static_cast<size_t>(range.end.line) >= state.old_lines.size())
+      return result;
+
+    const size_t begin = state.offset(range.begin);
+    const size_t end = state.offset(range.end);
+
+    // the edits that touch the node
+    const size_t first_edit = state.firstEditAfter(begin);
+    size_t last_edit = first_edit;
+
+    // (an edit just after the node can change its end, e.g. with a ';')
+    while (last_edit < state.edits.size() && state.edits[last_edit].offset <= end)
+      ++last_edit;
+
+    if (first_edit == last_edit)
+    {
+      // the tokens of the node must not have been merged with edited ones 
+      // and the columns must be the same
+      const size_t first = find_token(state.map(begin));
+      const size_t last = find_token(state.map(end));
+
+      if (first < last && m_buffer.offset(first) == state.map(begin)
+        && m_buffer.offset(last - 1) + m_buffer.text(last - 1).size() == state.map(end)
+        && m_buffer.col(state.map(begin)) == range.begin.column)
+      {
+        result.first = first;
+        result.last = last;
+        return result;
+      }
+    }
+
+    if (node->node_kind() != NodeKind::NamespaceDeclaration)
+      return result;
+
+    // the edits must be between the braces of a namespace definition
+    // (or just after it, this does not change its end)
+    while (last_edit > first_edit && state.edits[last_edit - 1].offset == end)
+      --last_edit;
+
+    if (first_edit < last_edit && state.edit_ends[last_edit - 1] >= end)
+      return result;
+
+    const size_t first = find_token(state.map(begin));
+
+    if (first == m_view.second || m_buffer.offset(first) != state.map(begin) || m_buffer.type(first) != TokenType::Namespace)
+      return result;
+
+    size_t brace = first + 1;
+
+    while (brace < m_view.second && m_buffer.type(brace) != TokenType::LeftBrace)
+      ++brace;
+
+    if (brace == m_view.second)
+      return result;
+
+    const size_t old_brace = m_buffer.offset(brace) - (state.map(begin) - begin);
+
+    if (first_edit < last_edit && state.edits[first_edit].offset <= old_brace)
+      return result;
+
+    const size_t rightbrace = find_closing(m_buffer, m_delimiters, brace + 1, m_view.second, TokenType::LeftBrace, TokenType::RightBrace);
+
+    if (rightbrace == no_match || m_buffer.offset(rightbrace) != state.map(end - 1))
+      return result;
+
+    result.first = first;
+    result.last = rightbrace + 1;
+    result.brace = brace;
+    return result;
+  };
+
+  state.scopes.emplace_back(&childvec, std::vector<std::shared_ptr<AstNode>>());
+  std::swap(state.scopes.back().second, childvec);
+
+  std::vector<Reuse> reused;
+
+  {
+    // (nothing is added to 'state.scopes' before the end of this block)
+    const std::vector<std::shared_ptr<AstNode>>& previous = state.scopes.back().second;
+    std::vector<std::shared_ptr<AstNode>> discarded;
+    size_t lower_bound = m_index;
+
+    for (const std::shared_ptr<AstNode>& node : previous)
+    {
+      RAIIGuard<size_t> index_guard{ m_index };
+      m_index = lower_bound;
+
+      Reuse r = find_reuse(node);
+
+      if (r.first == npos)
+      {
+        discarded.push_back(node);
+        continue;
+      }
+
+      reused.push_back(r);
+      lower_bound = r.last;
+    }
+
+    for (const std::shared_ptr<AstNode>& node : discarded)
+      discard(*node, state);
+  }
+
+  for (const Reuse& r : reused)
+  {
+    while (!atEnd() && pos() < r.first)
+    {
+      Statement stmt = parseStatementOrRecover();
+      childvec.push_back(cxx::to_ast_node(stmt));
+    }
+
+    // a new statement may extend over the node (e.g. if a ';' was removed)
+    if (pos() > r.first)
+    {
+      discard(*r.node, state);
+      continue;
+    }
+
+    if (r.brace == npos)
+    {
+      const int lines = m_buffer.line(m_buffer.offset(r.first)) - r.node->sourcerange.begin.line;
+
+      if (lines != 0)
+      {
+        shift_lines(*r.node, lines);
+        state.moved.emplace_back(r.node, lines);
+      }
+
+      childvec.push_back(r.node);
+      seek(r.last);
+    }
+    else
+    {
+      auto& decl = static_cast<NamespaceDeclaration&>(*r.node);
+      Token namespacekw = m_buffer[r.first];
+
+      seek(r.brace);
+      read(TokenType::LeftBrace);
+
+      {
+        RAIIVectorSharedGuard<cxx::AstNode> ast_guard{ m_ast_stack, r.node };
+        RAIIVectorSharedGuard<cxx::INode> entity_guard{ m_program_stack, decl.entity_ptr };
+        journalScope(*decl.entity_ptr);
+
+        ParserBraceView brace_view{ m_buffer, m_delimiters, m_view, m_index };
+
+        reparseScope(decl.childvec, state);
+      }
+
+      Token rbrace = read(TokenType::RightBrace);
+
+      state.ranges.emplace_back(r.node, r.node->sourcerange);
+      localize(r.node, namespacekw, rbrace);
+      childvec.push_back(r.node);
+    }
+  }
+
+  while (!atEnd())
+  {
+    Statement stmt = parseStatementOrRecover();
+    childvec.push_back(cxx::to_ast_node(stmt));
+  }
+}
+
+// Unbinds the declarations of a discarded node and appends their entities 
+// to 'state.discarded'; whether they are removed is decided once the whole 
+// file has been reparsed.
+void RestrictedParser::discard(AstNode& node, ReparseState& state)
+{
+  for (std::shared_ptr<AstNode> child : node.children())
+  {
+    if (child)
+      discard(*child, state);
+  }
+
+  if (!node.isDeclaration())
+    return;
+
+  auto& decl = static_cast<IDeclaration&>(node);
+  std::shared_ptr<IEntity> entity = decl.entity_ptr;
+
+  if (!entity)
+    return;
+
+  if (program())
+  {
+    auto it = program()->astmap.find(entity.get());
+
+    if (it != program()->astmap.end() && it->second.get() == &node)
+    {
+      if (m_recovery.depth > 0)
+        m_recovery.bindings.emplace_back(it->first, it->second);
+
+      program()->astmap.erase(it);
+    }
+  }
+
+  // the definition of a function that remains declared is parsed again
+  if (entity->is<Function>())
+  {
+    auto& func = static_cast<Function&>(*entity);
+    const auto& children = decl.childvec;
+
+    if (!func.body.isNull() && std::find(children.begin(), children.end(), cxx::to_ast_node(func.body)) != children.end())
+    {
+      state.bodies.emplace_back(std::static_pointer_cast<Function>(entity), func.body);
+      func.body = Statement();
+    }
+  }
+
+  state.discarded.push_back(entity);
+}
+
+// Sources smaller than this are always lexed on the calling thread.
+static const size_t parallel_lexing_chunk_size = 256 * 1024;
+
+// Fills the token buffer from the source the lexer was reset to.
+// With lexer_threads > 1, a large source is split at line starts outside 
+// comments and literals and the parts are lexed concurrently; the resulting 
+// buffer, and the first error if any, are the same as with a single thread.
+// Sources with preprocessing directives go through the preprocessor first,
+// and only the ranges it keeps are lexed.
+void RestrictedParser::tokenize()
+{
+  m_memo.clear();
+  m_horizon = 0;
+  readTokens();
+  m_delimiters.build(m_buffer);
+}
+
+void RestrictedParser::readTokens()
+{
+  const StringView source = m_lexer.source();
+  const bool skip_bodies = skip_function_bodies && skip_function_body_tokens;
+  m_buffer.reset(source);
+
+  if (Preprocessor::hasDirectives(source))
+  {
+    Preprocessor default_preprocessor;
+    default_preprocessor.includedirs = includedirs;
+    default_preprocessor.macros = defines;
+
+    Preprocessor& pp = m_preprocessor ? *m_preprocessor : default_preprocessor;
+    const auto ranges = pp.process(m_current_file ? m_current_file->path() : std::string(), source);
+
+    for (const std::pair<size_t, size_t>& r : ranges)
+    {
+      m_lexer.reset(source.data() + r.first, r.second - r.first);
+      lex(m_lexer, m_buffer, skip_bodies);
+    }
+
+    m_lexer.reset(source.data(), source.size());
+    return;
+  }
+
+  std::vector<size_t> bounds;
+
+  if (lexer_threads > 1 && source.size() >= 2 * parallel_lexing_chunk_size)
+  {
+    const size_t chunks = std::min<size_t>(lexer_threads, source.size() / parallel_lexing_chunk_size);
+    bounds = Lexer::splitPoints(source, chunks);
+  }
+
+  if (bounds.empty())
+  {
+    m_lexer.reset(source.data(), source.size());
+    lex(m_lexer, m_buffer, skip_bodies);
+    return;
+  }
+
+  bounds.insert(bounds.begin(), 0);
+  bounds.push_back(source.size());
+
+  std::vector<TokenBuffer> parts{ bounds.size() - 1 };
+  std::vector<std::exception_ptr> errors{ parts.size() };
+
+  auto lex_part = [&](size_t i) {
+    try
+    {
+      Lexer lexer;
+      lexer.setInstructionSet(m_lexer.instructionSet());
+      lexer.reset(source.data() + bounds[i], bounds[i + 1] - bounds[i]);
+      parts[i].reset(source);
+      lex(lexer, parts[i], skip_bodies);
+    }
+    catch (...)
+    {
+      errors[i] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+
+  for (size_t i(1); i < parts.size(); ++i)
+    threads.emplace_back(lex_part, i);
+
+  lex_part(0);
+
+  for (std::thread& t : threads)
+    t.join();
+
+  for (const std::exception_ptr& e : errors)
+  {
+    if (e)
+      std::rethrow_exception(e);
+  }
+
+  for (const TokenBuffer& part : parts)
+    m_buffer.append(part);
+}
+
 std::shared_ptr<Program> RestrictedParser::program() const
 {
   return m_program;
@@ -557,60 +1367,237 @@ void RestrictedParser::setProgram(std::shared_ptr<Program> p)
   m_program_stack.push_back(m_program->globalNamespace());
 }
 
+// The types parsed from strings are cached by spelling: the libclang
+// parser, for one, asks for the same spellings over and over.
 cxx::Type RestrictedParser::parseType(const std::string& str)
 {
-  RestrictedParser p{ &str };
-  return p.parseType();
+  TypeCache& cache = TypeCache::GlobalInstance();
+  Type result;
+
+  if (cache.find(str, result))
+    return result;
+
+  StringParser p{ str };
+  result = p->parseType();
+  cache.insert(str, result);
+
+  return result;
 }
 
+// The types of the declarations parsed from strings are looked up in the
+// cache by their spelling before being parsed (see tryParseType()).
 std::shared_ptr<Function> RestrictedParser::parseFunctionSignature(const std::string& str)
 {
-  RestrictedParser p{ &str };
-  return p.parseFunctionSignature();
+  StringParser p{ str, &TypeCache::GlobalInstance() };
+  return p->parseFunctionSignature();
+}
+
+std::shared_ptr<Variable> RestrictedParser::parseVariable(const std::string& str)
+{
+  StringParser p{ str, &TypeCache::GlobalInstance() };
+  return p->parseVariable();
+}
+
+std::shared_ptr<Typedef> RestrictedParser::parseTypedef(const std::string& str)
+{
+  StringParser p{ str, &TypeCache::GlobalInstance() };
+  return p->parseTypedef();
+}
+
+std::shared_ptr<Macro> RestrictedParser::parseMacro(const std::string& str)
+{
+  StringParser p{ str };
+  return p->parseMacro();
+}
+
+bool RestrictedParser::atEnd() const
+{
+  return m_index == m_view.second;
+}
+
+template<typename T>
+static ParseResult<T> parse_success(T value)
+{
+  ParseResult<T> result;
+  result.value = std::move(value);
+  return result;
+}
+
+template<typename T>
+static ParseResult<T> parse_failure(size_t pos, const char* error)
+{
+  ParseResult<T> result;
+  result.failure_pos = pos;
+  result.error = error;
+  return result;
+}
+
+Type RestrictedParser::parseType()
+{
+  ParseResult<Type> result = tryParseType();
+
+  if (!result)
+    throw std::runtime_error{ result.error };
+
+  return result.value;
+}
+
+// When a type cache is set, the type is looked up by the text of its tokens
+// and only parsed if it is not found.
+ParseResult<Type> RestrictedParser::tryParseType()
+{
+  if (!m_type_cache)
+    return readType();
+
+  const size_t type_end = findTypeEnd();
+
+  if (type_end == no_match)
+    return readType();
+
+  const size_t begin = m_buffer.offset(m_index);
+  const size_t end = m_buffer.offset(type_end - 1) + m_buffer.text(type_end - 1).size();
+  const std::string spelling{ m_buffer.source().data() + begin, end - begin };
+  Type result;
+
+  if (m_type_cache->find(spelling, result))
+  {
+    seek(type_end);
+    m_horizon = std::max(m_horizon, type_end);
+    return parse_success(result);
+  }
+
+  ParseResult<Type> parsed = readType();
+
+  if (parsed && pos() == type_end)
+    m_type_cache->insert(spelling, parsed.value);
+
+  return parsed;
 }
 
-std::shared_ptr<Variable> RestrictedParser::parseVariable(const std::string& str)
-{
-  RestrictedParser p{ &str };
-  return p.parseVariable();
-}
+// Returns the end of the type that starts at the current position without
+// parsing it, or no_match if the type is not simple enough for that
+// (function types, operator names, '>>' closing template arguments...).
+// This follows readType(), which has the final say: a type is only
+// cached if it was parsed up to the same position.
+size_t RestrictedParser::findTypeEnd() const
+{
+  const size_t end = m_view.second;
+  size_t i = m_index;
+
+  auto at = [&](TokenType t) {
+    return i < end && m_buffer.type(i) == t;
+  };
+
+  auto skip_template_arguments = [&]() -> bool {
+    if (!at(TokenType::LeftAngle))
+      return true;
+
+    bool right_shift = false;
+    const char* error = nullptr;
+    const size_t right_angle = find_template_angle_end(m_buffer, m_delimiters, i + 1, end, right_shift, error);
+
+    if (right_angle == no_match || right_shift)
+      return false;
+
+    i = right_angle + 1;
+    return true;
+  };
+
+  if (at(TokenType::Const))
+    ++i;
+
+  if (i == end)
+    return no_match;
+
+  switch (m_buffer.type(i).value())
+  {
+  case TokenType::Void:
+  case TokenType::Bool:
+  case TokenType::Char:
+  case TokenType::Int:
+  case TokenType::Float:
+  case TokenType::Double:
+  case TokenType::Auto:
+  case TokenType::This:
+    ++i;
+    break;
+  case TokenType::UserDefinedName:
+  {
+    ++i;
+
+    if (!skip_template_arguments())
+      return no_match;
+
+    while (at(TokenType::ScopeResolution))
+    {
+      ++i;
+
+      if (!at(TokenType::UserDefinedName))
+        return no_match;
+
+      ++i;
+
+      if (!skip_template_arguments())
+        return no_match;
+    }
+  }
+  break;
+  default:
+    return no_match;
+  }
+
+  if (at(TokenType::Const))
+  {
+    ++i;
+
+    if (at(TokenType::Ref) || at(TokenType::RefRef))
+      return no_match;
+  }
+  else if (at(TokenType::Ref) || at(TokenType::RefRef))
+  {
+    ++i;
+
+    if (at(TokenType::Const))
+      ++i;
+  }
 
-std::shared_ptr<Typedef> RestrictedParser::parseTypedef(const std::string& str)
-{
-  RestrictedParser p{ &str };
-  return p.parseTypedef();
-}
+  if (at(TokenType::LeftPar))
+    return no_match;
 
-std::shared_ptr<Macro> RestrictedParser::parseMacro(const std::string& str)
-{
-  RestrictedParser p{ &str };
-  return p.parseMacro();
-}
+  if (at(TokenType::Star))
+  {
+    while (at(TokenType::Const) || at(TokenType::Star))
+      ++i;
+  }
 
-bool RestrictedParser::atEnd() const
-{
-  return m_index == m_view.second;
+  return i;
 }
 
-Type RestrictedParser::parseType()
+ParseResult<Type> RestrictedParser::readType()
 {
   CVQualifier cv_qual = CVQualifier::None;
   Reference ref = Reference::None;
 
-  if (peek() == TokenType::Const)
+  if (atEnd())
+    return parse_failure<Type>(pos(), "Unexpected end of input");
+
+  if (unsafe_peek() == TokenType::Const)
     unsafe_read(), cv_qual = CVQualifier::Const;
 
-  Name type_name = parseName();
+  ParseResult<Name> type_name = tryParseName();
+
+  if (!type_name)
+    return parse_failure<Type>(type_name.failure_pos, type_name.error);
 
   if (atEnd())
-    return Type(type_name.toString(), cv_qual, ref);
+    return parse_success(Type(type_name.value.toString(), cv_qual, ref));
 
   if (unsafe_peek() == TokenType::Const)
   {
     unsafe_read(), cv_qual = CVQualifier::Const;
 
     if (atEnd())
-      return Type(type_name.toString(), cv_qual, ref);
+      return parse_success(Type(type_name.value.toString(), cv_qual, ref));
 
     if (unsafe_peek() == TokenType::Ref || unsafe_peek() == TokenType::RefRef)
     {
@@ -628,39 +1615,36 @@ Type RestrictedParser::parseType()
       ref = Reference::RValue;
 
     if (atEnd())
-      return Type(type_name.toString(), cv_qual, ref);
+      return parse_success(Type(type_name.value.toString(), cv_qual, ref));
 
     if (unsafe_peek() == TokenType::Const)
       unsafe_read(), cv_qual = CVQualifier::Const;
   }
 
   if (atEnd())
-    return Type(type_name.toString(), cv_qual, ref);
+    return parse_success(Type(type_name.value.toString(), cv_qual, ref));
 
   if (unsafe_peek() == TokenType::LeftPar) 
   {
     auto save_point = pos();
 
-    try
-    {
-      auto fsig = tryReadFunctionSignature(Type(type_name.toString(), cv_qual, ref));
+    ParseResult<Type> fsig = tryReadFunctionSignature(Type(type_name.value.toString(), cv_qual, ref));
+
+    if (fsig)
       return fsig;
-    }
-    catch (const std::runtime_error&)
-    {
-      seek(save_point);
-    }
+
+    seek(save_point);
   }
-  else if (peek() == TokenType::Star)
+  else if (unsafe_peek() == TokenType::Star)
   {
     unsafe_read();
 
-    Type t = Type(type_name.toString(), cv_qual, ref);
+    Type t = Type(type_name.value.toString(), cv_qual, ref);
     t = Type::pointer(t);
 
-    while (!atEnd() && (peek() == TokenType::Const || unsafe_peek() == TokenType::Star))
+    while (!atEnd() && (unsafe_peek() == TokenType::Const || unsafe_peek() == TokenType::Star))
     {
-      Token tok = read();
+      Token tok = unsafe_read();
 
       if (tok == TokenType::Const)
         t = Type::cvQualified(t, CVQualifier::Const);
@@ -668,42 +1652,115 @@ Type RestrictedParser::parseType()
         t = Type::pointer(t);
     }
 
-    return t;
+    return parse_success(t);
   }
 
-  return Type(type_name.toString(), cv_qual, ref);
+  return parse_success(Type(type_name.value.toString(), cv_qual, ref));
 }
 
-Type RestrictedParser::tryReadFunctionSignature(const Type& result_type)
+ParseResult<Type> RestrictedParser::tryReadFunctionSignature(const Type& result_type)
 {
   std::vector<Type> params;
 
   const Token leftPar = unsafe_read();
+  const size_t right_par = find_closing(m_buffer, m_delimiters, pos(), m_view.second, TokenType::LeftPar, TokenType::RightPar);
+
+  m_horizon = std::max(m_horizon, right_par == no_match ? m_view.second : right_par);
+
+  if (right_par == no_match)
+    return parse_failure<Type>(pos(), "no matching parenthesis");
   
   {
-    ParserParenView paren_view{ m_buffer, m_view, m_index };
+    ParserViewRAII paren_view{ m_view, pos(), right_par };
 
     while (!atEnd())
     {
+      const char* error = nullptr;
+
+      if (find_list_end(m_buffer, m_delimiters, pos(), m_view.second, true, error) == no_match)
+        return parse_failure<Type>(pos(), error);
+
       {
-        ListView param_view{ m_buffer, m_view, m_index };
-        Type t = parseType();
-        params.push_back(t);
+        ListView param_view{ m_buffer, m_delimiters, m_view, m_index };
+        ParseResult<Type> t = tryParseType();
+
+        if (!t)
+          return t;
+
+        params.push_back(t.value);
       }
 
-      if (!atEnd())
-        read(TokenType::Comma);
+      if (!atEnd() && !tryRead(TokenType::Comma))
+        return parse_failure<Type>(pos(), "unexpected token");
     }
   }
 
-  read(TokenType::RightPar);
+  unsafe_read(); // ')'
+
+  return parse_success(Type::function(result_type, std::move(params)));
+}
+
+template<typename T>
+ParseResult<T> RestrictedParser::memoize(std::unordered_map<size_t, MemoEntry<T>>& table, ParseResult<T>(RestrictedParser::*parse)())
+{
+  const size_t start = pos();
+  auto it = table.find(start);
+
+  if (it != table.end())
+  {
+    const MemoEntry<T>& entry = it->second;
+
+    if (entry.view_end == m_view.second || (entry.horizon < entry.view_end && entry.horizon < m_view.second))
+    {
+      seek(entry.end);
+      m_horizon = std::max(m_horizon, entry.horizon);
+      return entry.result;
+    }
+  }
 
-  return Type::function(result_type, std::move(params));
+  const size_t outer_horizon = m_horizon;
+  m_horizon = start;
+
+  MemoEntry<T> entry;
+  entry.result = (this->*parse)();
+  entry.end = pos();
+  entry.view_end = m_view.second;
+  entry.horizon = std::max(m_horizon, pos());
+
+  m_horizon = std::max(outer_horizon, entry.horizon);
+  table[start] = entry;
+
+  return entry.result;
+}
+
+// Parses a type, or reuses the result of a previous parse at the same position
+// (typically the one done by detectStatement()).
+ParseResult<Type> RestrictedParser::memoizedParseType()
+{
+  return memoize(m_memo.types, &RestrictedParser::tryParseType);
+}
+
+ParseResult<Name> RestrictedParser::memoizedParseName()
+{
+  return memoize(m_memo.names, &RestrictedParser::tryParseName);
 }
 
 Name RestrictedParser::parseName()
 {
-  Token t = peek();
+  ParseResult<Name> result = tryParseName();
+
+  if (!result)
+    throw std::runtime_error{ result.error };
+
+  return result.value;
+}
+
+ParseResult<Name> RestrictedParser::tryParseName()
+{
+  if (atEnd())
+    return parse_failure<Name>(pos(), "Unexpected end of input");
+
+  Token t = unsafe_peek();
 
   switch (t.type().value())
   {
@@ -715,7 +1772,7 @@ Name RestrictedParser::parseName()
   case TokenType::Double:
   case TokenType::Auto:
   case TokenType::This:
-    return Name(std::make_shared<details::Identifier>(unsafe_read().to_string()));
+    return parse_success(Name(make<details::Identifier>(unsafe_read().symbol())));
   case TokenType::Operator:
     return readOperatorName();
   case TokenType::UserDefinedName:
@@ -724,52 +1781,59 @@ Name RestrictedParser::parseName()
     break;
   }
 
-  throw std::runtime_error{ "expected identifier" };
+  return parse_failure<Name>(pos(), "expected identifier");
 }
 
-Name RestrictedParser::readOperatorName()
+ParseResult<Name> RestrictedParser::readOperatorName()
 {
   //if (!testOption(ParseOperatorName))
   //  throw SyntaxError{ ParserError::UnexpectedToken, errors::UnexpectedToken{peek(), Token::Invalid} };
 
-  Token opkw = read();
+  Token opkw = unsafe_read();
   if (atEnd())
-    throw std::runtime_error{ "unexpected end of input" };
+    return parse_failure<Name>(pos(), "unexpected end of input");
 
-  Token op = peek();
+  Token op = unsafe_peek();
   if (op.type().value() & TokenCategory::OperatorToken)
   {
-    return Name(std::make_shared<details::OverloadedOperatorName>(unsafe_read().to_string()));
+    return parse_success(Name(make<details::OverloadedOperatorName>(unsafe_read().to_string())));
   }
   else if (op.type() == TokenType::LeftPar)
   {
-    const Token lp = read();
-    const Token rp = read(TokenType::RightPar);
+    const Token lp = unsafe_read();
 
-    if (pos(lp) + 1 != pos(rp))
-      throw std::runtime_error{ "unexpected blank space between '(' and ')'" };
+    if (!tryRead(TokenType::RightPar))
+      return parse_failure<Name>(pos(), "unexpected token");
 
-    return Name(std::make_shared<details::OverloadedOperatorName>("()"));
+    if (pos(lp) + 1 != pos(prev()))
+      return parse_failure<Name>(pos() - 1, "unexpected blank space between '(' and ')'");
+
+    return parse_success(Name(make<details::OverloadedOperatorName>("()")));
   }
   else if (op.type() == TokenType::LeftBracket)
   {
-    const Token lb = read();
-    const Token rb = read(TokenType::RightBracket);
+    const Token lb = unsafe_read();
+
+    if (!tryRead(TokenType::RightBracket))
+      return parse_failure<Name>(pos(), "unexpected token");
 
-    if (pos(lb) + 1 != pos(rb))
-      throw std::runtime_error{ "unexpected blank space between '[' and ']'" };
+    if (pos(lb) + 1 != pos(prev()))
+      return parse_failure<Name>(pos() - 1, "unexpected blank space between '[' and ']'");
 
-    return Name(std::make_shared<details::OverloadedOperatorName>("[]"));
+    return parse_success(Name(make<details::OverloadedOperatorName>("[]")));
   }
   else if (op.type() == TokenType::StringLiteral)
   {
     if (op.text().size() != 2)
-      throw std::runtime_error{ "unexpected \"\"" };
+      return parse_failure<Name>(pos(), "unexpected \"\"");
 
     unsafe_read();
-    auto suffix_name = parseName();
+    ParseResult<Name> suffix_name = tryParseName();
 
-    return Name(std::make_shared<details::LiteralOperatorName>(suffix_name.toString()));
+    if (!suffix_name)
+      return suffix_name;
+
+    return parse_success(Name(make<details::LiteralOperatorName>(suffix_name.value.toString())));
   }
   else if (op.type() == TokenType::UserDefinedLiteral)
   {
@@ -777,48 +1841,48 @@ Name RestrictedParser::readOperatorName()
     const std::string str = op.to_string();
 
     if (str.find("\"\"") != 0)
-      throw std::runtime_error{ "unexpected \"\"" };
+      return parse_failure<Name>(pos() - 1, "unexpected \"\"");
 
     std::string suffix_name{ str.begin() + 2, str.end() };
-    return Name(std::make_shared<details::LiteralOperatorName>(std::move(suffix_name)));
+    return parse_success(Name(make<details::LiteralOperatorName>(std::move(suffix_name))));
   }
 
-  throw std::runtime_error{ "expected operator symbol" };
+  return parse_failure<Name>(pos(), "expected operator symbol");
 }
 
-Name RestrictedParser::readUserDefinedName()
+ParseResult<Name> RestrictedParser::readUserDefinedName()
 {
-  const Token base = read();
+  if (m_index == m_buffer.size() || m_buffer.type(m_index) != TokenType::UserDefinedName)
+    return parse_failure<Name>(pos(), "expected identifier");
 
-  if (base.type() != TokenType::UserDefinedName)
-    throw std::runtime_error{ "expected identifier" };
+  const Token base = unsafe_read();
 
-  Name ret = Name(std::make_shared<details::Identifier>(base.to_string()));
+  Name ret = Name(make<details::Identifier>(base.symbol()));
 
   if (atEnd())
-    return ret;
+    return parse_success(ret);
 
-  Token t = peek();
+  Token t = unsafe_peek();
 
   if (t.type() == TokenType::LeftAngle)
   {
     const auto savepoint = pos();
 
-    try
-    {
-      ret = readTemplateArguments(ret);
-    }
-    catch (const std::runtime_error&)
+    ParseResult<Name> template_name = readTemplateArguments(ret);
+
+    if (!template_name)
     {
       seek(savepoint);
-      return ret;
+      return parse_success(ret);
     }
+
+    ret = template_name.value;
   }
 
   if (atEnd())
-    return ret;
+    return parse_success(ret);
 
-  t = peek();
+  t = unsafe_peek();
 
   if (t.type() == TokenType::ScopeResolution)
   {
@@ -827,32 +1891,47 @@ Name RestrictedParser::readUserDefinedName()
 
     while (t.type() == TokenType::ScopeResolution)
     {
-      read();
+      unsafe_read();
+
+      ParseResult<Name> n = tryParseName();
 
-      identifiers.push_back(parseName().impl());
+      if (!n)
+        return n;
+
+      identifiers.push_back(n.value.impl());
 
       if (atEnd())
         break;
       else
-        t = peek();
+        t = unsafe_peek();
     }
 
     ret = Name(details::QualifiedName::make(identifiers.begin(), identifiers.end()));
   }
 
-  return ret;
+  return parse_success(ret);
 }
 
-Name RestrictedParser::readTemplateArguments(const Name base)
+ParseResult<Name> RestrictedParser::readTemplateArguments(const Name base)
 {
-  const Token leftangle = read();
+  const Token leftangle = unsafe_read();
 
   std::vector<TemplateArgument> params;
 
   bool need_read_right_angle = true;
 
   {
-    TemplateAngleView main_view{ m_buffer, m_view, m_index };
+    const char* error = nullptr;
+    bool right_shift = false;
+
+    const size_t right_angle = find_template_angle_end(m_buffer, m_delimiters, pos(), m_view.second, right_shift, error);
+
+    m_horizon = std::max(m_horizon, right_angle == no_match ? m_view.second : right_angle);
+
+    if (right_angle == no_match)
+      return parse_failure<Name>(pos(), error);
+
+    TemplateAngleView main_view{ m_buffer, m_delimiters, m_view, m_index };
     // If a '>>' was splitted in two by the TemplateAngleView, its 
     // destructor will implicitely consume the second '>' so there is no 
     // need to read() it afterward.
@@ -860,20 +1939,23 @@ Name RestrictedParser::readTemplateArguments(const Name base)
 
     while (!atEnd())
     {
+      if (find_list_end(m_buffer, m_delimiters, pos(), m_view.second, false, error) == no_match)
+        return parse_failure<Name>(pos(), error);
+
       {
-        ListView sub_view{ m_buffer, m_view, m_index, false };
+        ListView sub_view{ m_buffer, m_delimiters, m_view, m_index, false };
         params.push_back(parseDelimitedTemplateArgument());
       }
 
-      if (!atEnd())
-        read(TokenType::Comma);
+      if (!atEnd() && !tryRead(TokenType::Comma))
+        return parse_failure<Name>(pos(), "unexpected token");
     }
   }
 
-  if(need_read_right_angle)
-    read(TokenType::RightAngle);
+  if (need_read_right_angle && !tryRead(TokenType::RightAngle))
+    return parse_failure<Name>(pos(), "unexpected token");
 
-  return Name{ std::make_shared<details::TemplateName>(base.toString(), std::move(params)) };
+  return parse_success(Name{ make<details::TemplateName>(base.toString(), std::move(params)) });
 }
 
 std::shared_ptr<Function> RestrictedParser::parseFunctionSignature()
@@ -911,23 +1993,30 @@ std::shared_ptr<Function> RestrictedParser::parseFunctionSignature()
     }
   }
 
-  Type return_type = parseType();
-  Name fun_name = parseName();
+  ParseResult<Type> return_type = memoizedParseType();
+
+  if (!return_type)
+    throw std::runtime_error{ return_type.error };
 
-  auto ret = std::make_shared<Function>(fun_name.toString());
+  ParseResult<Name> fun_name = memoizedParseName();
+
+  if (!fun_name)
+    throw std::runtime_error{ fun_name.error };
+
+  auto ret = make<Function>(fun_name.value.toString());
   ret->specifiers = specifiers;
-  ret->return_type = return_type;
+  ret->return_type = return_type.value;
 
   read(TokenType::LeftPar);
 
   {
-    ParserParenView parameters_view{ m_buffer, m_view, m_index };
+    ParserParenView parameters_view{ m_buffer, m_delimiters, m_view, m_index };
 
     while (!atEnd())
     {
       {
         constexpr bool ignore_angle = false;
-        ListView param_view{ m_buffer, m_view,  m_index, ignore_angle };
+        ListView param_view{ m_buffer, m_delimiters, m_view,  m_index, ignore_angle };
 
         ret->parameters.push_back(parseFunctionParameter());
         ret->parameters.back()->weak_parent = ret;
@@ -1016,10 +2105,17 @@ std::shared_ptr<Variable> RestrictedParser::parseVariable()
     }
   }
 
-  Type type = parseType();
-  Name name = parseName();
+  ParseResult<Type> type = memoizedParseType();
+
+  if (!type)
+    throw std::runtime_error{ type.error };
+
+  ParseResult<Name> name = memoizedParseName();
 
-  auto ret = std::make_shared<Variable>(type, name.toString());
+  if (!name)
+    throw std::runtime_error{ name.error };
+
+  auto ret = make<Variable>(type.value, name.value.toString());
   ret->specifiers() = specifiers;
 
   if (atEnd() || peek() == TokenType::Semicolon)
@@ -1040,11 +2136,11 @@ std::shared_ptr<Typedef> RestrictedParser::parseTypedef()
 
 std::shared_ptr<Macro> RestrictedParser::parseMacro()
 {
-  std::string name = read(TokenType::UserDefinedName).to_string();
+  Symbol name = read(TokenType::UserDefinedName).symbol();
   std::vector<std::string> params;
 
   if (atEnd())
-    return std::make_shared<Macro>(name, std::move(params));
+    return make<Macro>(name, std::move(params));
 
   read(TokenType::LeftPar);
 
@@ -1079,7 +2175,7 @@ std::shared_ptr<Macro> RestrictedParser::parseMacro()
     }
   }
 
-  return std::make_shared<Macro>(name, std::move(params));
+  return make<Macro>(name, std::move(params));
 }
 
 Token RestrictedParser::read()
@@ -1130,6 +2226,15 @@ Token RestrictedParser::read(TokenType::Value tokt)
   return tok;
 }
 
+bool RestrictedParser::tryRead(TokenType::Value tokt)
+{
+  if (m_index == m_buffer.size() || m_buffer.type(m_index) != tokt)
+    return false;
+
+  ++m_index;
+  return true;
+}
+
 size_t RestrictedParser::pos() const
 {
   return m_index;
@@ -1137,7 +2242,7 @@ size_t RestrictedParser::pos() const
 
 size_t RestrictedParser::pos(const Token& tok) const
 {
-  return tok.text().data() - m_lexer.source().data();
+  return tok.text().data() - m_buffer.source().data();
 }
 
 void RestrictedParser::seek(size_t pos)
@@ -1155,10 +2260,20 @@ void RestrictedParser::seekEnd()
   m_index = m_view.second;
 }
 
+std::pair<size_t, size_t> RestrictedParser::view() const
+{
+  return m_view;
+}
+
+void RestrictedParser::setView(size_t begin, size_t end)
+{
+  m_view = std::make_pair(begin, end);
+}
+
 std::string RestrictedParser::viewstring() const
 {
-  Token first = *(m_buffer.begin() + m_view.first);
-  Token last = *(m_buffer.begin() + m_view.second - 1);
+  Token first = m_buffer[m_view.first];
+  Token last = m_buffer[m_view.second - 1];
 
   return std::string(first.text().data(), last.text().data() + last.text().size());
 }
@@ -1166,26 +2281,19 @@ std::string RestrictedParser::viewstring() const
 std::string RestrictedParser::stringtoend() const
 {
   Token first = m_buffer[m_index];
-  Token last = *(m_buffer.begin() + m_view.second - 1);
+  Token last = m_buffer[m_view.second - 1];
 
   return std::string(first.text().data(), last.text().data() + last.text().size());
 }
 
 TemplateArgument RestrictedParser::parseDelimitedTemplateArgument()
 {
-  try
-  {
-    Type type = parseType();
+  ParseResult<Type> type = tryParseType();
 
-    if (!atEnd())
-      return seekEnd(), TemplateArgument{ viewstring() };
-
-    return TemplateArgument{ type };
-  }
-  catch (const std::runtime_error & )
-  {
+  if (!type || !atEnd())
     return seekEnd(), TemplateArgument{ viewstring() };
-  }
+
+  return TemplateArgument{ type.value };
 }
 
 std::shared_ptr<TemplateParameter> RestrictedParser::parseDelimitedTemplateParameter()
@@ -1197,12 +2305,12 @@ std::shared_ptr<TemplateParameter> RestrictedParser::parseDelimitedTemplateParam
     unsafe_read();
 
     if (atEnd())
-      return std::make_shared<TemplateParameter>("");
+      return make<TemplateParameter>("");
 
-    std::string name = peek().isIdentifier() ? read().to_string() : "";
+    Symbol name = peek().isIdentifier() ? read().symbol() : Symbol();
 
     if (atEnd())
-      return std::make_shared<TemplateParameter>(std::move(name));
+      return make<TemplateParameter>(std::move(name));
 
     if (peek() != TokenType::Eq)
       throw std::runtime_error{ "expected '='" };
@@ -1212,19 +2320,19 @@ std::shared_ptr<TemplateParameter> RestrictedParser::parseDelimitedTemplateParam
     if(!atEnd())
       throw std::runtime_error{ "expected end of input" };
 
-    return std::make_shared<TemplateParameter>(std::move(name), default_value);
+    return make<TemplateParameter>(std::move(name), default_value);
   }
   else
   {
     Type type = parseType();
 
     if (atEnd())
-      return std::make_shared<TemplateParameter>(type, "");
+      return make<TemplateParameter>(type, "");
 
-    std::string name = peek().isIdentifier() ? read().to_string() : "";
+    Symbol name = peek().isIdentifier() ? read().symbol() : Symbol();
 
     if (atEnd())
-      return std::make_shared<TemplateParameter>(type, std::move(name));
+      return make<TemplateParameter>(type, std::move(name));
 
     if (peek() != TokenType::Eq)
       throw std::runtime_error{ "expected '='" };
@@ -1240,7 +2348,7 @@ std::shared_ptr<TemplateParameter> RestrictedParser::parseDelimitedTemplateParam
 
     default_val.pop_back();
 
-    return std::make_shared<TemplateParameter>(type, std::move(name), std::move(default_val));
+    return make<TemplateParameter>(type, std::move(name), std::move(default_val));
   }
 }
 
@@ -1249,22 +2357,21 @@ std::shared_ptr<Function::Parameter> RestrictedParser::parseFunctionParameter()
   const Type param_type = parseType();
 
   if (atEnd())
-    return std::make_shared<Function::Parameter>(param_type, "");
+    return make<Function::Parameter>(param_type, "");
 
-  std::string name;
+  Symbol name;
 
   if (peek().isIdentifier())
-    name = read().to_string();
+    name = read().symbol();
 
   if (atEnd())
-    return std::make_shared<Function::Parameter>(param_type, std::move(name));
+    return make<Function::Parameter>(param_type, std::move(name));
 
   read(TokenType::Eq);
 
-  std::string default_value = stringtoend();
-  seekEnd();
+  Expression default_value = parseExpression();
 
-  return std::make_shared<Function::Parameter>(param_type, std::move(name), Expression{ std::move(default_value) });
+  return make<Function::Parameter>(param_type, std::move(name), std::move(default_value));
 }
 
 cxx::INode& RestrictedParser::curNode()
@@ -1281,8 +2388,8 @@ void RestrictedParser::astWrite(std::shared_ptr<AstNode> n)
 void RestrictedParser::localizeParentize(const std::shared_ptr<AstNode>& node, const Token& tok)
 {
   node->sourcerange.file = m_current_file;
-  node->sourcerange.begin.line = tok.line();
-  node->sourcerange.begin.column = tok.col();
+  node->sourcerange.begin.line = m_buffer.line(pos(tok));
+  node->sourcerange.begin.column = m_buffer.col(pos(tok));
   node->sourcerange.end = node->sourcerange.begin;
   node->sourcerange.end.column += static_cast<int>(tok.text().size());
 
@@ -1292,10 +2399,10 @@ void RestrictedParser::localizeParentize(const std::shared_ptr<AstNode>& node, c
 void RestrictedParser::localizeParentize(const std::shared_ptr<AstNode>& node, const Token& first, const Token& last)
 {
   node->sourcerange.file = m_current_file;
-  node->sourcerange.begin.line = first.line();
-  node->sourcerange.begin.column = first.col();
-  node->sourcerange.end.line = last.line();
-  node->sourcerange.end.column = last.col() + static_cast<int>(last.text().size());
+  node->sourcerange.begin.line = m_buffer.line(pos(first));
+  node->sourcerange.begin.column = m_buffer.col(pos(first));
+  node->sourcerange.end.line = m_buffer.line(pos(last));
+  node->sourcerange.end.column = m_buffer.col(pos(last)) + static_cast<int>(last.text().size());
 
   parentize(node);
 }
@@ -1303,10 +2410,10 @@ void RestrictedParser::localizeParentize(const std::shared_ptr<AstNode>& node, c
 void RestrictedParser::localize(const std::shared_ptr<AstNode>& node, const Token& first, const Token& last)
 {
   node->sourcerange.file = m_current_file;
-  node->sourcerange.begin.line = first.line();
-  node->sourcerange.begin.column = first.col();
-  node->sourcerange.end.line = last.line();
-  node->sourcerange.end.column = last.col() + static_cast<int>(last.text().size());
+  node->sourcerange.begin.line = m_buffer.line(pos(first));
+  node->sourcerange.begin.column = m_buffer.col(pos(first));
+  node->sourcerange.end.line = m_buffer.line(pos(last));
+  node->sourcerange.end.column = m_buffer.col(pos(last)) + static_cast<int>(last.text().size());
 }
 
 void RestrictedParser::parentize(const std::shared_ptr<AstNode>& node)
@@ -1316,8 +2423,55 @@ void RestrictedParser::parentize(const std::shared_ptr<AstNode>& node)
 
 void RestrictedParser::bind(const std::shared_ptr<AstNode>& astnode, const std::shared_ptr<INode>& n)
 {
-  if(program())
-    program()->astmap[n.get()] = astnode;
+  if (!program())
+    return;
+
+  std::shared_ptr<AstNode>& binding = program()->astmap[n.get()];
+
+  if (m_recovery.depth > 0)
+    m_recovery.bindings.emplace_back(n.get(), binding);
+
+  binding = astnode;
+}
+
+// Records the number of entities in 'scope' while a statement is parsed in
+// error recovery mode, so that the ones it adds can be removed if it fails.
+void RestrictedParser::journalScope(INode& scope)
+{
+  if (m_recovery.depth == 0)
+    return;
+
+  std::vector<std::shared_ptr<IEntity>>& entities = scope.is<Namespace>() ?
+    static_cast<Namespace&>(scope).entities : static_cast<Class&>(scope).members;
+
+  m_recovery.scopes.emplace_back(&entities, entities.size());
+}
+
+// Undoes what was recorded in the journal after the given sizes: 
+// the bindings are restored and the entities added to the scopes are removed.
+void RestrictedParser::rollback(size_t scopes, size_t bindings)
+{
+  while (m_recovery.bindings.size() > bindings)
+  {
+    auto& b = m_recovery.bindings.back();
+
+    if (b.second)
+      program()->astmap[b.first] = b.second;
+    else
+      program()->astmap.erase(b.first);
+
+    m_recovery.bindings.pop_back();
+  }
+
+  while (m_recovery.scopes.size() > scopes)
+  {
+    auto& s = m_recovery.scopes.back();
+
+    if (s.first->size() > s.second)
+      s.first->resize(s.second);
+
+    m_recovery.scopes.pop_back();
+  }
 }
 
 Statement RestrictedParser::parseStatement()
@@ -1424,6 +2578,95 @@ Statement RestrictedParser::parseStatement()
   }
 }
 
+// In error recovery mode, a statement that cannot be parsed is recorded
+// in 'errors' and skipped: the parser resumes after the end of the statement
+// and the skipped tokens are represented by an UnexposedStatement.
+// What the statement added to the program is removed, in every scope it
+// entered (a class or a namespace it reopened, for instance).
+Statement RestrictedParser::parseStatementOrRecover()
+{
+  if (!error_recovery)
+    return parseStatement();
+
+  const size_t start = m_index;
+  const size_t scopes = m_recovery.scopes.size();
+  const size_t bindings = m_recovery.bindings.size();
+
+  ++m_recovery.depth;
+  journalScope(curNode());
+
+  try
+  {
+    Statement stmt = parseStatement();
+
+    if (--m_recovery.depth == 0)
+    {
+      m_recovery.scopes.clear();
+      m_recovery.bindings.clear();
+    }
+
+    return stmt;
+  }
+  catch (const std::exception& ex)
+  {
+    --m_recovery.depth;
+    rollback(scopes, bindings);
+
+    const size_t failure = std::max(start, std::min(m_index, m_view.second - 1));
+    const Token tok = m_buffer[failure];
+    SourceLocation loc{ m_current_file, m_buffer.line(pos(tok)), m_buffer.col(pos(tok)) };
+    errors.push_back(Error{ ex.what(), loc });
+  }
+
+  seek(start);
+  return parseUnexposedStatement();
+}
+
+// Returns the index of the token that follows the statement starting at 'start'.
+// A statement ends with a ';' or with a '}' that closes a brace opened within the 
+// statement (with its ';', if any, as in a class definition).
+// Parentheses and brackets are skipped as a whole.
+size_t RestrictedParser::findStatementEnd(size_t start) const
+{
+  size_t it = start;
+
+  while (it < m_view.second)
+  {
+    const TokenType tokt = m_buffer.type(it);
+
+    if (tokt == TokenType::Semicolon)
+    {
+      return it + 1;
+    }
+    else if (tokt == TokenType::LeftBrace)
+    {
+      const size_t rightbrace = find_closing(m_buffer, m_delimiters, it + 1, m_view.second, TokenType::LeftBrace, TokenType::RightBrace);
+
+      if (rightbrace == no_match)
+        return m_view.second;
+
+      it = rightbrace + 1;
+      return (it < m_view.second && m_buffer.type(it) == TokenType::Semicolon) ? it + 1 : it;
+    }
+    else if (tokt == TokenType::LeftPar || tokt == TokenType::LeftBracket)
+    {
+      const TokenType::Value closing = tokt == TokenType::LeftPar ? TokenType::RightPar : TokenType::RightBracket;
+      const size_t right = find_closing(m_buffer, m_delimiters, it + 1, m_view.second, tokt.value(), closing);
+
+      if (right == no_match)
+        return m_view.second;
+
+      it = right + 1;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  return m_view.second;
+}
+
 static bool is_function_or_var_specifier(cxx::parsers::Token tok)
 {
   return tok == TokenType::Inline
@@ -1431,6 +2674,9 @@ static bool is_function_or_var_specifier(cxx::parsers::Token tok)
     || tok == TokenType::Mutable;
 }
 
+// Guesses the kind of the next statement by speculatively parsing a type
+// followed by a name; the speculative parse does not throw so that guessing
+// wrong (e.g. on an expression) is cheap.
 NodeKind RestrictedParser::detectStatement()
 {
   RAIIGuard<size_t> index_guard{ m_index };
@@ -1446,54 +2692,47 @@ NodeKind RestrictedParser::detectStatement()
     read();
   }
 
-  try 
-  {
-    Type rt_or_vartype = parseType();
-    Name n = parseName();
+  const NodeKind otherwise = can_be_expr ? NodeKind::ExpressionStatement : NodeKind::UnexposedStatement;
 
-    if (peek() == TokenType::LeftBrace || peek() == TokenType::Semicolon || peek() == TokenType::Eq)
-    {
-      return NodeKind::VariableDeclaration;
-    }
-    else if (peek() == TokenType::LeftPar)
-    {
-      read();
+  // the results of the previous statements will not be used again
+  m_memo.clear();
 
-      // can still be var or fun decl
-      size_t right_par_index = 0;
-      {
-        ParserParenView subview{ m_buffer, m_view, m_index };
-        right_par_index = m_view.second;
-      }
+  ParseResult<Type> rt_or_vartype = memoizedParseType();
 
-      if (m_buffer[right_par_index + 1] == TokenType::Semicolon)
-      {
-        // can still be both
+  if (!rt_or_vartype || !memoizedParseName() || atEnd())
+    return otherwise;
+
+  if (unsafe_peek() == TokenType::LeftBrace || unsafe_peek() == TokenType::Semicolon || unsafe_peek() == TokenType::Eq)
+  {
+    return NodeKind::VariableDeclaration;
+  }
+  else if (unsafe_peek() == TokenType::LeftPar)
+  {
+    unsafe_read();
 
-        if (rt_or_vartype.toString() == "void")
-          return NodeKind::FunctionDeclaration;
+    // can still be var or fun decl
+    const size_t right_par_index = find_closing(m_buffer, m_delimiters, pos(), m_view.second, TokenType::LeftPar, TokenType::RightPar);
 
-        // @TODO
-        throw std::runtime_error{ "not implemented" };
-      }
-      else
-      {
+    if (right_par_index == no_match)
+      return otherwise;
+
+    if (m_buffer[right_par_index + 1] == TokenType::Semicolon)
+    {
+      // can still be both
+
+      if (rt_or_vartype.value.toString() == "void")
         return NodeKind::FunctionDeclaration;
-      }
+
+      // @TODO
+      return otherwise;
     }
     else
     {
-      if(can_be_expr)
-        return NodeKind::ExpressionStatement;
+      return NodeKind::FunctionDeclaration;
     }
   }
-  catch (std::runtime_error&)
-  {
-    if(can_be_expr)
-      return NodeKind::ExpressionStatement;
-  }
 
-  return NodeKind::UnexposedStatement;
+  return otherwise;
 }
 
 Statement RestrictedParser::parseFunctionBody(std::shared_ptr<cxx::Function> f)
@@ -1503,7 +2742,7 @@ Statement RestrictedParser::parseFunctionBody(std::shared_ptr<cxx::Function> f)
     read(TokenType::LeftBrace);
 
     {
-      ParserBraceView brace_view{ m_buffer, m_view, m_index };
+      ParserBraceView brace_view{ m_buffer, m_delimiters, m_view, m_index };
       m_index = m_view.second;
     }
 
@@ -1514,17 +2753,17 @@ Statement RestrictedParser::parseFunctionBody(std::shared_ptr<cxx::Function> f)
 
   Token leftbrace = read(TokenType::LeftBrace);
 
-  auto astnode = std::make_shared<FunctionBody>(f);
+  auto astnode = make<FunctionBody>(f);
 
   {
     RAIIVectorSharedGuard<cxx::AstNode> guard{ m_ast_stack, astnode };
-    ParserBraceView brace_view{ m_buffer, m_view, m_index };
+    ParserBraceView brace_view{ m_buffer, m_delimiters, m_view, m_index };
     RAIIGuard<bool> parse_func_guard{ m_parsing_function_body };
     m_parsing_function_body = true;
 
     while (!atEnd())
     {
-      Statement stmt = parseStatement();
+      Statement stmt = parseStatementOrRecover();
       astnode->statements.push_back(stmt);
     }
   }
@@ -1538,14 +2777,14 @@ Statement RestrictedParser::parseFunctionBody(std::shared_ptr<cxx::Function> f)
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseNullStatement()
 {
-  auto result = std::make_shared<NullStatement>();
+  auto result = make<NullStatement>();
   localizeParentize(result, read());
   return result;
 }
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseAccessSpecifier()
 {
-  auto result = std::make_shared<AccessSpecifierDeclaration>();
+  auto result = make<AccessSpecifierDeclaration>();
 
   Token aspec = read();
   Token colon = read();
@@ -1565,7 +2804,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseAccessSpecifier()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseBreakStatement()
 {
-  auto result = std::make_shared<BreakStatement>();
+  auto result = make<BreakStatement>();
   localizeParentize(result, read());
   read(TokenType::Semicolon);
   return result;
@@ -1573,7 +2812,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseBreakStatement()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseCaseStatement()
 {
-  auto result = std::make_shared<CaseStatement>();
+  auto result = make<CaseStatement>();
 
   Token casekw = read(TokenType::Case);
   
@@ -1600,7 +2839,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseCaseStatement()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseCatchStatement()
 {
-  auto stmt = std::make_shared<CatchStatement>();
+  auto stmt = make<CatchStatement>();
   RaiiAstLocator ast_locator{ this, stmt };
 
   read(TokenType::Catch);
@@ -1608,7 +2847,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseCatchStatement()
   read(TokenType::LeftPar);
 
   {
-    ParserParenView paren_view{ m_buffer, m_view, m_index };
+    ParserParenView paren_view{ m_buffer, m_delimiters, m_view, m_index };
     stmt->var = parseParameterDecl();
   }
 
@@ -1621,7 +2860,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseCatchStatement()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseContinueStatement()
 {
-  auto result = std::make_shared<ContinueStatement>();
+  auto result = make<ContinueStatement>();
   localizeParentize(result, read());
   read(TokenType::Semicolon);
   return result;
@@ -1629,18 +2868,18 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseContinueStatement()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseCompoundStatement()
 {
-  auto result = std::make_shared<CompoundStatement>();
+  auto result = make<CompoundStatement>();
   
   Token leftbrace = read(TokenType::LeftBrace);
 
   {
     RAIIVectorSharedGuard<cxx::AstNode> ast_guard{ m_ast_stack, result };
 
-    ParserBraceView paren_view{ m_buffer, m_view, m_index };
+    ParserBraceView paren_view{ m_buffer, m_delimiters, m_view, m_index };
 
     while (!atEnd())
     {
-      result->statements.push_back(parseStatement());
+      result->statements.push_back(parseStatementOrRecover());
     }
   }
 
@@ -1653,7 +2892,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseCompoundStatement()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseDefaultStatement()
 {
-  auto result = std::make_shared<DefaultStatement>();
+  auto result = make<DefaultStatement>();
 
   Token defaultkw = read(TokenType::Default);
   read(TokenType::Colon);
@@ -1671,7 +2910,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseDefaultStatement()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseDoWhileLoop()
 {
-  auto result = std::make_shared<DoWhileLoop>();
+  auto result = make<DoWhileLoop>();
 
   RaiiAstLocator astguard{ this, result };
 
@@ -1684,7 +2923,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseDoWhileLoop()
   read(TokenType::LeftPar);
 
   {
-    ParserParenView parenview{ m_buffer, m_view, m_index };
+    ParserParenView parenview{ m_buffer, m_delimiters, m_view, m_index };
 
     result->condition = parseExpression();
   }
@@ -1698,7 +2937,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseDoWhileLoop()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseExpressionStatement()
 {
-  auto result = std::make_shared<ExpressionStatement>();
+  auto result = make<ExpressionStatement>();
 
   RaiiAstLocator astguard{ this, result };
 
@@ -1721,7 +2960,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseForLoop()
   bool is_for_range = false;
 
   {
-    ParserParenView paren_view{ m_buffer, m_view, m_index };
+    ParserParenView paren_view{ m_buffer, m_delimiters, m_view, m_index };
 
     size_t nb_semicolon = [this]() -> size_t {
       size_t n = 0;
@@ -1748,7 +2987,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseForLoop()
 
   if (is_for_range)
   {
-    auto result = std::make_shared<ForRange>();
+    auto result = make<ForRange>();
 
     {
       ParserColonView colon_view{ m_buffer, m_view, m_index };
@@ -1769,7 +3008,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseForLoop()
   }
   else
   {
-    auto result = std::make_shared<ForLoop>();
+    auto result = make<ForLoop>();
 
     {
       ParserSemicolonView semicolon_view{ m_buffer, m_view, m_index };
@@ -1802,10 +3041,10 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseIf()
 
   Token leftpar = read(TokenType::LeftPar);
 
-  auto result = std::make_shared<IfStatement>();
+  auto result = make<IfStatement>();
 
   {
-    ParserParenView paren_view{ m_buffer, m_view, m_index };
+    ParserParenView paren_view{ m_buffer, m_delimiters, m_view, m_index };
 
     result->condition = parseExpression();
   }
@@ -1829,7 +3068,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseReturnStatement()
 {
   Token returnkw = read(TokenType::Return);
 
-  auto result = std::make_shared<ReturnStatement>();
+  auto result = make<ReturnStatement>();
 
   if (peek() != TokenType::Semicolon)
   {
@@ -1849,7 +3088,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseReturnStatement()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseSwitchStatement()
 {
-  auto result = std::make_shared<SwitchStatement>();
+  auto result = make<SwitchStatement>();
 
   Token switchtok = read();
 
@@ -1859,7 +3098,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseSwitchStatement()
     read(TokenType::LeftPar);
 
     {
-      ParserParenView paren_view{ m_buffer, m_view, m_index };
+      ParserParenView paren_view{ m_buffer, m_delimiters, m_view, m_index };
       result->value = parseExpression();
     }
 
@@ -1875,7 +3114,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseSwitchStatement()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseTryBlock()
 {
-  auto stmt = std::make_shared<TryBlock>();
+  auto stmt = make<TryBlock>();
 
   RaiiAstLocator ast_locator{ this, stmt };
 
@@ -1897,13 +3136,13 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseWhile()
 
   Token leftpar = read(TokenType::LeftPar);
 
-  auto result = std::make_shared<WhileLoop>();
+  auto result = make<WhileLoop>();
 
   {
     RAIIVectorSharedGuard<cxx::AstNode> ast_guard{ m_ast_stack, result };
 
     {
-      ParserParenView paren_view{ m_buffer, m_view, m_index };
+      ParserParenView paren_view{ m_buffer, m_delimiters, m_view, m_index };
 
       result->condition = parseExpression();
     }
@@ -1920,7 +3159,15 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseWhile()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseUnexposedStatement()
 {
-  throw std::runtime_error{ "not implemented" };
+  auto result = make<UnexposedStatement>();
+
+  Token first = peek();
+  seek(findStatementEnd(pos()));
+  Token last = prev();
+
+  localizeParentize(result, first, last);
+
+  return result;
 }
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseDecl()
@@ -1941,7 +3188,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseClassDecl()
 {
   Token classkw = read(); // read 'class' or 'struct'
 
-  std::string cname = parseName().toString();
+  Symbol cname = parseName().toString();
   bool is_template = false;
 
   auto entity = [&]() -> std::shared_ptr<Class> {
@@ -1957,15 +3204,15 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseClassDecl()
     else
     {
       Class& cla = static_cast<Class&>(curNode());
-      std::shared_ptr<Class> result = !is_template ? (std::make_shared<Class>(std::move(cname), cla.shared_from_this())) :
-        (std::make_shared<ClassTemplate>(std::vector<std::shared_ptr<TemplateParameter>>(), std::move(cname), cla.shared_from_this()));
+      std::shared_ptr<Class> result = !is_template ? (make<Class>(std::move(cname), cla.shared_from_this())) :
+        (make<ClassTemplate>(std::vector<std::shared_ptr<TemplateParameter>>(), std::move(cname), cla.shared_from_this()));
       result->setAccessSpecifier(m_access_specifier);
       cla.members.push_back(result);
       return result;
     }
   }();
 
-  auto decl = std::make_shared<ClassDeclaration>(entity);
+  auto decl = make<ClassDeclaration>(entity);
 
   if (peek() == TokenType::Semicolon)
   {
@@ -1980,12 +3227,13 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseClassDecl()
   {
     RAIIVectorSharedGuard<cxx::AstNode> ast_guard{ m_ast_stack, decl };
     RAIIVectorSharedGuard<cxx::INode> entity_guard{ m_program_stack, entity };
+    journalScope(*entity);
 
-    ParserBraceView brace_view{ m_buffer, m_view, m_index };
+    ParserBraceView brace_view{ m_buffer, m_delimiters, m_view, m_index };
 
     while (!atEnd())
     {
-      Statement stmt = parseStatement();
+      Statement stmt = parseStatementOrRecover();
       decl->childvec.push_back(cxx::to_ast_node(stmt));
     }
   }
@@ -2008,9 +3256,9 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseNamespaceDecl()
 {
   Token namespacekw = read(); 
 
-  auto decl = std::make_shared<NamespaceDeclaration>();
+  auto decl = make<NamespaceDeclaration>();
 
-  std::string nsname = parseName().toString();
+  Symbol nsname = parseName().toString();
 
   if (!curNode().is<Namespace>())
     throw std::runtime_error{ "direct parent of namespace must be a namespace" };
@@ -2024,12 +3272,13 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseNamespaceDecl()
   {
     RAIIVectorSharedGuard<cxx::AstNode> ast_guard{ m_ast_stack, decl };
     RAIIVectorSharedGuard<cxx::INode> entity_guard{ m_program_stack, ns };
+    journalScope(*ns);
 
-    ParserBraceView brace_view{ m_buffer, m_view, m_index };
+    ParserBraceView brace_view{ m_buffer, m_delimiters, m_view, m_index };
 
     while (!atEnd())
     {
-      Statement stmt = parseStatement();
+      Statement stmt = parseStatementOrRecover();
       decl->childvec.push_back(cxx::to_ast_node(stmt));
     }
   }
@@ -2043,7 +3292,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseNamespaceDecl()
 
 std::shared_ptr<cxx::IStatement> RestrictedParser::parseParameterDecl()
 {
-  auto decl = std::make_shared<ParameterDeclaration>();
+  auto decl = make<ParameterDeclaration>();
   RaiiAstLocator ast_locator{ this, decl };
 
   parseType();
@@ -2078,7 +3327,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseTypedefDecl()
 {
   Token typedefkw = read(TokenType::Typedef);
 
-  auto decl = std::make_shared<TypedefDeclaration>();
+  auto decl = make<TypedefDeclaration>();
 
   {
     RAIIVectorSharedGuard<cxx::AstNode> ast_guard{ m_ast_stack, decl };
@@ -2090,7 +3339,7 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseTypedefDecl()
     if (!name.isIdentifier())
       throw std::runtime_error{ "Unexpected identifier while parsing typedef" };
 
-    auto entity = std::make_shared<Typedef>(t, name.to_string());
+    auto entity = make<Typedef>(t, name.symbol());
   
     decl->entity_ptr = entity;
     bind(decl, entity);
@@ -2103,80 +3352,9 @@ std::shared_ptr<cxx::IStatement> RestrictedParser::parseTypedefDecl()
   return decl;
 }
 
-// @TODO: avoid this awful copy/paste
-static bool are_equiv_param(const cxx::FunctionParameter& a, const cxx::FunctionParameter& b)
-{
-  return a.type == b.type;
-}
-
-static bool are_equiv_func(const cxx::Function& a, const cxx::Function& b)
-{
-  if (a.name != b.name)
-    return false;
-
-  if (a.parameters.size() != b.parameters.size())
-    return false;
-
-  if (a.return_type != b.return_type)
-    return false;
-
-  for (size_t i(0); i < a.parameters.size(); ++i)
-  {
-    if (!are_equiv_param(*a.parameters.at(i), *b.parameters.at(i)))
-      return false;
-  }
-
-  return true;
-}
-
-static std::shared_ptr<cxx::Function> find_equiv_func(cxx::INode& current_node, const cxx::Function& func)
-{
-  if (current_node.is<cxx::Class>())
-  {
-    for (const auto& m : static_cast<cxx::Class&>(current_node).members)
-    {
-      if (m->is<cxx::Function>())
-      {
-        if (are_equiv_func(static_cast<cxx::Function&>(*m), func))
-          return std::static_pointer_cast<cxx::Function>(m);
-      }
-    }
-  }
-  else if (current_node.is<cxx::Namespace>())
-  {
-    for (const auto& m : static_cast<cxx::Namespace&>(current_node).entities)
-    {
-      if (m->is<cxx::Function>())
-      {
-        if (are_equiv_func(static_cast<cxx::Function&>(*m), func))
-          return std::static_pointer_cast<cxx::Function>(m);
-      }
-    }
-  }
-
-  return nullptr;
-}
-
-static void update_func(cxx::Function& func, const cxx::Function& new_one)
-{
-  for (size_t i(0); i < func.parameters.size(); ++i)
-  {
-    if (func.parameters.at(i)->default_value == cxx::Expression())
-    {
-      if (new_one.parameters.at(i)->default_value != cxx::Expression())
-        func.parameters.at(i)->default_value = new_one.parameters.at(i)->default_value;
-    }
-  }
-
-  if (func.body.isNull() && !new_one.body.isNull())
-  {
-    func.body = new_one.body;
-  }
-}
-
 std::shared_ptr<cxx::FunctionDeclaration> RestrictedParser::parseFunctionDecl()
 {
-  auto decl = std::make_shared<FunctionDeclaration>();
+  auto decl = make<FunctionDeclaration>();
 
   Token first_tok = peek();
 
@@ -2229,7 +3407,7 @@ std::shared_ptr<cxx::FunctionDeclaration> RestrictedParser::parseFunctionDecl()
 
 std::shared_ptr<cxx::VariableDeclaration> RestrictedParser::parseVarDecl()
 {
-  auto decl = std::make_shared<VariableDeclaration>();
+  auto decl = make<VariableDeclaration>();
 
   Token first_tok = peek();
 
@@ -2260,18 +3438,38 @@ std::shared_ptr<cxx::VariableDeclaration> RestrictedParser::parseVarDecl()
   return decl;
 }
 
+// The expression refers to its text in the source instead of copying it.
 Expression RestrictedParser::parseExpression()
 {
-  std::string default_val = stringtoend();
-
-  if (default_val.back() == ';')
-    default_val.pop_back();
+  size_t begin = 0;
+  size_t end = 0;
 
-  Expression result{ std::move(default_val) };
+  if (!atEnd())
+  {
+    Token last = m_buffer[m_view.second - 1];
+    begin = pos(unsafe_peek());
+    end = last == TokenType::Semicolon ? pos(last) : pos(last) + last.text().size();
+  }
 
   m_index = m_view.second;
 
-  return result;
+  std::shared_ptr<const char> source = sharedSource();
+  return Expression{ make<UnexposedExpression>(std::shared_ptr<const char>(source, source.get() + begin), end - begin) };
+}
+
+// The source is shared by the expressions parsed from it.
+// It is copied once per file: the buffer being parsed may map a file
+// that can be truncated or edited once the parse is over.
+std::shared_ptr<const char> RestrictedParser::sharedSource()
+{
+  if (!m_shared_source)
+  {
+    const StringView source = m_lexer.source();
+    auto copy = std::make_shared<const std::string>(source.data(), source.size());
+    m_shared_source = std::shared_ptr<const char>(copy, copy->data());
+  }
+
+  return m_shared_source;
 }
 
 } // namespace parsers
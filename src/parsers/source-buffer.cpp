@@ -0,0 +1,206 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/source-buffer.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <Windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+#if defined(_WIN32)
+
+static const char* map_file(const std::string& filepath, size_t& size)
+{
+  HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+  if (file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error{ "SourceBuffer::open() : could not open " + filepath };
+
+  LARGE_INTEGER file_size;
+  const char* result = nullptr;
+
+  if (GetFileSizeEx(file, &file_size))
+  {
+    size = static_cast<size_t>(file_size.QuadPart);
+
+    if (size == 0)
+      result = "";
+    else if (HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr))
+    {
+      result = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      CloseHandle(mapping);
+    }
+  }
+
+  CloseHandle(file);
+  return result;
+}
+
+static void unmap_file(const char* data, size_t /* size */)
+{
+  UnmapViewOfFile(data);
+}
+
+#else
+
+static const char* map_file(const std::string& filepath, size_t& size)
+{
+  int fd = ::open(filepath.c_str(), O_RDONLY);
+
+  if (fd == -1)
+    throw std::runtime_error{ "SourceBuffer::open() : could not open " + filepath };
+
+  struct stat st;
+  const char* result = nullptr;
+
+  if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+  {
+    size = static_cast<size_t>(st.st_size);
+
+    if (size == 0)
+    {
+      result = "";
+    }
+    else
+    {
+      void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (addr != MAP_FAILED)
+      {
+        ::madvise(addr, size, MADV_SEQUENTIAL);
+        result = static_cast<const char*>(addr);
+      }
+    }
+  }
+
+  ::close(fd);
+  return result;
+}
+
+static void unmap_file(const char* data, size_t size)
+{
+  ::munmap(const_cast<char*>(data), size);
+}
+
+#endif
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept
+  : m_data(other.m_data),
+    m_size(other.m_size),
+    m_storage(other.m_storage)
+{
+  other.m_data = "";
+  other.m_size = 0;
+  other.m_storage = View;
+}
+
+SourceBuffer::~SourceBuffer()
+{
+  clear();
+}
+
+SourceBuffer SourceBuffer::view(const char* data, size_t size)
+{
+  SourceBuffer result;
+  result.m_data = data;
+  result.m_size = size;
+  return result;
+}
+
+SourceBuffer SourceBuffer::view(const std::string& str)
+{
+  return view(str.data(), str.size());
+}
+
+SourceBuffer SourceBuffer::open(const std::string& filepath)
+{
+  SourceBuffer result;
+
+  size_t size = 0;
+  const char* data = map_file(filepath, size);
+
+  if (data)
+  {
+    result.m_data = data;
+    result.m_size = size;
+    result.m_storage = size > 0 ? Mapped : View;
+    return result;
+  }
+
+  // the file could not be mapped (e.g. it is not a regular file),
+  // fallback to reading it in one go
+  std::ifstream stream{ filepath, std::ios::binary | std::ios::ate };
+
+  if (!stream.is_open())
+    throw std::runtime_error{ "SourceBuffer::open() : could not open " + filepath };
+
+  size = static_cast<size_t>(stream.tellg());
+  stream.seekg(0);
+
+  if (size == 0)
+    return result;
+
+  char* buffer = new char[size];
+
+  if (!stream.read(buffer, size))
+  {
+    delete[] buffer;
+    throw std::runtime_error{ "SourceBuffer::open() : could not read " + filepath };
+  }
+
+  result.m_data = buffer;
+  result.m_size = size;
+  result.m_storage = Allocated;
+  return result;
+}
+
+void SourceBuffer::clear()
+{
+  if (m_storage == Mapped)
+    unmap_file(m_data, m_size);
+  else if (m_storage == Allocated)
+    delete[] m_data;
+
+  m_data = "";
+  m_size = 0;
+  m_storage = View;
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept
+{
+  if (this != &other)
+  {
+    clear();
+
+    m_data = other.m_data;
+    m_size = other.m_size;
+    m_storage = other.m_storage;
+
+    other.m_data = "";
+    other.m_size = 0;
+    other.m_storage = View;
+  }
+
+  return *this;
+}
+
+} // namespace parsers
+
+} // namespace cxx
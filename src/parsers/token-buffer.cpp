@@ -0,0 +1,132 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/token-buffer.h"
+
+#include "cxx/parsers/lexer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+void TokenBuffer::reset(StringView source)
+{
+  if (source.size() > std::numeric_limits<std::uint32_t>::max())
+    throw std::runtime_error{ "TokenBuffer::reset() : source is too large" };
+
+  m_source = source;
+  m_tokens.clear();
+  m_line_offsets.clear();
+}
+
+void TokenBuffer::clear()
+{
+  m_tokens.clear();
+}
+
+void TokenBuffer::push_back(const Token& tok)
+{
+  m_tokens.push_back(pack(tok));
+}
+
+// Both buffers must have the same source.
+void TokenBuffer::append(const TokenBuffer& other)
+{
+  assert(other.m_source.data() == m_source.data());
+  m_tokens.insert(m_tokens.end(), other.m_tokens.begin(), other.m_tokens.end());
+}
+
+void TokenBuffer::insert(size_t index, const Token& tok)
+{
+  m_tokens.insert(m_tokens.begin() + index, pack(tok));
+}
+
+void TokenBuffer::erase(size_t index)
+{
+  m_tokens.erase(m_tokens.begin() + index);
+}
+
+void TokenBuffer::set(size_t index, const Token& tok)
+{
+  m_tokens[index] = pack(tok);
+}
+
+// Replaces the tokens in [first, last) by 'tokens', whose source becomes 
+// the source of this buffer, and moves the tokens after them by 'shift' bytes.
+void TokenBuffer::splice(size_t first, size_t last, const TokenBuffer& tokens, std::ptrdiff_t shift)
+{
+  for (auto it = m_tokens.begin() + last; it != m_tokens.end(); ++it)
+    it->offset = static_cast<std::uint32_t>(it->offset + shift);
+
+  const size_t removed = last - first;
+  const size_t inserted = tokens.size();
+
+  if (inserted > removed)
+    m_tokens.insert(m_tokens.begin() + last, inserted - removed, PackedToken());
+  else
+    m_tokens.erase(m_tokens.begin() + first + inserted, m_tokens.begin() + last);
+
+  std::copy(tokens.m_tokens.begin(), tokens.m_tokens.end(), m_tokens.begin() + first);
+
+  m_source = tokens.m_source;
+  m_line_offsets.clear();
+}
+
+StringView TokenBuffer::text(size_t index) const
+{
+  const PackedToken& tok = m_tokens[index];
+  return StringView(m_source.data() + tok.offset, tok.length);
+}
+
+// The returned token has no line and column,
+// use line() and col() with the token's offset instead.
+Token TokenBuffer::at(size_t index) const
+{
+  const PackedToken& tok = m_tokens.at(index);
+  return Token(tok.type, StringView(m_source.data() + tok.offset, tok.length));
+}
+
+int TokenBuffer::line(size_t offset) const
+{
+  const std::vector<std::uint32_t>& lines = lineOffsets();
+  auto it = std::upper_bound(lines.begin(), lines.end(), offset);
+  return static_cast<int>(std::distance(lines.begin(), it) - 1);
+}
+
+int TokenBuffer::col(size_t offset) const
+{
+  const std::vector<std::uint32_t>& lines = lineOffsets();
+  auto it = std::upper_bound(lines.begin(), lines.end(), offset);
+  return static_cast<int>(offset - *(it - 1));
+}
+
+PackedToken TokenBuffer::pack(const Token& tok) const
+{
+  assert(tok.text().data() >= m_source.data() && tok.text().data() + tok.text().size() <= m_source.data() + m_source.size());
+
+  PackedToken result;
+  result.offset = static_cast<std::uint32_t>(tok.text().data() - m_source.data());
+  result.length = static_cast<std::uint32_t>(tok.text().size());
+  result.type = tok.type().value();
+  return result;
+}
+
+const std::vector<std::uint32_t>& TokenBuffer::lineOffsets() const
+{
+  if (m_line_offsets.empty())
+    m_line_offsets = Lexer::lineOffsets(m_source);
+
+  return m_line_offsets;
+}
+
+} // namespace parsers
+
+} // namespace cxx
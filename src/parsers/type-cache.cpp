@@ -0,0 +1,109 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/parsers/type-cache.h"
+
+#include <mutex>
+
+namespace cxx
+{
+
+namespace parsers
+{
+
+TypeCache::TypeCache(size_t capacity)
+  : m_capacity(capacity)
+{
+
+}
+
+TypeCache& TypeCache::GlobalInstance()
+{
+  static TypeCache cache;
+  return cache;
+}
+
+bool TypeCache::find(const std::string& spelling, Type& result)
+{
+  {
+    std::shared_lock<std::shared_timed_mutex> lock{ m_mutex };
+
+    auto it = m_types.find(spelling);
+
+    if (it != m_types.end())
+    {
+      result = it->second;
+      ++m_hits;
+      return true;
+    }
+  }
+
+  ++m_misses;
+  return false;
+}
+
+void TypeCache::insert(const std::string& spelling, const Type& type)
+{
+  std::unique_lock<std::shared_timed_mutex> lock{ m_mutex };
+
+  if (m_capacity == 0)
+    return;
+
+  if (m_types.size() >= m_capacity)
+    m_types.clear();
+
+  m_types.emplace(spelling, type);
+}
+
+// Returns the cached type that has the same spelling as 'type',
+// or caches 'type' and returns it.
+Type TypeCache::intern(const Type& type)
+{
+  const std::string spelling = type.toString();
+  Type result;
+
+  if (find(spelling, result))
+    return result;
+
+  insert(spelling, type);
+  return type;
+}
+
+size_t TypeCache::size() const
+{
+  std::shared_lock<std::shared_timed_mutex> lock{ m_mutex };
+  return m_types.size();
+}
+
+size_t TypeCache::capacity() const
+{
+  std::shared_lock<std::shared_timed_mutex> lock{ m_mutex };
+  return m_capacity;
+}
+
+void TypeCache::setCapacity(size_t capacity)
+{
+  std::unique_lock<std::shared_timed_mutex> lock{ m_mutex };
+
+  m_capacity = capacity;
+
+  if (m_types.size() > m_capacity)
+    m_types.clear();
+}
+
+void TypeCache::clear()
+{
+  std::unique_lock<std::shared_timed_mutex> lock{ m_mutex };
+  m_types.clear();
+}
+
+void TypeCache::resetCounters()
+{
+  m_hits = 0;
+  m_misses = 0;
+}
+
+} // namespace parsers
+
+} // namespace cxx
@@ -22,7 +22,7 @@ Program::~Program()
 
 }
 
-static std::shared_ptr<IEntity> resolve_impl(const std::string& name, const std::shared_ptr<IEntity>& context)
+static std::shared_ptr<IEntity> resolve_impl(Symbol name, const std::shared_ptr<IEntity>& context)
 {
   if (!context)
     return nullptr;
@@ -65,7 +65,7 @@ std::shared_ptr<IEntity> Program::resolve(const Name& n, const std::shared_ptr<I
   if (!context)
     return nullptr;
 
-  std::string name = n.toString();
+  Symbol name = n.toString();
 
   return resolve_impl(name, context);
 }
@@ -0,0 +1,167 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "cxx/symbol.h"
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace cxx
+{
+
+namespace
+{
+
+struct SymbolKey
+{
+  const char* data;
+  size_t size;
+};
+
+struct SymbolKeyHash
+{
+  size_t operator()(const SymbolKey& k) const
+  {
+    // FNV-1a
+    size_t h = static_cast<size_t>(14695981039346656037ull);
+
+    for (size_t i(0); i < k.size; ++i)
+    {
+      h ^= static_cast<unsigned char>(k.data[i]);
+      h *= static_cast<size_t>(1099511628211ull);
+    }
+
+    return h;
+  }
+};
+
+struct SymbolKeyEqual
+{
+  bool operator()(const SymbolKey& lhs, const SymbolKey& rhs) const
+  {
+    return lhs.size == rhs.size && std::memcmp(lhs.data, rhs.data, lhs.size) == 0;
+  }
+};
+
+// The strings are stored in fixed-size chunks that are never reallocated,
+// so that str() can read them without taking the lock.
+class SymbolTable
+{
+public:
+  static constexpr size_t ChunkBits = 12;
+  static constexpr size_t ChunkSize = size_t(1) << ChunkBits;
+  static constexpr size_t MaxChunks = size_t(1) << 16;
+
+  SymbolTable()
+  {
+    for (auto& c : m_chunks)
+      c.store(nullptr, std::memory_order_relaxed);
+
+    // id 0 is the empty string
+    m_chunks[0].store(new std::string[ChunkSize], std::memory_order_release);
+    m_count = 1;
+  }
+
+  ~SymbolTable()
+  {
+    for (auto& c : m_chunks)
+      delete[] c.load(std::memory_order_relaxed);
+  }
+
+  std::uint32_t intern(const char* str, size_t size)
+  {
+    if (size == 0)
+      return 0;
+
+    const SymbolKey key{ str, size };
+
+    {
+      std::shared_lock<std::shared_timed_mutex> lock{ m_mutex };
+      auto it = m_ids.find(key);
+
+      if (it != m_ids.end())
+        return it->second;
+    }
+
+    std::unique_lock<std::shared_timed_mutex> lock{ m_mutex };
+
+    auto it = m_ids.find(key);
+
+    if (it != m_ids.end())
+      return it->second;
+
+    if (m_count == ChunkSize * MaxChunks)
+      throw std::runtime_error{ "Symbol : too many symbols" };
+
+    const size_t id = m_count;
+    std::atomic<std::string*>& chunk = m_chunks[id >> ChunkBits];
+
+    if (chunk.load(std::memory_order_relaxed) == nullptr)
+      chunk.store(new std::string[ChunkSize], std::memory_order_release);
+
+    std::string& stored = chunk.load(std::memory_order_relaxed)[id & (ChunkSize - 1)];
+    stored.assign(str, size);
+
+    m_ids[SymbolKey{ stored.data(), stored.size() }] = static_cast<std::uint32_t>(id);
+    m_count = id + 1;
+
+    return static_cast<std::uint32_t>(id);
+  }
+
+  const std::string& get(std::uint32_t id) const
+  {
+    return m_chunks[id >> ChunkBits].load(std::memory_order_acquire)[id & (ChunkSize - 1)];
+  }
+
+  size_t count() const
+  {
+    std::shared_lock<std::shared_timed_mutex> lock{ m_mutex };
+    return m_count;
+  }
+
+private:
+  mutable std::shared_timed_mutex m_mutex;
+  std::unordered_map<SymbolKey, std::uint32_t, SymbolKeyHash, SymbolKeyEqual> m_ids;
+  size_t m_count = 0;
+  std::atomic<std::string*> m_chunks[MaxChunks];
+};
+
+SymbolTable& symbol_table()
+{
+  static SymbolTable table;
+  return table;
+}
+
+} // namespace
+
+Symbol::Symbol(const char* str, size_t size)
+  : m_id(symbol_table().intern(str, size))
+{
+
+}
+
+Symbol Symbol::fromId(std::uint32_t id)
+{
+  if (id >= symbol_table().count())
+    throw std::out_of_range{ "Symbol::fromId() : invalid id" };
+
+  Symbol result;
+  result.m_id = id;
+  return result;
+}
+
+size_t Symbol::count()
+{
+  return symbol_table().count();
+}
+
+const std::string& Symbol::str() const
+{
+  return symbol_table().get(m_id);
+}
+
+} // namespace cxx
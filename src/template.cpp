@@ -19,14 +19,14 @@ TemplateParameter::TemplateParameter()
   std::get<TemplateNonTypeParameter>(m_data).type = Type::Auto;
 }
 
-TemplateParameter::TemplateParameter(std::string name, Type default_value)
+TemplateParameter::TemplateParameter(Symbol name, Type default_value)
   : IEntity(std::move(name)), 
     m_is_type_parameter(false)
 {
   std::get<TemplateTypeParameter>(m_data).default_value = default_value;
 }
 
-TemplateParameter::TemplateParameter(const Type& type, std::string name, std::string default_value)
+TemplateParameter::TemplateParameter(const Type& type, Symbol name, std::string default_value)
   : IEntity(std::move(name)), 
     m_is_type_parameter(false)
 {
@@ -96,8 +96,8 @@ std::shared_ptr<const IType> IType::withoutCV() const
 }
 
 
-SimpleType::SimpleType(std::string name)
-  : m_name(std::move(name))
+SimpleType::SimpleType(Symbol name)
+  : m_name(name)
 {
 
 }
@@ -4,8 +4,14 @@
 
 #include "catch.hpp"
 
+#include "cxx/class.h"
+#include "cxx/namespace.h"
+#include "cxx/symbol.h"
 #include "cxx/while-loop.h"
 
+#include <thread>
+#include <vector>
+
 TEST_CASE("The Handle class can hold a WhileLoop", "[api]")
 {
   auto w = std::make_shared<cxx::WhileLoop>();
@@ -24,3 +30,69 @@ TEST_CASE("The Handle class can hold a WhileLoop", "[api]")
 
   REQUIRE(w->condition.toString() == "false");
 }
+
+TEST_CASE("Symbols are interned strings", "[api]")
+{
+  cxx::Symbol empty;
+  REQUIRE(empty.empty());
+  REQUIRE(empty.id() == 0);
+  REQUIRE(empty.str() == "");
+  REQUIRE(cxx::Symbol("") == empty);
+
+  cxx::Symbol a{ "foo" };
+  cxx::Symbol b{ std::string("foo") };
+  cxx::Symbol c{ "foobar", 3 };
+
+  REQUIRE(a.id() != 0);
+  REQUIRE(a.id() == b.id());
+  REQUIRE(a.id() == c.id());
+  REQUIRE(&a.str() == &b.str());
+
+  REQUIRE(a == "foo");
+  REQUIRE(std::string("foo") == a);
+  REQUIRE(a != cxx::Symbol("bar"));
+  REQUIRE(cxx::Symbol("bar") < a);
+  REQUIRE(a + "bar" == "foobar");
+
+  REQUIRE(cxx::Symbol::fromId(a.id()) == a);
+  REQUIRE_THROWS(cxx::Symbol::fromId(static_cast<std::uint32_t>(cxx::Symbol::count())));
+}
+
+TEST_CASE("Symbols can be interned from several threads", "[api]")
+{
+  const int nb_threads = 4;
+  const int nb_names = 5000;
+
+  std::vector<std::vector<std::uint32_t>> ids{ nb_threads };
+  std::vector<std::thread> threads;
+
+  for (int t(0); t < nb_threads; ++t)
+  {
+    threads.emplace_back([t, &ids]() {
+      for (int i(0); i < nb_names; ++i)
+        ids[t].push_back(cxx::Symbol("symbol_" + std::to_string(i)).id());
+      });
+  }
+
+  for (std::thread& th : threads)
+    th.join();
+
+  for (int t(1); t < nb_threads; ++t)
+    REQUIRE(ids[t] == ids[0]);
+
+  for (int i(0); i < nb_names; ++i)
+    REQUIRE(cxx::Symbol::fromId(ids[0][i]).str() == "symbol_" + std::to_string(i));
+}
+
+TEST_CASE("Entities share their names through symbols", "[api]")
+{
+  auto global = std::make_shared<cxx::Namespace>("");
+  auto ns = global->getOrCreateNamespace("foo");
+  auto cla = ns->getOrCreateClass("bar");
+
+  REQUIRE(global->getOrCreateNamespace(std::string("foo")) == ns);
+  REQUIRE(ns->getOrCreateClass("bar") == cla);
+  REQUIRE(cla->name == cxx::Symbol("bar"));
+  REQUIRE(cla->name == "bar");
+  REQUIRE(ns->entities.size() == 1);
+}
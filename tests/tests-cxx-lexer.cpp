@@ -0,0 +1,543 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "cxx/parsers/delimiter-index.h"
+#include "cxx/parsers/lexer.h"
+#include "cxx/parsers/token-buffer.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace cxx::parsers;
+
+static std::vector<Token> tokenize(const std::string& src, Lexer::InstructionSet iset)
+{
+  Lexer lexer;
+  lexer.setInstructionSet(iset);
+  lexer.reset(&src);
+
+  std::vector<Token> result;
+
+  while (!lexer.atEnd())
+    result.push_back(lexer.read());
+
+  return result;
+}
+
+static bool same_tokens(const std::vector<Token>& a, const std::vector<Token>& b)
+{
+  if (a.size() != b.size())
+    return false;
+
+  for (size_t i(0); i < a.size(); ++i)
+  {
+    if (a.at(i) != b.at(i) || a.at(i).line() != b.at(i).line() || a.at(i).col() != b.at(i).col())
+      return false;
+  }
+
+  return true;
+}
+
+TEST_CASE("The lexer produces the same tokens with every instruction set", "[lexer]")
+{
+  std::string src =
+    "// Copyright (C) 2021 ****************************************************\n"
+    "/* multi-line comment with * and / inside\n"
+    "   spanning *several* lines                                          **/\n"
+    "\n"
+    "\t\t  \r\n"
+    "int main()                                                         \n"
+    "{                                                                  \n"
+    "  /**/ int a = 0;/*x*/                                               \n"
+    "                                                                   return a;//\n"
+    "}";
+
+  for (int i(0); i < 8; ++i)
+    src += src;
+
+  src += "                                                    \n\n\n   ";
+
+  std::vector<Token> expected = tokenize(src, Lexer::Scalar);
+
+  REQUIRE(expected.size() == 256 * 19);
+  REQUIRE(same_tokens(expected, tokenize(src, Lexer::SSE2)));
+  REQUIRE(same_tokens(expected, tokenize(src, Lexer::AVX2)));
+}
+
+TEST_CASE("The lexer reports unterminated comments with every instruction set", "[lexer]")
+{
+  const std::string src = "int a; /* this comment is never terminated                             *";
+
+  for (Lexer::InstructionSet iset : { Lexer::Scalar, Lexer::SSE2, Lexer::AVX2 })
+  {
+    Lexer lexer;
+    lexer.setInstructionSet(iset);
+    lexer.reset(&src);
+
+    lexer.read();
+    lexer.read();
+    lexer.read();
+    REQUIRE_THROWS(lexer.read());
+  }
+}
+
+TEST_CASE("The lexer recognizes keywords and operators", "[lexer]")
+{
+  std::string src = "auto bool break case catch char class const constexpr continue default delete do double else enum explicit export false final float for friend if import inline int mutable namespace noexcept operator override private protected public return static struct template this throw true try typedef typeid typename using virtual void while";
+
+  std::vector<Token> tokens = tokenize(src, Lexer::supportedInstructionSet());
+  REQUIRE(tokens.size() == 50);
+
+  for (const Token& tok : tokens)
+  {
+    REQUIRE(tok.isKeyword());
+  }
+
+  REQUIRE(tokens.front() == TokenType::Auto);
+  REQUIRE(tokens.at(8) == TokenType::Constexpr);
+  REQUIRE(tokens.at(28) == TokenType::Namespace);
+  REQUIRE(tokens.back() == TokenType::While);
+
+  src = "a au autos dp iff tru truee whilee constexp namespaces Int _do";
+  tokens = tokenize(src, Lexer::supportedInstructionSet());
+  REQUIRE(tokens.size() == 12);
+
+  for (const Token& tok : tokens)
+  {
+    REQUIRE(tok == TokenType::UserDefinedName);
+  }
+
+  src = "a<<=b>>c->d!=e&&f|=++g--<h>=i===j";
+  tokens = tokenize(src, Lexer::supportedInstructionSet());
+
+  std::vector<TokenType> expected = {
+    TokenType::UserDefinedName, TokenType::LeftShiftEq, TokenType::UserDefinedName, TokenType::RightShift,
+    TokenType::UserDefinedName, TokenType::Minus, TokenType::GreaterThan, TokenType::UserDefinedName,
+    TokenType::Neq, TokenType::UserDefinedName, TokenType::LogicalAnd, TokenType::UserDefinedName,
+    TokenType::BitOrEq, TokenType::PlusPlus, TokenType::UserDefinedName, TokenType::MinusMinus,
+    TokenType::Less, TokenType::UserDefinedName, TokenType::GreaterThanEqual, TokenType::UserDefinedName,
+    TokenType::EqEq, TokenType::Eq, TokenType::UserDefinedName,
+  };
+
+  REQUIRE(tokens.size() == expected.size());
+
+  for (size_t i(0); i < tokens.size(); ++i)
+  {
+    REQUIRE(tokens.at(i).type() == expected.at(i));
+  }
+
+  REQUIRE(tokens.at(1).text() == "<<=");
+  REQUIRE(tokens.at(1).col() == 1);
+}
+
+TEST_CASE("The lexer tracks lines across multi-line comments", "[lexer]")
+{
+  const std::string src = "a /* b\n c\n */ d+\ne";
+
+  for (Lexer::InstructionSet iset : { Lexer::Scalar, Lexer::SSE2, Lexer::AVX2 })
+  {
+    std::vector<Token> tokens = tokenize(src, iset);
+    REQUIRE(tokens.size() == 5);
+
+    REQUIRE(tokens.at(1) == TokenType::MultiLineComment);
+    REQUIRE(tokens.at(1).line() == 0);
+    REQUIRE(tokens.at(1).col() == 2);
+
+    REQUIRE(tokens.at(2).text() == "d");
+    REQUIRE(tokens.at(2).line() == 2);
+    REQUIRE(tokens.at(2).col() == 4);
+
+    REQUIRE(tokens.at(3) == TokenType::Plus);
+    REQUIRE(tokens.at(3).col() == 5);
+
+    REQUIRE(tokens.at(4).line() == 3);
+    REQUIRE(tokens.at(4).col() == 0);
+  }
+}
+
+TEST_CASE("The lexer reads files without copying them", "[lexer]")
+{
+  {
+    std::ofstream file{ "test-lexer.cpp" };
+    file << "int main()\n{\n  return 0;\n}\n";
+  }
+
+  SourceBuffer buffer = SourceBuffer::open("test-lexer.cpp");
+  REQUIRE(buffer.size() == 27);
+  REQUIRE(buffer.isMapped());
+
+  Lexer lexer{ buffer };
+  lexer.start();
+
+  std::vector<Token> tokens;
+
+  while (!lexer.atEnd())
+    tokens.push_back(lexer.read());
+
+  REQUIRE(tokens.size() == 9);
+  REQUIRE(tokens.at(5).text() == "return");
+  REQUIRE(tokens.at(5).line() == 2);
+
+  for (const Token& tok : tokens)
+  {
+    REQUIRE(tok.text().data() >= buffer.data());
+    REQUIRE(tok.text().data() + tok.text().size() <= buffer.data() + buffer.size());
+  }
+
+  SourceBuffer moved = std::move(buffer);
+  REQUIRE(buffer.empty());
+  REQUIRE(moved.data() == tokens.front().text().data());
+
+  REQUIRE_THROWS(SourceBuffer::open("this-file-does-not-exist.cpp"));
+}
+
+TEST_CASE("The token buffer computes the same positions as the lexer", "[lexer]")
+{
+  std::string src =
+    "/* header\n * comment */\n"
+    "namespace ns\n"
+    "{\n"
+    "\tint foo(int a, int b)   // sum\n"
+    "\t{\n"
+    "\t\treturn a +\n b;\n"
+    "\t}\n"
+    "}\n";
+
+  for (int i(0); i < 4; ++i)
+    src += src;
+
+  std::vector<std::uint32_t> lines = Lexer::lineOffsets(StringView(src.data(), src.size()));
+  REQUIRE(lines.size() == 16 * 10 + 1);
+  REQUIRE(lines.at(0) == 0);
+  REQUIRE(lines.at(1) == 10);
+
+  std::vector<Token> tokens = tokenize(src, Lexer::supportedInstructionSet());
+
+  TokenBuffer buffer;
+  buffer.reset(StringView(src.data(), src.size()));
+
+  for (const Token& tok : tokens)
+    buffer.push_back(tok);
+
+  REQUIRE(buffer.size() == tokens.size());
+
+  for (size_t i(0); i < tokens.size(); ++i)
+  {
+    REQUIRE(buffer[i] == tokens.at(i));
+    REQUIRE(buffer.line(buffer.offset(i)) == tokens.at(i).line());
+    REQUIRE(buffer.col(buffer.offset(i)) == tokens.at(i).col());
+  }
+}
+
+TEST_CASE("The delimiter index matches the delimiters of a token buffer", "[lexer]")
+{
+  const std::string src =
+    "f(a[1], { b, c }); "
+    "std::map<int, std::vector<int>> m; "
+    "x = (a < b) + (c[d < e]); "
+    "g(1 >> 2 > 3); "
+    "y < z; ";
+
+  TokenBuffer buffer;
+  buffer.reset(StringView(src.data(), src.size()));
+
+  for (const Token& tok : tokenize(src, Lexer::supportedInstructionSet()))
+    buffer.push_back(tok);
+
+  // index of the n-th token with the given text
+  auto index_of = [&](const std::string& text, int n) -> size_t {
+    for (size_t i(0); i < buffer.size(); ++i)
+    {
+      if (buffer.text(i) == text && n-- == 0)
+        return i;
+    }
+
+    return DelimiterIndex::npos;
+  };
+
+  DelimiterIndex index;
+  index.build(buffer);
+
+  REQUIRE(index.nested());
+  REQUIRE(index.closing(index_of("(", 0)) == index_of(")", 0));
+  REQUIRE(index.closing(index_of("[", 0)) == index_of("]", 0));
+  REQUIRE(index.closing(index_of("{", 0)) == index_of("}", 0));
+
+  REQUIRE(index.angle(index_of("<", 0)).status == DelimiterIndex::MatchedShift);
+  REQUIRE(index.angle(index_of("<", 0)).index == index_of(">>", 0));
+  REQUIRE(index.angle(index_of("<", 1)).status == DelimiterIndex::MatchedNested);
+  REQUIRE(index.angle(index_of("<", 1)).index == index_of(">>", 0));
+  REQUIRE(index.angle(index_of("<", 2)).status == DelimiterIndex::UnmatchedParen);
+  REQUIRE(index.angle(index_of("<", 2)).index == index_of(")", 1));
+  REQUIRE(index.angle(index_of("<", 3)).status == DelimiterIndex::UnmatchedBracket);
+  REQUIRE(index.angle(index_of("<", 4)).status == DelimiterIndex::Unmatched);
+
+  buffer.push_back(Token(TokenType::RightPar, StringView(src.data(), 1)));
+  index.build(buffer);
+
+  REQUIRE(!index.nested());
+  REQUIRE(index.angle(index_of("<", 0)).status == DelimiterIndex::Unknown);
+}
+
+TEST_CASE("The lexer can split a source at safe boundaries", "[lexer]")
+{
+  std::string src =
+    "/* a comment with a \"quote\n"
+    "   spanning several lines */\n"
+    "const char* s = \"// not a comment /* \\\" still a string\";\n"
+    "char c = '\"'; char d = '/';\n"
+    "int a = b / c; // a comment with a \" and a /*\n"
+    "\n";
+
+  while (src.size() < 64 * 1024)
+    src += src;
+
+  const StringView source{ src.data(), src.size() };
+  std::vector<Token> expected = tokenize(src, Lexer::supportedInstructionSet());
+
+  for (size_t chunks : { 2, 3, 8, 64 })
+  {
+    std::vector<size_t> bounds = Lexer::splitPoints(source, chunks);
+    REQUIRE(bounds.size() == chunks - 1);
+
+    bounds.insert(bounds.begin(), 0);
+    bounds.push_back(src.size());
+
+    std::vector<Token> tokens;
+
+    for (size_t i(0); i < bounds.size() - 1; ++i)
+    {
+      REQUIRE(bounds.at(i) < bounds.at(i + 1));
+      REQUIRE((bounds.at(i) == 0 || src.at(bounds.at(i) - 1) == '\n'));
+
+      Lexer lexer;
+      lexer.reset(src.data() + bounds.at(i), bounds.at(i + 1) - bounds.at(i));
+
+      while (!lexer.atEnd())
+        tokens.push_back(lexer.read());
+    }
+
+    REQUIRE(tokens.size() == expected.size());
+
+    for (size_t i(0); i < tokens.size(); ++i)
+    {
+      REQUIRE(tokens.at(i) == expected.at(i));
+      REQUIRE(tokens.at(i).text().data() == expected.at(i).text().data());
+    }
+  }
+
+  src += "/* unterminated comment\n\n\n";
+  REQUIRE(Lexer::splitPoints(StringView(src.data(), src.size()), 2).size() == 1);
+  REQUIRE(Lexer::splitPoints(StringView(src.data() + src.size() - 30, 30), 2).empty());
+}
+
+TEST_CASE("The lexer can report errors with tokens", "[lexer]")
+{
+  const std::string src =
+    "#include <vector>\n"
+    "int a = 0x; char c = '\\n';\n"
+    "const char* s = \"unterminated\n"
+    "float f = 1.; @ b;\n"
+    "/* unterminated";
+
+  for (Lexer::InstructionSet iset : { Lexer::Scalar, Lexer::SSE2, Lexer::AVX2 })
+  {
+    Lexer lexer;
+    lexer.setInstructionSet(iset);
+    lexer.setErrorMode(Lexer::ErrorTokens);
+    lexer.reset(&src);
+
+    std::vector<Token> tokens;
+    std::vector<Lexer::Error> errors;
+
+    while (!lexer.atEnd())
+    {
+      tokens.push_back(lexer.read());
+
+      if (tokens.back() == TokenType::Invalid)
+        errors.push_back(lexer.error());
+      else
+        REQUIRE(lexer.error() == Lexer::NoError);
+    }
+
+    REQUIRE(errors.size() == 6);
+    REQUIRE(errors.at(0) == Lexer::UnexpectedCharacter);
+    REQUIRE(errors.at(1) == Lexer::MalformedNumericLiteral);
+    REQUIRE(errors.at(2) == Lexer::MalformedCharLiteral);
+    REQUIRE(errors.at(3) == Lexer::UnterminatedStringLiteral);
+    REQUIRE(errors.at(4) == Lexer::UnexpectedCharacter);
+    REQUIRE(errors.at(5) == Lexer::UnterminatedComment);
+
+    REQUIRE(tokens.at(0).text() == "#");
+    REQUIRE(tokens.at(1).text() == "include");
+    REQUIRE(tokens.at(13).text() == "'\\n'");
+    REQUIRE(tokens.at(14) == TokenType::Semicolon);
+    REQUIRE(tokens.at(20).text() == "\"unterminated");
+    REQUIRE(tokens.at(21).text() == "float");
+    REQUIRE(tokens.at(21).line() == 3);
+    REQUIRE(tokens.back().text() == "/* unterminated");
+    REQUIRE(tokens.back().line() == 4);
+    REQUIRE(tokens.back().col() == 0);
+
+    REQUIRE(lexer.read() == TokenType::Invalid);
+    REQUIRE(lexer.error() == Lexer::UnexpectedEndOfInput);
+
+    Lexer throwing;
+    throwing.setInstructionSet(iset);
+    throwing.reset(&src);
+    REQUIRE_THROWS(throwing.read());
+    REQUIRE(throwing.pos() == 0);
+  }
+
+  // both modes reject the same inputs, such as a new line in a char literal
+  const std::string newline = "c = '\n';";
+
+  Lexer lexer;
+  lexer.setErrorMode(Lexer::ErrorTokens);
+  lexer.reset(&newline);
+  lexer.read();
+  lexer.read();
+  REQUIRE(lexer.read() == TokenType::Invalid);
+  REQUIRE(lexer.error() == Lexer::MalformedCharLiteral);
+
+  Lexer throwing;
+  throwing.reset(&newline);
+  throwing.read();
+  throwing.read();
+  REQUIRE_THROWS(throwing.read());
+}
+
+TEST_CASE("The lexer can relex an edited source", "[lexer]")
+{
+  std::string src =
+    "// comment\n"
+    "int foo(int a, int b) /* sum */\n"
+    "{\n"
+    "  return a + b; // \"quote\n"
+    "}\n";
+
+  for (int i(0); i < 4; ++i)
+    src += src;
+
+  struct Edit { size_t offset; size_t removed; const char* inserted; };
+
+  const Edit edits[] = {
+    { 0, 0, "x" },
+    { 11, 3, "long" },          // int -> long
+    { 15, 0, "_bar" },          // extends an identifier
+    { 40, 1, "" },              // removes a char
+    { 35, 0, "/*" },            // opens a comment...
+    { 60, 0, "*/" },            // ...and closes it later on
+    { 0, 11, "" },
+    { 120, 0, "\"\"" },
+    { 200, 5, "\n\n" },
+  };
+
+  for (bool discard_comments : { false, true })
+  {
+    std::string text = src;
+
+    auto full_lex = [&](const std::string& s) {
+      TokenBuffer result;
+      result.reset(StringView(s.data(), s.size()));
+
+      for (const Token& tok : tokenize(s, Lexer::supportedInstructionSet()))
+      {
+        if (!discard_comments || (tok != TokenType::SingleLineComment && tok != TokenType::MultiLineComment))
+          result.push_back(tok);
+      }
+
+      return result;
+    };
+
+    TokenBuffer tokens = full_lex(text);
+
+    for (const Edit& e : edits)
+    {
+      std::string edited = text;
+      edited.replace(e.offset, e.removed, e.inserted);
+
+      Lexer lexer;
+      lexer.reset(&edited);
+
+      SourceEdit edit;
+      edit.offset = e.offset;
+      edit.removed = e.removed;
+      edit.inserted = std::strlen(e.inserted);
+
+      std::pair<size_t, size_t> range = lexer.relex(tokens, edit, discard_comments);
+
+      TokenBuffer expected = full_lex(edited);
+      REQUIRE(tokens.size() == expected.size());
+      REQUIRE(range.second - range.first < expected.size() / 4);
+
+      for (size_t i(0); i < expected.size(); ++i)
+      {
+        REQUIRE(tokens.offset(i) == expected.offset(i));
+        REQUIRE(tokens[i] == expected[i]);
+      }
+
+      // the buffer of 'edited' is moved into 'text', tokens remain valid
+      text.swap(edited);
+    }
+  }
+}
+
+TEST_CASE("The lexer can intern identifiers", "[lexer]")
+{
+  const std::string src = "int foo(int bar) { return foo(bar + 1); }";
+
+  Lexer lexer;
+  lexer.setInternIdentifiers(true);
+  lexer.reset(&src);
+
+  std::vector<Token> tokens;
+
+  while (!lexer.atEnd())
+    tokens.push_back(lexer.read());
+
+  REQUIRE(tokens.size() == 16);
+
+  REQUIRE(tokens.at(1).text() == "foo");
+  REQUIRE(tokens.at(1).symbol() == cxx::Symbol("foo"));
+  REQUIRE(tokens.at(1).symbol() == tokens.at(8).symbol());
+  REQUIRE(tokens.at(4).symbol() == tokens.at(10).symbol());
+  REQUIRE(tokens.at(1).symbol() != tokens.at(4).symbol());
+  REQUIRE(tokens.at(0).symbol() == "int");
+}
+
+TEST_CASE("The lexer can skip to a closing brace", "[lexer]")
+{
+  const std::string src =
+    "{ if (a) { s = \"}\"; }\n"
+    "  c = '}'; // }\n"
+    "  /* } */ n = 1'000;\n"
+    "  r = R\"x(})\")x\";\n"
+    "} e";
+
+  for (Lexer::InstructionSet iset : { Lexer::Scalar, Lexer::SSE2, Lexer::AVX2 })
+  {
+    Lexer lexer;
+    lexer.setInstructionSet(iset);
+    lexer.reset(&src);
+
+    REQUIRE(lexer.read() == TokenType::LeftBrace);
+    REQUIRE(lexer.skipBraces());
+
+    Token t = lexer.read();
+    REQUIRE(t == TokenType::RightBrace);
+    REQUIRE(t.line() == 4);
+    REQUIRE(t.col() == 0);
+    REQUIRE(lexer.read().text() == "e");
+  }
+
+  const std::string unterminated = "{ s = \"}\"; ";
+  Lexer lexer{ &unterminated };
+  lexer.read();
+  REQUIRE(!lexer.skipBraces());
+  REQUIRE(lexer.read() == TokenType::UserDefinedName);
+}
@@ -5,7 +5,9 @@
 #include "catch.hpp"
 
 #include "cxx/parsers/parser.h"
+#include "cxx/parsers/batch-parser.h"
 
+#include "cxx/filesystem.h"
 #include "cxx/program.h"
 
 #include "cxx/class.h"
@@ -13,6 +15,7 @@
 #include "cxx/statements.h"
 #include "cxx/variable.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
@@ -390,4 +393,274 @@ TEST_CASE("The parser is able to parse a simple class template", "[libclang-pars
   REQUIRE(Foo.members.front()->is<cxx::Variable>());
   REQUIRE(Foo.members.front()->name == "value");
   REQUIRE(std::static_pointer_cast<cxx::Variable>(Foo.members.front())->type().toString() == "T");
-}
\ No newline at end of file
+}
+
+TEST_CASE("The parser can reparse a file and keep its entities", "[libclang-parser]")
+{
+  if (skipTest())
+    return;
+
+  write_file("test.cpp",
+    "struct Foo { int n; };\n"
+    "int bar(int a) { return a; }\n");
+
+  cxx::parsers::LibClangParser parser;
+  parser.keep_translation_units = true;
+
+  REQUIRE(parser.parse("test.cpp"));
+
+  auto prog = parser.program();
+
+  REQUIRE(prog->globalNamespace()->entities.size() == 2);
+  std::shared_ptr<cxx::IEntity> foo = prog->globalNamespace()->entities.front();
+  std::shared_ptr<cxx::IEntity> bar = prog->globalNamespace()->entities.back();
+  REQUIRE(foo->is<cxx::Class>());
+  REQUIRE(bar->is<cxx::Function>());
+
+  REQUIRE(parser.reparse("test.cpp",
+    "struct Foo { int n; int m; };\n"
+    "int bar(int a) { return a + 1; }\n"
+    "void baz() { }\n"));
+
+  REQUIRE(prog->globalNamespace()->entities.size() == 3);
+  REQUIRE(prog->globalNamespace()->entities.at(0) == foo);
+  REQUIRE(prog->globalNamespace()->entities.at(1) == bar);
+  REQUIRE(prog->globalNamespace()->entities.at(2)->name == "baz");
+
+  REQUIRE(static_cast<cxx::Class&>(*foo).members.size() == 2);
+  REQUIRE(!static_cast<cxx::Function&>(*bar).body.isNull());
+
+  REQUIRE(parser.reparse("test.cpp", "struct Foo { int n; };\n"));
+
+  REQUIRE(prog->globalNamespace()->entities.size() == 1);
+  REQUIRE(prog->globalNamespace()->entities.front() == foo);
+
+  REQUIRE_FALSE(parser.reparse("other.cpp"));
+}
+
+TEST_CASE("The libclang parser keeps the entities another file declares when reparsing", "[libclang-parser]")
+{
+  if (skipTest())
+    return;
+
+  write_file("a.h", "void foo();\n");
+  write_file("a.cpp",
+    "#include \"a.h\"\n"
+    "void foo() { }\n"
+    "int x = 0;\n");
+
+  cxx::parsers::LibClangParser parser;
+  parser.keep_translation_units = true;
+
+  REQUIRE(parser.parse("a.cpp"));
+
+  auto global = parser.program()->globalNamespace();
+  REQUIRE(global->entities.size() == 2);
+  std::shared_ptr<cxx::IEntity> foo = global->entities.front();
+  REQUIRE(foo->name == "foo");
+
+  // the definition of foo is removed
+  REQUIRE(parser.reparse("a.cpp",
+    "#include \"a.h\"\n"
+    "int x = 0;\n"));
+
+  REQUIRE(global->entities.size() == 2);
+  REQUIRE(global->entities.front() == foo);
+  REQUIRE(static_cast<cxx::Function&>(*foo).body.isNull());
+  REQUIRE(global->entities.back()->name == "x");
+}
+
+TEST_CASE("The parser can load translation units from a cache", "[libclang-parser]")
+{
+  if (skipTest())
+    return;
+
+  write_file("test-cache.h", "struct Foo { int n; };");
+  write_file("test.cpp", "#include \"test-cache.h\"\nint bar(Foo f) { return f.n; }");
+
+  auto cache = std::make_shared<cxx::ClangTranslationUnitCache>(".");
+  cache->clear();
+
+  auto parse = [&cache]() {
+    cxx::parsers::LibClangParser parser;
+    parser.translation_unit_cache = cache;
+    REQUIRE(parser.parse("test.cpp"));
+    REQUIRE(parser.program()->globalNamespace()->entities.size() == 2);
+  };
+
+  parse();
+  REQUIRE(cache->statistics().misses == 1);
+  REQUIRE(cache->statistics().stores == 1);
+  REQUIRE(cache->count() == 1);
+
+  parse();
+  REQUIRE(cache->statistics().hits == 1);
+
+  // a change to an included file invalidates the entry
+  write_file("test-cache.h", "struct Foo { int n; int m; };");
+  parse();
+  REQUIRE(cache->statistics().hits == 1);
+  REQUIRE(cache->statistics().misses == 2);
+
+  {
+    // the index is saved with the entries
+    cxx::ClangTranslationUnitCache other{ ".", 1 };
+    REQUIRE(other.count() == 1);
+    REQUIRE(other.size() == cache->size());
+  }
+
+  cache->clear();
+  REQUIRE(cache->count() == 0);
+  REQUIRE(cache->size() == 0);
+}
+
+TEST_CASE("The batch parser can parse with libclang on several threads", "[libclang-parser]")
+{
+  if (skipTest())
+    return;
+
+  write_file("test-libclang-batch.h", "namespace bar { struct Foo { int n; }; int get(const Foo& f); }");
+
+  std::vector<std::string> files;
+
+  for (int i(0); i < 4; ++i)
+  {
+    std::string name = "test-libclang-batch-" + std::to_string(i) + ".cpp";
+    std::string content = "#include \"test-libclang-batch.h\"\nnamespace bar { int f" + std::to_string(i) + "(const Foo& f) { return get(f); } }";
+    write_file(name.c_str(), content.c_str());
+    files.push_back(name);
+  }
+
+  cxx::FileSystem fs;
+  cxx::parsers::BatchParser parser{ fs };
+  parser.use_libclang = true;
+  parser.threads = 3;
+  parser.background_priority = true;
+
+  REQUIRE(parser.parse(files));
+
+  auto prog = parser.program();
+
+  REQUIRE(prog->globalNamespace()->entities.size() == 1);
+  auto& bar = static_cast<cxx::Namespace&>(*prog->globalNamespace()->entities.front());
+
+  // Foo, get() and the four f() 
+  REQUIRE(bar.entities.size() == 6);
+  REQUIRE(bar.entities.at(0)->name == "Foo");
+  REQUIRE(bar.entities.at(1)->name == "get");
+  REQUIRE(bar.entities.at(5)->name == "f3");
+}
+
+TEST_CASE("The libclang workers of the batch parser can share the headers", "[libclang-parser]")
+{
+  if (skipTest())
+    return;
+
+  write_file("test-libclang-shared.h", "namespace bar { struct Foo { int n; int get() const; }; }");
+
+  std::vector<std::string> files;
+
+  for (int i(0); i < 4; ++i)
+  {
+    std::string name = "test-libclang-shared-" + std::to_string(i) + ".cpp";
+    std::string content = "#include \"test-libclang-shared.h\"\nnamespace bar { int f" + std::to_string(i) + "(const Foo& f) { return f.n; } }";
+
+    if (i == 0)
+      content += "\nint bar::Foo::get() const { return n; }";
+
+    write_file(name.c_str(), content.c_str());
+    files.push_back(name);
+  }
+
+  cxx::FileSystem fs;
+  cxx::parsers::BatchParser parser{ fs };
+  parser.use_libclang = true;
+  parser.share_headers = true;
+  parser.threads = 2;
+
+  REQUIRE(parser.parse(files));
+
+  auto prog = parser.program();
+
+  REQUIRE(prog->globalNamespace()->entities.size() == 1);
+  auto& bar = static_cast<cxx::Namespace&>(*prog->globalNamespace()->entities.front());
+
+  // Foo and the four f(), whatever the worker that converted the header
+  REQUIRE(bar.entities.size() == 5);
+
+  auto foo = std::find_if(bar.entities.begin(), bar.entities.end(), [](const std::shared_ptr<cxx::IEntity>& e) {
+    return e->name == "Foo";
+    });
+
+  REQUIRE(foo != bar.entities.end());
+
+  auto& members = static_cast<cxx::Class&>(**foo).members;
+  REQUIRE(members.size() == 2);
+
+  auto get = std::find_if(members.begin(), members.end(), [](const std::shared_ptr<cxx::IEntity>& e) {
+    return e->name == "get";
+    });
+
+  REQUIRE(get != members.end());
+  REQUIRE(!static_cast<cxx::Function&>(**get).body.isNull());
+}
+
+TEST_CASE("The file registry lets the first parser claim a file", "[libclang-parser]")
+{
+  cxx::ClangFileRegistry registry;
+
+  CXFileUniqueID a{ { 1, 2, 3 } };
+  CXFileUniqueID b{ { 1, 2, 4 } };
+  const cxx::ClangFileRegistry::Owner first = cxx::ClangFileRegistry::newOwner();
+  const cxx::ClangFileRegistry::Owner second = cxx::ClangFileRegistry::newOwner();
+  REQUIRE(first != second);
+
+  REQUIRE(registry.claim(a, first));
+  REQUIRE(registry.claim(a, first));
+  REQUIRE_FALSE(registry.claim(a, second));
+  REQUIRE(registry.claim(b, second));
+
+  REQUIRE(registry.isClaimed(a));
+  REQUIRE(registry.size() == 2);
+
+  registry.clear();
+  REQUIRE_FALSE(registry.isClaimed(b));
+}
+
+TEST_CASE("The compilation database gives the arguments of a file", "[libclang-parser]")
+{
+  using cxx::parsers::CompilationDatabase;
+
+  CompilationDatabase db = CompilationDatabase::fromJson(
+    "[\n"
+    "  { \"directory\": \"/home/project/build\",\n"
+    "    \"command\": \"/usr/bin/c++ -DNAME=\\\"a b\\\" -I../include -isystem /usr/local/include -O2 -Wall -std=c++14 -o foo.o -c ../src/foo.cpp\",\n"
+    "    \"file\": \"../src/foo.cpp\" },\n"
+    "  { \"directory\": \"/home/project/build\",\n"
+    "    \"arguments\": [ \"c++\", \"-MD\", \"-MF\", \"bar.d\", \"-D\", \"BAR\", \"-include\", \"config.h\", \"-c\", \"/home/project/src/bar.cpp\" ],\n"
+    "    \"file\": \"/home/project/src/bar.cpp\", \"output\": \"bar.o\" }\n"
+    "]");
+
+  REQUIRE(db.commands().size() == 2);
+
+  const CompilationDatabase::Command* foo = db.find("/home/project/src/foo.cpp");
+  REQUIRE(foo != nullptr);
+  REQUIRE(foo->arguments.at(1) == "-DNAME=a b");
+  REQUIRE(db.find("src/foo.cpp") == foo);
+  REQUIRE(db.find("/home/project/src/baz.cpp") == nullptr);
+
+  std::vector<std::string> args = CompilationDatabase::parserArguments(*foo);
+  std::vector<std::string> expected{ "-DNAME=a b", "-I", "/home/project/include", "-isystem", "/usr/local/include", "-std=c++14" };
+  REQUIRE(args == expected);
+
+  args = CompilationDatabase::parserArguments(*db.find("/home/project/src/bar.cpp"));
+  expected = { "-D", "BAR", "-include", "/home/project/build/config.h" };
+  REQUIRE(args == expected);
+
+  REQUIRE_THROWS(CompilationDatabase::fromJson("[ { \"directory\": \"/\" } ]"));
+  REQUIRE_THROWS(CompilationDatabase::fromJson("[ { \"file\": \"a.cpp\" "));
+
+  REQUIRE(CompilationDatabase::fromJson("[ { \"file\": \"/\\u00e9.cpp\" } ]").commands().front().file == "/\xC3\xA9.cpp");
+  REQUIRE_THROWS_AS(CompilationDatabase::fromJson("[ { \"file\": \"/\\uzzzz.cpp\" } ]"), std::runtime_error);
+  REQUIRE_THROWS_AS(CompilationDatabase::fromJson("[ { \"file\": \"/\\u12\" } ]"), std::runtime_error);
+}
@@ -0,0 +1,180 @@
+// Copyright (C) 2021 Vincent Chambrin
+// This file is part of the 'cxxast' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "cxx/parsers/preprocessor.h"
+#include "cxx/parsers/restricted-parser.h"
+
+#include "cxx/filesystem.h"
+#include "cxx/namespace.h"
+#include "cxx/program.h"
+#include "cxx/variable.h"
+
+#include <fstream>
+#include <iterator>
+#include <map>
+
+using namespace cxx::parsers;
+
+static std::string active_text(Preprocessor& pp, const std::string& src)
+{
+  std::string result;
+
+  for (const auto& r : pp.process("", StringView(src.data(), src.size())))
+    result += src.substr(r.first, r.second - r.first);
+
+  return result;
+}
+
+TEST_CASE("The preprocessor evaluates conditional expressions", "[preprocessor]")
+{
+  Preprocessor pp;
+  pp.macros["FOO"] = "";
+  pp.macros["VERSION"] = "3";
+  pp.macros["TWICE"] = "(VERSION * 2)";
+  pp.macros["CALL"] = "(x) x";
+
+  REQUIRE(pp.evaluate("1 + 2 * 3") == 7);
+  REQUIRE(pp.evaluate("(1 + 2) * 3") == 9);
+  REQUIRE(pp.evaluate("defined(FOO) && defined BAR") == 0);
+  REQUIRE(pp.evaluate("defined(FOO) || !defined BAR") == 1);
+  REQUIRE(pp.evaluate("VERSION >= 2 ? 10 : 20") == 10);
+  REQUIRE(pp.evaluate("TWICE == 6") == 1);
+  REQUIRE(pp.evaluate("UNKNOWN") == 0);
+  REQUIRE(pp.evaluate("CALL") == 0);
+  REQUIRE(pp.evaluate("__has_include(<vector>) || 0x10 == 16") == 1);
+  REQUIRE(pp.evaluate("201703L > 1'000 && 1 << 4 == 16") == 1);
+  REQUIRE(pp.evaluate("'a' == 97") == 1);
+  REQUIRE(pp.evaluate("1 / 0 == 0 && 1 % 0 == 0") == 1);
+  REQUIRE(pp.evaluate("(-9223372036854775807 - 1) / -1 == -9223372036854775807 - 1") == 1);
+  REQUIRE(pp.evaluate("(-9223372036854775807 - 1) % -1") == 0);
+  REQUIRE(pp.evaluate("-(-9223372036854775807 - 1) < 0") == 1);
+  REQUIRE(pp.evaluate("9223372036854775807 + 1 < 0") == 1);
+  REQUIRE_THROWS(pp.evaluate("1 +"));
+}
+
+TEST_CASE("The preprocessor removes directives and inactive blocks", "[preprocessor]")
+{
+  const std::string src =
+    "#define A 2\n"
+    "a;\n"
+    "#if A == 1\n"
+    "b;\n"
+    "#elif A == 2\n"
+    "c;\n"
+    "  #ifdef B\n"
+    "d;\n"
+    "  #else\n"
+    "e;\n"
+    "  #endif\n"
+    "#else\n"
+    "f;\n"
+    "#endif\n"
+    "/*\n"
+    "#define B\n"
+    "*/\n"
+    "const char* s = \"#if 0\";\n"
+    "#if 0\n"
+    "don't stop\n"
+    "#endif\n"
+    "#define LONG \\\n"
+    "  1\n"
+    "#undef A\n"
+    "g;";
+
+  Preprocessor pp;
+
+  REQUIRE(active_text(pp, src) == "a;\nc;\ne;\n/*\n#define B\n*/\nconst char* s = \"#if 0\";\ng;");
+  REQUIRE(pp.macros.at("LONG") == "1");
+  REQUIRE(!pp.isDefined("A"));
+  REQUIRE(!pp.isDefined("B"));
+
+  REQUIRE_THROWS(active_text(pp, "#if 1\n"));
+  REQUIRE_THROWS(active_text(pp, "#endif\n"));
+}
+
+TEST_CASE("The preprocessor processes guarded headers once", "[preprocessor]")
+{
+  {
+    std::ofstream file{ "test-preprocessor-guarded.h" };
+    file << "// comment\n#ifndef GUARDED_H\n#define GUARDED_H\nint guarded = 0;\n#endif // GUARDED_H\n";
+  }
+
+  {
+    std::ofstream file{ "test-preprocessor-once.h" };
+    file << "#pragma once\nint once = 0;\n";
+  }
+
+  {
+    std::ofstream file{ "test-preprocessor-unguarded.h" };
+    file << "#ifndef NDEBUG\nint unguarded = 0;\n#endif\nint after = 0;\n";
+  }
+
+  Preprocessor pp;
+  std::map<std::string, int> included;
+
+  pp.include_handler = [&](const std::string& path) {
+    included[path] += 1;
+    std::ifstream file{ path };
+    std::string content{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    pp.process(path, StringView(content.data(), content.size()));
+  };
+
+  const std::string src =
+    "#include \"test-preprocessor-guarded.h\"\n"
+    "#include \"test-preprocessor-once.h\"\n"
+    "#include \"test-preprocessor-unguarded.h\"\n"
+    "#include \"test-preprocessor-guarded.h\"\n"
+    "#include \"test-preprocessor-once.h\"\n"
+    "#include \"test-preprocessor-unguarded.h\"\n"
+    "#include <vector>\n";
+
+  pp.process("main.cpp", StringView(src.data(), src.size()));
+
+  REQUIRE(included.size() == 3);
+  REQUIRE(included["test-preprocessor-guarded.h"] == 1);
+  REQUIRE(included["test-preprocessor-once.h"] == 1);
+  REQUIRE(included["test-preprocessor-unguarded.h"] == 2);
+  REQUIRE(pp.isGuarded("test-preprocessor-guarded.h"));
+  REQUIRE(!pp.isGuarded("test-preprocessor-unguarded.h"));
+}
+
+TEST_CASE("The restricted parser honours defines and includes", "[preprocessor]")
+{
+  {
+    std::ofstream file{ "test-preprocessor-header.h" };
+    file << "#ifndef TEST_PREPROCESSOR_HEADER_H\n"
+      << "#define TEST_PREPROCESSOR_HEADER_H\n"
+      << "#define HEADER_VERSION 2\n"
+      << "int from_header = 0;\n"
+      << "#endif\n";
+  }
+
+  {
+    std::ofstream file{ "test-preprocessor-source.cpp" };
+    file << "#include \"test-preprocessor-header.h\"\n"
+      << "#include \"test-preprocessor-header.h\"\n"
+      << "#include <vector>\n"
+      << "#if defined(USE_A) && HEADER_VERSION >= 2\n"
+      << "int a = 0;\n"
+      << "#else\n"
+      << "int b = 0;\n"
+      << "#endif\n";
+  }
+
+  RestrictedParser parser;
+  parser.defines["USE_A"] = "1";
+  parser.parse("test-preprocessor-source.cpp");
+
+  auto global = parser.program()->globalNamespace();
+
+  REQUIRE(global->entities.size() == 2);
+  REQUIRE(global->entities.at(0)->name == "from_header");
+  REQUIRE(global->entities.at(1)->name == "a");
+
+  auto file = cxx::FileSystem::GlobalInstance().get("test-preprocessor-source.cpp");
+  REQUIRE(file->ast->children().size() == 1);
+  REQUIRE(file->ast->children().front()->sourcerange.begin.line == 4);
+}
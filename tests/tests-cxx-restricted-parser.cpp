@@ -4,11 +4,22 @@
 
 #include "catch.hpp"
 
+#include "cxx/parsers/batch-parser.h"
 #include "cxx/parsers/restricted-parser.h"
+#include "cxx/parsers/type-cache.h"
 
+#include "cxx/arena.h"
 #include "cxx/declarations.h"
+#include "cxx/expressions.h"
+#include "cxx/filesystem.h"
+#include "cxx/namespace.h"
+#include "cxx/program.h"
 #include "cxx/statements.h"
 
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
 TEST_CASE("The parser is able to parse simple types", "[restricted-parser]")
 {
   cxx::Type t = cxx::parsers::RestrictedParser::parseType("const int*");
@@ -21,6 +32,141 @@ TEST_CASE("The parser is able to parse simple types", "[restricted-parser]")
   REQUIRE(t.parameters().size() == 2);
 }
 
+TEST_CASE("The parser caches the types it parses from strings", "[restricted-parser]")
+{
+  cxx::parsers::TypeCache& cache = cxx::parsers::TypeCache::GlobalInstance();
+  cache.clear();
+  cache.resetCounters();
+
+  cxx::Type a = cxx::parsers::RestrictedParser::parseType("std::vector<std::string>");
+  cxx::Type b = cxx::parsers::RestrictedParser::parseType("std::vector<std::string>");
+  REQUIRE(a == b);
+  REQUIRE(a.impl() == b.impl());
+  REQUIRE(cache.hits() == 1);
+  REQUIRE(cache.misses() == 1);
+
+  auto func = cxx::parsers::RestrictedParser::parseFunctionSignature("std::vector<std::string> split(std::vector<std::string> parts);");
+  REQUIRE(func->return_type.impl() == a.impl());
+  REQUIRE(func->parameters.front()->type.impl() == a.impl());
+
+  // a cached type is not parsed again
+  cache.insert("my::type<int>", cxx::Type("cached"));
+  auto var = cxx::parsers::RestrictedParser::parseVariable("my::type<int> v = 0;");
+  REQUIRE(var->type().toString() == "cached");
+  REQUIRE(var->name == "v");
+
+  cache.clear();
+  cache.resetCounters();
+  auto td = cxx::parsers::RestrictedParser::parseTypedef("typedef unsigned_long size_type;");
+  td = cxx::parsers::RestrictedParser::parseTypedef("typedef unsigned_long size_type;");
+  REQUIRE(td->type.toString() == "unsigned_long");
+  REQUIRE(cache.misses() == 1);
+  REQUIRE(cache.hits() == 1);
+
+  cxx::parsers::TypeCache bounded{ 2 };
+  bounded.intern(cxx::Type::Int);
+  bounded.intern(cxx::Type::Void);
+  REQUIRE(bounded.size() == 2);
+  bounded.intern(cxx::Type::Auto);
+  REQUIRE(bounded.size() == 1);
+  REQUIRE(bounded.misses() == 3);
+
+  bounded.setCapacity(0);
+  bounded.intern(cxx::Type::Int);
+  REQUIRE(bounded.size() == 0);
+}
+
+namespace
+{
+
+class TestParser : public cxx::parsers::RestrictedParser
+{
+public:
+  explicit TestParser(const std::string* src)
+    : RestrictedParser(src)
+  {
+  }
+
+  explicit TestParser(cxx::FileSystem& fs)
+    : RestrictedParser(fs)
+  {
+  }
+
+  using RestrictedParser::threadParserInUse;
+  using RestrictedParser::resetSource;
+  using RestrictedParser::memoizedParseType;
+  using RestrictedParser::pos;
+  using RestrictedParser::seek;
+  using RestrictedParser::view;
+  using RestrictedParser::setView;
+};
+
+} // namespace
+
+TEST_CASE("The parser reuses a memoized parse only where it is still valid", "[restricted-parser]")
+{
+  const std::string src = "A<B> x;";
+  TestParser parser{ &src };
+
+  cxx::parsers::ParseResult<cxx::Type> first = parser.memoizedParseType();
+  REQUIRE(first.value.toString() == "A<B>");
+  const size_t end = parser.pos();
+  REQUIRE(end == 4);
+
+  // same position, same view
+  parser.seek(0);
+  cxx::parsers::ParseResult<cxx::Type> again = parser.memoizedParseType();
+  REQUIRE(again.value.impl() == first.value.impl());
+  REQUIRE(parser.pos() == end);
+
+  // a view that stops at ';' still contains every token the parse looked at
+  parser.setView(0, 5);
+  parser.seek(0);
+  again = parser.memoizedParseType();
+  REQUIRE(again.value.impl() == first.value.impl());
+
+  // a view that ends before the horizon gets a parse of its own
+  parser.setView(0, 2);
+  parser.seek(0);
+  cxx::parsers::ParseResult<cxx::Type> narrow = parser.memoizedParseType();
+  REQUIRE(narrow.value.impl() != first.value.impl());
+  REQUIRE(narrow.value.toString() == "A");
+  REQUIRE(parser.pos() == 1);
+
+  // a speculative parse that failed is not reused under another view
+  const std::string unbalanced = "foo<int x;";
+  parser.resetSource(&unbalanced);
+  cxx::parsers::ParseResult<cxx::Type> speculative = parser.memoizedParseType();
+  REQUIRE(speculative.value.toString() == "foo");
+  parser.setView(0, 1);
+  parser.seek(0);
+  cxx::parsers::ParseResult<cxx::Type> reparsed = parser.memoizedParseType();
+  REQUIRE(reparsed.value.impl() != speculative.value.impl());
+  REQUIRE(reparsed.value.toString() == "foo");
+
+  // nothing survives a new source
+  const std::string other = "int y;";
+  parser.resetSource(&other);
+  REQUIRE(parser.memoizedParseType().value.toString() == "int");
+}
+
+TEST_CASE("The parser does not reuse a memoized parse from a previous file", "[restricted-parser]")
+{
+  cxx::FileSystem fs;
+  TestParser parser{ fs };
+
+  parser.parse("memo-first.cpp", "namespace m { }\nfoo::bar<int> a = 0;\n");
+  // no statement here, so nothing clears the memo but the new source
+  parser.parse("memo-second.cpp", "namespace n { }\nnamespace p { }\nnamespace q { }\n");
+
+  REQUIRE(parser.program()->globalNamespace()->entities.size() == 5);
+
+  parser.setView(0, 12);
+  parser.seek(4);
+  REQUIRE(parser.memoizedParseType().value.toString() != "foo::bar<int>");
+  REQUIRE(parser.pos() == 4);
+}
+
 TEST_CASE("The parser is able to parse simple variable declarations", "[restricted-parser]")
 {
   auto variable = cxx::parsers::RestrictedParser::parseVariable("int a = 5;");
@@ -35,6 +181,56 @@ TEST_CASE("The parser is able to parse simple variable declarations", "[restrict
   REQUIRE(variable->specifiers() == (cxx::VariableSpecifier::Constexpr | cxx::VariableSpecifier::Inline));
 }
 
+TEST_CASE("The parser refers to the source of the expressions it parses", "[restricted-parser]")
+{
+  cxx::FileSystem fs;
+  cxx::parsers::RestrictedParser parser{ fs };
+
+  {
+    std::string content = "int a = 1+2;\nint b = 1 + 2;\nvoid c(int n = 1 + 2);\n";
+    parser.parse("expressions.cpp", content);
+    parser.parse("other.cpp", std::string("int d = 0;"));
+  }
+
+  auto global = parser.program()->globalNamespace();
+  REQUIRE(global->entities.size() == 4);
+
+  const cxx::Expression a = std::static_pointer_cast<cxx::Variable>(global->entities.at(0))->defaultValue();
+  const cxx::Expression b = std::static_pointer_cast<cxx::Variable>(global->entities.at(1))->defaultValue();
+  const cxx::Expression c = std::static_pointer_cast<cxx::Function>(global->entities.at(2))->parameters.front()->default_value;
+
+  REQUIRE(a.toString() == "1+2");
+  REQUIRE(b.toString() == "1 + 2");
+  REQUIRE(c.toString() == "1 + 2");
+  REQUIRE(a != b);
+  REQUIRE(b == c);
+  REQUIRE(c == cxx::Expression("1 + 2"));
+
+  auto& b_expr = static_cast<const cxx::UnexposedExpression&>(*b.impl());
+  auto& c_expr = static_cast<const cxx::UnexposedExpression&>(*c.impl());
+  REQUIRE(c_expr.data() - b_expr.data() == 22);
+}
+
+TEST_CASE("The expressions parsed from a file do not change with the file", "[restricted-parser]")
+{
+  {
+    std::ofstream file{ "test-restricted-parser-expressions.cpp" };
+    file << "int a = 1 + 2;\n";
+  }
+
+  cxx::FileSystem fs;
+  cxx::parsers::RestrictedParser parser{ fs };
+  parser.parse("test-restricted-parser-expressions.cpp");
+
+  {
+    std::ofstream file{ "test-restricted-parser-expressions.cpp", std::ios::trunc };
+    file << "int";
+  }
+
+  auto global = parser.program()->globalNamespace();
+  REQUIRE(std::static_pointer_cast<cxx::Variable>(global->entities.front())->defaultValue().toString() == "1 + 2");
+}
+
 TEST_CASE("The parser is able to parse simple function declarations", "[restricted-parser]")
 {
   auto func = cxx::parsers::RestrictedParser::parseFunctionSignature("int foo(int n, int = 0);");
@@ -90,6 +286,61 @@ TEST_CASE("The parser is able to parse simple function declarations", "[restrict
   REQUIRE(func->isStatic());
 }
 
+TEST_CASE("The static parse functions reuse a parser per thread", "[restricted-parser]")
+{
+  REQUIRE_THROWS(cxx::parsers::RestrictedParser::parseFunctionSignature("int foo(int n"));
+
+  // the parser is usable again after an error
+  auto func = cxx::parsers::RestrictedParser::parseFunctionSignature("int foo(int n);");
+  REQUIRE(func->name == "foo");
+  REQUIRE(func->parameters.size() == 1);
+
+  // and after an error of the lexer
+  REQUIRE_THROWS(cxx::parsers::RestrictedParser::parseFunctionSignature("void f(char c = 'ab"));
+  REQUIRE(!TestParser::threadParserInUse());
+  func = cxx::parsers::RestrictedParser::parseFunctionSignature("int bar(int n);");
+  REQUIRE(func->name == "bar");
+
+  std::vector<std::string> names{ 4 };
+  std::vector<std::thread> threads;
+
+  for (size_t i(0); i < names.size(); ++i)
+  {
+    threads.emplace_back([i, &names]() {
+      for (int j(0); j < 100; ++j)
+      {
+        const std::string name = "f" + std::to_string(i) + "_" + std::to_string(j);
+        names[i] = cxx::parsers::RestrictedParser::parseFunctionSignature("void " + name + "(int a);")->name.str();
+
+        if (names[i] != name)
+          return;
+      }
+    });
+  }
+
+  for (std::thread& t : threads)
+    t.join();
+
+  for (size_t i(0); i < names.size(); ++i)
+    REQUIRE(names[i] == "f" + std::to_string(i) + "_99");
+}
+
+TEST_CASE("The parser can be reused for several files", "[restricted-parser]")
+{
+  cxx::FileSystem fs;
+  cxx::parsers::RestrictedParser parser{ fs };
+
+  parser.parse("first.cpp", "namespace ns { struct Foo { int x; }; }\n");
+  REQUIRE_THROWS(parser.parse("broken.cpp", "struct Bar { void f("));
+  parser.parse("second.cpp", "\nint y = 0;\n");
+
+  auto ast = fs.get("second.cpp")->ast;
+  REQUIRE(ast->children().size() == 1);
+  REQUIRE(ast->children().front()->sourcerange.begin.line == 1);
+  REQUIRE(parser.program()->globalNamespace()->entities.size() == 3);
+  REQUIRE(parser.program()->globalNamespace()->entities.back()->name == "y");
+}
+
 TEST_CASE("The parser is able to parse simple typedef declarations", "[restricted-parser]")
 {
   auto def = cxx::parsers::RestrictedParser::parseTypedef("typedef const int ConstInt;");
@@ -153,4 +404,567 @@ TEST_CASE("The parser is able to parse declarations", "[restricted-parser]")
 
   stmt = cxx::Statement(std::static_pointer_cast<cxx::IStatement>(result->childvec.at(4)));
   REQUIRE(stmt.is<cxx::TryBlock>());
-}
\ No newline at end of file
+}
+
+TEST_CASE("The parser tells declarations from expressions in function bodies", "[restricted-parser]")
+{
+  cxx::parsers::RestrictedParser parser;
+
+  std::shared_ptr<cxx::AstRootNode> result = parser.parseSource(
+    "int foo(int a, int b)\n"
+    "{\n"
+    "  int c = a + b;\n"
+    "  c = a * b;\n"
+    "  bar(a, b);\n"
+    "  std::vector<int> v;\n"
+    "  a < b;\n"
+    "  std::cout << c;\n"
+    "  return c;\n"
+    "}\n");
+
+  REQUIRE(result->childvec.size() == 1);
+  REQUIRE(result->childvec.front()->node_kind() == cxx::NodeKind::FunctionDeclaration);
+
+  cxx::AstNodeList body = result->childvec.front()->children().front()->children();
+
+  std::vector<cxx::NodeKind> kinds;
+
+  for (std::shared_ptr<cxx::AstNode> stmt : body)
+    kinds.push_back(stmt->node_kind());
+
+  REQUIRE(kinds == std::vector<cxx::NodeKind>{
+    cxx::NodeKind::VariableDeclaration,
+    cxx::NodeKind::ExpressionStatement,
+    cxx::NodeKind::ExpressionStatement,
+    cxx::NodeKind::VariableDeclaration,
+    cxx::NodeKind::ExpressionStatement,
+    cxx::NodeKind::ExpressionStatement,
+    cxx::NodeKind::ReturnStatement,
+  });
+
+  REQUIRE_THROWS(cxx::parsers::RestrictedParser::parseType("const *"));
+}
+
+TEST_CASE("The parser can recover from errors", "[restricted-parser]")
+{
+  const std::string source =
+    "int a = 0;\n"
+    "enum E { A, B };\n"
+    "template<typename T> void f(T t) { g(t); }\n"
+    "int foo(int n)\n"
+    "{\n"
+    "  int b = n;\n"
+    "  friend int bar(b);\n"
+    "  return b;\n"
+    "}\n"
+    "int c = 1;\n";
+
+  cxx::parsers::RestrictedParser parser;
+
+  REQUIRE_THROWS(parser.parseSource(source));
+
+  parser.error_recovery = true;
+  std::shared_ptr<cxx::AstRootNode> result = parser.parseSource(source);
+
+  std::vector<cxx::NodeKind> kinds;
+
+  for (std::shared_ptr<cxx::AstNode> stmt : result->childvec)
+    kinds.push_back(stmt->node_kind());
+
+  REQUIRE(kinds == std::vector<cxx::NodeKind>{
+    cxx::NodeKind::VariableDeclaration,
+    cxx::NodeKind::UnexposedStatement,
+    cxx::NodeKind::UnexposedStatement,
+    cxx::NodeKind::FunctionDeclaration,
+    cxx::NodeKind::VariableDeclaration,
+  });
+
+  REQUIRE(result->childvec.at(1)->sourcerange.begin.line == 1);
+  REQUIRE(result->childvec.at(1)->sourcerange.end.line == 1);
+  REQUIRE(result->childvec.at(1)->sourcerange.end.column == 16);
+
+  cxx::AstNodeList body = result->childvec.at(3)->children().front()->children();
+  REQUIRE(body.size() == 3);
+  REQUIRE(body.at(1)->node_kind() == cxx::NodeKind::UnexposedStatement);
+
+  REQUIRE(parser.errors.size() == 3);
+  REQUIRE(parser.errors.at(0).location.line() == 1);
+  REQUIRE(parser.errors.at(2).location.line() == 6);
+}
+
+TEST_CASE("The parser removes what a statement it recovered from added to a reopened scope", "[restricted-parser]")
+{
+  const std::string source =
+    "class C { public: int z; };\n"
+    "class C { public: int y; struct S { int d; }; } int b;\n";
+
+  cxx::parsers::RestrictedParser parser;
+  parser.error_recovery = true;
+  parser.parseSource(source);
+
+  REQUIRE(parser.errors.size() == 1);
+
+  auto global = parser.program()->globalNamespace();
+  REQUIRE(global->entities.size() == 2);
+  REQUIRE(global->entities.back()->name == "b");
+
+  auto c = std::static_pointer_cast<cxx::Class>(global->entities.front());
+  REQUIRE(c->members.size() == 1);
+  REQUIRE(c->members.front()->name == "z");
+
+  // C, z and b
+  REQUIRE(parser.program()->astmap.size() == 3);
+  REQUIRE(parser.program()->astmap.at(c.get())->sourcerange.begin.line == 0);
+}
+
+TEST_CASE("The parser is able to parse files", "[restricted-parser]")
+{
+  {
+    std::ofstream file{ "test-restricted-parser.cpp" };
+    file << "int n = 0;\n" << "namespace bar { }\n";
+  }
+
+  cxx::parsers::RestrictedParser parser;
+  parser.parse("test-restricted-parser.cpp");
+
+  auto file = cxx::FileSystem::GlobalInstance().get("test-restricted-parser.cpp");
+  REQUIRE(file->ast);
+  REQUIRE(file->ast->children().size() == 2);
+}
+
+TEST_CASE("The parser computes the positions of the nodes", "[restricted-parser]")
+{
+  {
+    std::ofstream file{ "test-restricted-parser-positions.cpp" };
+    file << "int n = 0;\n" << "  namespace bar { }\n";
+  }
+
+  cxx::parsers::RestrictedParser parser;
+  parser.parse("test-restricted-parser-positions.cpp");
+
+  auto file = cxx::FileSystem::GlobalInstance().get("test-restricted-parser-positions.cpp");
+  REQUIRE(file->ast);
+  REQUIRE(file->ast->children().size() == 2);
+
+  auto ns = file->ast->children().at(1);
+  REQUIRE(ns->sourcerange.begin.line == 1);
+  REQUIRE(ns->sourcerange.begin.column == 2);
+  REQUIRE(ns->sourcerange.end.line == 1);
+  REQUIRE(ns->sourcerange.end.column == 19);
+}
+
+TEST_CASE("The parser gives the same result when lexing on several threads", "[restricted-parser]")
+{
+  std::string src;
+
+  while (src.size() < 2 * 1024 * 1024)
+  {
+    src += "/* comment */\n";
+    src += "int n = 0; // comment\n";
+    src += "const char* s = \"/* string */\";\n";
+    src += "namespace bar { }\n";
+  }
+
+  cxx::parsers::RestrictedParser sequential;
+  std::shared_ptr<cxx::AstRootNode> expected = sequential.parseSource(src);
+
+  cxx::parsers::RestrictedParser parallel;
+  parallel.lexer_threads = 4;
+  std::shared_ptr<cxx::AstRootNode> result = parallel.parseSource(src);
+
+  REQUIRE(result->childvec.size() == expected->childvec.size());
+  REQUIRE(result->childvec.back()->sourcerange.begin.line == expected->childvec.back()->sourcerange.begin.line);
+  REQUIRE(result->childvec.back()->sourcerange.end.column == expected->childvec.back()->sourcerange.end.column);
+
+  src += "int a = 'ab';\n";
+  REQUIRE_THROWS(parallel.parseSource(src));
+}
+
+// With 'sorted', the members of each scope are listed in alphabetical order
+static std::string entity_tree(const cxx::IEntity& e, bool sorted = false)
+{
+  std::string result = e.name.str();
+
+  const std::vector<std::shared_ptr<cxx::IEntity>>* members = nullptr;
+
+  if (e.is<cxx::Namespace>())
+    members = &static_cast<const cxx::Namespace&>(e).entities;
+  else if (e.is<cxx::Class>())
+    members = &static_cast<const cxx::Class&>(e).members;
+
+  if (members)
+  {
+    std::vector<std::string> trees;
+
+    for (const auto& m : *members)
+      trees.push_back(entity_tree(*m, sorted));
+
+    if (sorted)
+      std::sort(trees.begin(), trees.end());
+
+    result += "{";
+
+    for (const std::string& t : trees)
+      result += t + ";";
+
+    result += "}";
+  }
+
+  return result;
+}
+
+TEST_CASE("The batch parser merges files parsed on several threads", "[restricted-parser]")
+{
+  {
+    std::ofstream file{ "test-batch-parser.h" };
+    file << "#pragma once\n"
+      << "namespace shared { class Foo { public: void bar(); }; void foo(int n); }\n";
+  }
+
+  for (int i(0); i < 20; ++i)
+  {
+    std::ofstream file{ "test-batch-parser-" + std::to_string(i) + ".batchtest" };
+    file << "#include \"test-batch-parser.h\"\n"
+      << "namespace shared { void foo(int n) { } int n" << i << " = 0; }\n"
+      << "namespace ns" << (i % 3) << " { class C" << i << " { }; }\n";
+  }
+
+  {
+    std::ofstream file{ "test-batch-parser-error.batchtest" };
+    file << "int a = 'ab';\n";
+  }
+
+  std::vector<std::string> files = cxx::parsers::BatchParser::listFiles(".", { ".batchtest" });
+
+  // only keep the files of the current directory
+  files.erase(std::remove_if(files.begin(), files.end(), [](const std::string& f) {
+    return f.find('/', 2) != std::string::npos;
+    }), files.end());
+
+  REQUIRE(files.size() == 21);
+  REQUIRE(std::is_sorted(files.begin(), files.end()));
+
+  cxx::FileSystem fs1;
+  cxx::parsers::BatchParser sequential{ fs1 };
+  sequential.threads = 1;
+  REQUIRE(!sequential.parse(files));
+
+  cxx::FileSystem fs4;
+  cxx::parsers::BatchParser parallel{ fs4 };
+  parallel.threads = 4;
+  REQUIRE(!parallel.parse(files));
+
+  REQUIRE(parallel.errors.size() == 1);
+  REQUIRE(parallel.errors.front().filepath.find("error") != std::string::npos);
+
+  const std::string tree = entity_tree(*parallel.program()->globalNamespace());
+  REQUIRE(tree == entity_tree(*sequential.program()->globalNamespace()));
+
+  auto global = parallel.program()->globalNamespace();
+  REQUIRE(global->entities.size() == 4);
+
+  auto shared = std::static_pointer_cast<cxx::Namespace>(global->entities.front());
+  REQUIRE(shared->name == "shared");
+  REQUIRE(shared->entities.size() == 2 + 20);
+  REQUIRE(shared->entities.at(0)->name == "Foo");
+  REQUIRE(static_cast<cxx::Class&>(*shared->entities.at(0)).members.size() == 1);
+  REQUIRE(shared->entities.at(1)->name == "foo");
+  REQUIRE(!static_cast<cxx::Function&>(*shared->entities.at(1)).body.isNull());
+
+  REQUIRE(fs4.files.size() == 21);
+  REQUIRE(fs4.files.at(1)->path() == "test-batch-parser.h");
+  REQUIRE(fs4.files.at(1)->ast->children().front()->file() == fs4.files.at(1));
+}
+
+TEST_CASE("The parser can skip function bodies without lexing them", "[restricted-parser]")
+{
+  const std::string content =
+    "namespace ns {\n"
+    "void f(int a) { if (a) { g(\"}\"); } char c = '}'; /* } */ }\n"
+    "struct A { void g() const { return; } int x; };\n"
+    "}\n"
+    "int y = 0;\n";
+
+  cxx::FileSystem fs;
+  cxx::parsers::RestrictedParser parser{ fs };
+  parser.skip_function_bodies = true;
+  parser.parse("skip.cpp", content);
+
+  cxx::FileSystem fs2;
+  cxx::parsers::RestrictedParser fast{ fs2 };
+  fast.skip_function_bodies = true;
+  fast.skip_function_body_tokens = true;
+  fast.parse("skip.cpp", content);
+
+  REQUIRE(entity_tree(*fast.program()->globalNamespace()) == entity_tree(*parser.program()->globalNamespace()));
+
+  auto ns = std::static_pointer_cast<cxx::Namespace>(fast.program()->globalNamespace()->entities.front());
+  auto f = std::static_pointer_cast<cxx::Function>(ns->entities.front());
+  REQUIRE(f->name == "f");
+  REQUIRE(f->body.isNull());
+
+  auto y = fs2.get("skip.cpp")->ast->children().back();
+  REQUIRE(y->sourcerange.begin.line == 4);
+}
+
+TEST_CASE("The parser can reparse the declarations touched by an edit", "[restricted-parser]")
+{
+  const std::string content =
+    "int a = 0;\n"
+    "namespace ns {\n"
+    "void foo(int n);\n"
+    "int b = 1;\n"
+    "struct Foo { int x; };\n"
+    "}\n"
+    "void bar() { }\n";
+
+  cxx::FileSystem fs;
+  cxx::parsers::RestrictedParser parser{ fs };
+  REQUIRE(!parser.reparse("reparse.cpp", {}));
+
+  parser.incremental = true;
+  parser.parse("reparse.cpp", content);
+
+  auto root = std::static_pointer_cast<cxx::AstRootNode>(fs.get("reparse.cpp")->ast);
+  const std::vector<std::shared_ptr<cxx::AstNode>> nodes = root->childvec;
+  REQUIRE(nodes.size() == 3);
+
+  auto nsdecl = std::static_pointer_cast<cxx::NamespaceDeclaration>(nodes.at(1));
+  const std::vector<std::shared_ptr<cxx::AstNode>> ns_nodes = nsdecl->childvec;
+  REQUIRE(ns_nodes.size() == 3);
+
+  auto ns = std::static_pointer_cast<cxx::Namespace>(nsdecl->entity_ptr);
+  REQUIRE(ns->entities.size() == 3);
+  auto b = ns->entities.at(1);
+  auto foo = std::static_pointer_cast<cxx::Class>(ns->entities.at(2));
+
+  // int b = 1; -> int b = 42;
+  REQUIRE(parser.reparse("reparse.cpp", { { content.find("1;"), 1, "42" } }));
+
+  REQUIRE(root->childvec == nodes);
+  REQUIRE(nsdecl->childvec.size() == 3);
+  REQUIRE(nsdecl->childvec.at(0) == ns_nodes.at(0));
+  REQUIRE(nsdecl->childvec.at(1) != ns_nodes.at(1));
+  REQUIRE(nsdecl->childvec.at(2) == ns_nodes.at(2));
+  REQUIRE(nsdecl->sourcerange.end.line == 5);
+
+  REQUIRE(ns->entities.size() == 3);
+  REQUIRE(std::find(ns->entities.begin(), ns->entities.end(), b) == ns->entities.end());
+  auto new_b = std::static_pointer_cast<cxx::Variable>(ns->entities.back());
+  REQUIRE(new_b->name == "b");
+  REQUIRE(new_b->defaultValue().toString() == "42");
+  REQUIRE(parser.program()->astmap.at(new_b.get()) == nsdecl->childvec.at(1));
+
+  // a new line at the start of the file and a new member in Foo
+  std::string new_content = content;
+  new_content.replace(new_content.find("1;"), 1, "42");
+  const size_t member_offset = new_content.find("int x;") + 6;
+
+  REQUIRE(parser.reparse("reparse.cpp", {
+    { member_offset, 0, " int y;" },
+    { 0, 0, "int z = 3;\n" },
+    }));
+
+  REQUIRE(root->childvec.size() == 4);
+  REQUIRE(root->childvec.at(1) == nodes.at(0));
+  REQUIRE(root->childvec.at(2) == nodes.at(1));
+  REQUIRE(root->childvec.at(3) == nodes.at(2));
+  REQUIRE(nodes.at(0)->sourcerange.begin.line == 1);
+  REQUIRE(nodes.at(2)->sourcerange.begin.line == 7);
+  REQUIRE(nodes.at(2)->children().front()->sourcerange.begin.line == 7);
+  REQUIRE(nodes.at(2)->children().front()->sourcerange.begin.column == 11);
+
+  REQUIRE(nsdecl->childvec.at(0) == ns_nodes.at(0));
+  REQUIRE(nsdecl->childvec.at(0)->sourcerange.begin.line == 3);
+  REQUIRE(nsdecl->childvec.at(2) != ns_nodes.at(2));
+
+  // Foo is defined again, in the same entity
+  REQUIRE(ns->entities.size() == 3);
+  REQUIRE(std::find(ns->entities.begin(), ns->entities.end(), foo) != ns->entities.end());
+  REQUIRE(foo->members.size() == 2);
+  REQUIRE(parser.program()->astmap.at(foo.get()) == nsdecl->childvec.at(2));
+
+  // the result is the same as parsing the new content
+  cxx::FileSystem fs2;
+  cxx::parsers::RestrictedParser full{ fs2 };
+  new_content.insert(member_offset, " int y;");
+  new_content.insert(0, "int z = 3;\n");
+  full.parse("reparse.cpp", new_content);
+
+  auto expected = fs2.get("reparse.cpp")->ast;
+  REQUIRE(expected->children().size() == root->children().size());
+  // (a reparse appends the entities it creates to their namespace)
+  REQUIRE(entity_tree(*full.program()->globalNamespace(), true) == entity_tree(*parser.program()->globalNamespace(), true));
+
+  for (size_t i(0); i < root->childvec.size(); ++i)
+  {
+    REQUIRE(root->childvec.at(i)->node_kind() == expected->children().at(i)->node_kind());
+    REQUIRE(root->childvec.at(i)->sourcerange.begin.line == expected->children().at(i)->sourcerange.begin.line);
+    REQUIRE(root->childvec.at(i)->sourcerange.end.line == expected->children().at(i)->sourcerange.end.line);
+    REQUIRE(root->childvec.at(i)->sourcerange.end.column == expected->children().at(i)->sourcerange.end.column);
+  }
+}
+
+TEST_CASE("The parser keeps the entities another file declares when reparsing", "[restricted-parser]")
+{
+  const std::string header = "void foo();\n";
+  const std::string source = "void foo() { }\nint x = 0;\n";
+
+  cxx::FileSystem fs;
+  cxx::parsers::RestrictedParser parser{ fs };
+  parser.incremental = true;
+  parser.parse("a.h", header);
+  parser.parse("a.cpp", source);
+
+  auto global = parser.program()->globalNamespace();
+  REQUIRE(global->entities.size() == 2);
+  auto foo = std::static_pointer_cast<cxx::Function>(global->entities.front());
+  REQUIRE(!foo->body.isNull());
+
+  // the definition of foo is removed
+  REQUIRE(parser.reparse("a.cpp", { { 0, source.find("int"), "" } }));
+
+  REQUIRE(global->entities.size() == 2);
+  REQUIRE(global->entities.front() == foo);
+  REQUIRE(foo->body.isNull());
+  REQUIRE(global->entities.back()->name == "x");
+}
+
+TEST_CASE("The parser keeps the members of a reparsed class in order", "[restricted-parser]")
+{
+  const std::string content =
+    "struct S { void f(); int a; };\n"
+    "int v = 0;\n"
+    "int w = 0;\n";
+
+  cxx::FileSystem fs;
+  cxx::parsers::RestrictedParser parser{ fs };
+  parser.incremental = true;
+  parser.parse("members.cpp", content);
+
+  REQUIRE(parser.reparse("members.cpp", {
+    { content.find("void"), 0, "int b; " },
+    { content.find("0;"), 1, "1" },
+    }));
+
+  auto names = [](const std::vector<std::shared_ptr<cxx::IEntity>>& entities) {
+    std::vector<std::string> result;
+
+    for (const auto& e : entities)
+      result.push_back(e->name);
+
+    return result;
+  };
+
+  // the members are in the order of the definition, as after a parse
+  auto global = parser.program()->globalNamespace();
+  auto s = std::static_pointer_cast<cxx::Class>(global->entities.front());
+  REQUIRE(names(s->members) == std::vector<std::string>{ "b", "f", "a" });
+
+  // the entities created by a reparse are appended to their namespace
+  REQUIRE(names(global->entities) == std::vector<std::string>{ "S", "w", "v" });
+}
+
+TEST_CASE("The parser leaves a file as it was when a reparse fails", "[restricted-parser]")
+{
+  const std::string content =
+    "int a = 0;\n"
+    "namespace ns {\n"
+    "int b = 1;\n"
+    "}\n"
+    "void f() { }\n"
+    "int c = 2;\n";
+
+  cxx::FileSystem fs;
+  cxx::parsers::RestrictedParser parser{ fs };
+  parser.incremental = true;
+  parser.parse("failure.cpp", content);
+
+  auto root = std::static_pointer_cast<cxx::AstRootNode>(fs.get("failure.cpp")->ast);
+  const std::vector<std::shared_ptr<cxx::AstNode>> nodes = root->childvec;
+  REQUIRE(nodes.size() == 4);
+  auto nsdecl = std::static_pointer_cast<cxx::NamespaceDeclaration>(nodes.at(1));
+  const std::vector<std::shared_ptr<cxx::AstNode>> ns_nodes = nsdecl->childvec;
+
+  auto global = parser.program()->globalNamespace();
+  auto ns = std::static_pointer_cast<cxx::Namespace>(nsdecl->entity_ptr);
+  const std::vector<std::shared_ptr<cxx::IEntity>> entities = global->entities;
+  const std::vector<std::shared_ptr<cxx::IEntity>> ns_entities = ns->entities;
+  auto f = std::static_pointer_cast<cxx::Function>(entities.at(2));
+  REQUIRE(!f->body.isNull());
+  const std::map<cxx::INode*, std::shared_ptr<cxx::AstNode>> astmap = parser.program()->astmap;
+  const std::string tree = entity_tree(*global);
+
+  // a new line, a new value for b, a new body for f and a 'friend' 
+  // that cannot be parsed at file scope
+  REQUIRE_THROWS(parser.reparse("failure.cpp", {
+    { 0, 0, "int z = 3;\n" },
+    { content.find("1;"), 1, "42" },
+    { content.find("{ }"), 3, "{ return; }" },
+    { content.find("int c"), 0, "friend " },
+    }));
+
+  REQUIRE(root->childvec == nodes);
+  REQUIRE(nsdecl->childvec == ns_nodes);
+  REQUIRE(nodes.at(0)->sourcerange.begin.line == 0);
+  REQUIRE(nsdecl->sourcerange.begin.line == 1);
+  REQUIRE(nsdecl->sourcerange.end.line == 3);
+  REQUIRE(ns_nodes.at(0)->sourcerange.begin.line == 2);
+  REQUIRE(nodes.at(3)->sourcerange.begin.line == 5);
+
+  REQUIRE(global->entities == entities);
+  REQUIRE(ns->entities == ns_entities);
+  REQUIRE(!f->body.isNull());
+  REQUIRE(parser.program()->astmap == astmap);
+
+  // the file can still be reparsed
+  REQUIRE(parser.reparse("failure.cpp", { { content.find("1;"), 1, "42" } }));
+
+  REQUIRE(root->childvec.size() == 4);
+  REQUIRE(root->childvec.at(0) == nodes.at(0));
+  REQUIRE(root->childvec.at(3) == nodes.at(3));
+  REQUIRE(nsdecl->childvec.size() == 1);
+  REQUIRE(nsdecl->childvec.front() != ns_nodes.front());
+  REQUIRE(entity_tree(*global) == tree);
+  REQUIRE(std::static_pointer_cast<cxx::Variable>(ns->entities.front())->defaultValue().toString() == "42");
+}
+
+TEST_CASE("The parser can allocate the nodes of a file in an arena", "[restricted-parser]")
+{
+  const std::string content =
+    "namespace ns {\n"
+    "struct Foo { int x; void bar(int n = 0); };\n"
+    "}\n"
+    "void foo() { int y = 0; return; }\n";
+
+  std::weak_ptr<cxx::Arena> arena;
+  std::shared_ptr<cxx::AstNode> ast;
+
+  {
+    cxx::FileSystem fs;
+    cxx::parsers::RestrictedParser parser{ fs };
+    parser.arena_allocation = true;
+    parser.parse("arena.cpp", content);
+
+    auto file = fs.get("arena.cpp");
+    REQUIRE(file->arena);
+    REQUIRE(file->arena->allocations() > 10);
+    REQUIRE(file->arena->bytesAllocated() <= file->arena->bytesReserved());
+
+    cxx::FileSystem fs2;
+    cxx::parsers::RestrictedParser heap{ fs2 };
+    heap.parse("arena.cpp", content);
+    REQUIRE(!fs2.get("arena.cpp")->arena);
+    REQUIRE(entity_tree(*parser.program()->globalNamespace()) == entity_tree(*heap.program()->globalNamespace()));
+
+    arena = file->arena;
+    ast = file->ast;
+  }
+
+  // the arena lives as long as one of its nodes
+  REQUIRE(!arena.expired());
+  REQUIRE(ast->children().size() == 2);
+
+  ast.reset();
+  REQUIRE(arena.expired());
+}